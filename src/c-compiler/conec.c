@@ -12,6 +12,8 @@
 #include "ir/ir.h"
 #include "shared/error.h"
 #include "shared/timer.h"
+#include "shared/cache.h"
+#include "shared/timetrace.h"
 #include "parser/lexer.h"
 #include "parser/parser.h"
 #include "genllvm/genllvm.h"
@@ -20,10 +22,11 @@
 #include <assert.h>
 
 // Run all semantic analysis passes against the AST/IR (after parse and before gen)
-void doAnalysis(ProgramNode **pgm) {
+void doAnalysis(ProgramNode **pgm, ConeOptions *opt) {
 
     // Resolve all name uses to their appropriate declaration
     // Note: Some nodes may be replaced (e.g., 'a' to 'self.a')
+    timeTraceBegin("Name resolution", NULL);
     NameResState nstate;
     nstate.mod = NULL;
     nstate.typenode = NULL;
@@ -31,6 +34,7 @@ void doAnalysis(ProgramNode **pgm) {
     nstate.scope = 0;
     nstate.flags = 0;
     inodeNameRes(&nstate, (INode**)pgm);
+    timeTraceEnd();
     if (errors)
         return;
 
@@ -49,10 +53,14 @@ void doAnalysis(ProgramNode **pgm) {
     // - Infectiousness of types is handled (move semantics, lifetimes, thread-bound, etc.)
     // - Subtype and inheritance relationships are filled out
     // - The binary encoding is sorted (e.g., ensuring variant types are same size)
+    timeTraceBegin("Type check", NULL);
     TypeCheckState tstate;
     tstate.fn = NULL;
     tstate.typenode = NULL;
+    tstate.scope = 0;
+    tstate.pending = opt->reachable && !opt->library ? newNodes(64) : NULL;
     inodeTypeCheckAny(&tstate, (INode**)pgm);
+    timeTraceEnd();
 }
 
 int main(int argc, char **argv) {
@@ -68,30 +76,59 @@ int main(int argc, char **argv) {
         errorExit(ExitOpts, "Specify a Cone program to compile.");
     coneopt.srcpath = argv[1];
     coneopt.srcname = fileName(coneopt.srcpath);
+    if (coneopt.time_trace)
+        timeTraceInit(coneopt.time_trace);
+    timeTraceBegin("Compile", coneopt.srcpath);
+
+    if (coneopt.cache_dir)
+        cacheInit(coneopt.cache_dir);
 
     // We set up generation early because we need target info, e.g.: pointer size
     timerBegin(SetupTimer);
+    timeTraceBegin("Setup", NULL);
     genSetup(&gen, &coneopt);
+    timeTraceEnd();
 
     // Parse source file, do semantic analysis, and generate code
     timerBegin(ParseTimer);
+    timeTraceBegin("Parse", NULL);
     ProgramNode* pgmnode = parsePgm(&coneopt);
+    timeTraceEnd();
     if (errors == 0) {
         timerBegin(SemTimer);
-        doAnalysis(&pgmnode);
+        timeTraceBegin("Analysis", NULL);
+        doAnalysis(&pgmnode, &coneopt);
+        timeTraceEnd();
         if (errors == 0) {
             timerBegin(GenTimer);
+            timeTraceBegin("Gen", NULL);
             if (coneopt.print_ir)
                 inodePrint(coneopt.output, coneopt.srcpath, (INode*)pgmnode);
             genpgm(&gen, pgmnode);
             genClose(&gen);
+            timeTraceEnd();
         }
     }
     timerBegin(TimerCount);
+    timeTraceEnd();
 
     // Close up everything necessary
-    if (coneopt.verbosity > 0)
+    if (coneopt.verbosity > 0) {
         timerPrint();
+        genericPrintStats();
+        rangePrintStats();
+        rcoptPrintStats();
+        escapePrintStats();
+        if (cacheEnabled())
+            cachePrint();
+    }
+    else if (coneopt.print_stats) {
+        genericPrintStats();
+        rangePrintStats();
+        rcoptPrintStats();
+        escapePrintStats();
+    }
+    timeTraceWrite();
     errorSummary();
 #ifdef _DEBUG
     getchar();    // Hack for VS debugging
@@ -20,16 +20,23 @@ enum
     OPT_VERSION,
     OPT_HELP,
     OPT_DEBUG,
+    OPT_OPTLEVEL,
     OPT_BUILDFLAG,
     OPT_STRIP,
     OPT_PATHS,
     OPT_OUTPUT,
     OPT_LIBRARY,
     OPT_RUNTIMEBC,
+    OPT_LTO,
+    OPT_MALLOC,
     OPT_PIC,
     OPT_NOPIC,
     OPT_DOCS,
     OPT_DOCS_PUBLIC,
+    OPT_JOBS,
+    OPT_SPLIT,
+    OPT_CACHEDIR,
+    OPT_REACHABLE,
 
     OPT_SAFE,
     OPT_CPU,
@@ -44,6 +51,7 @@ enum
     OPT_IR,
     OPT_ASM,
     OPT_LLVMIR,
+    OPT_TIMETRACE,
     OPT_TRACE,
     OPT_WIDTH,
     OPT_IMMERR,
@@ -53,6 +61,12 @@ enum
     OPT_EXTFUN,
     OPT_SIMPLEBUILTIN,
     OPT_LINT_LLVM,
+    OPT_NOREFATTRS,
+    OPT_NOTBAA,
+    OPT_NODEVIRT,
+    OPT_NOSWITCH,
+    OPT_NONICHE,
+    OPT_LAYOUT,
 
     OPT_BNF,
     OPT_ANTLR,
@@ -64,16 +78,23 @@ static opt_arg_t args[] =
     { "version", 'v', OPT_ARG_NONE, OPT_VERSION },
     { "help", 'h', OPT_ARG_NONE, OPT_HELP },
     { "debug", 'd', OPT_ARG_NONE, OPT_DEBUG },
+    { "opt-level", 'O', OPT_ARG_REQUIRED, OPT_OPTLEVEL },
     { "define", 'D', OPT_ARG_REQUIRED, OPT_BUILDFLAG },
     { "strip", 's', OPT_ARG_NONE, OPT_STRIP },
     { "path", 'p', OPT_ARG_REQUIRED, OPT_PATHS },
     { "output", 'o', OPT_ARG_REQUIRED, OPT_OUTPUT },
     { "library", 'l', OPT_ARG_NONE, OPT_LIBRARY },
     { "runtimebc", '\0', OPT_ARG_NONE, OPT_RUNTIMEBC },
+    { "lto", '\0', OPT_ARG_NONE, OPT_LTO },
+    { "malloc", '\0', OPT_ARG_NONE, OPT_MALLOC },
     { "pic", '\0', OPT_ARG_NONE, OPT_PIC },
     { "nopic", '\0', OPT_ARG_NONE, OPT_NOPIC },
     { "docs", 'g', OPT_ARG_NONE, OPT_DOCS },
     { "docs-public", '\0', OPT_ARG_NONE, OPT_DOCS_PUBLIC },
+    { "jobs", 'j', OPT_ARG_REQUIRED, OPT_JOBS },
+    { "split", '\0', OPT_ARG_NONE, OPT_SPLIT },
+    { "cache-dir", '\0', OPT_ARG_REQUIRED, OPT_CACHEDIR },
+    { "reachable", '\0', OPT_ARG_NONE, OPT_REACHABLE },
 
     { "safe", '\0', OPT_ARG_OPTIONAL, OPT_SAFE },
     { "cpu", '\0', OPT_ARG_REQUIRED, OPT_CPU },
@@ -88,6 +109,7 @@ static opt_arg_t args[] =
     { "ir", '\0', OPT_ARG_NONE, OPT_IR },
     { "asm", '\0', OPT_ARG_NONE, OPT_ASM },
     { "llvmir", '\0', OPT_ARG_NONE, OPT_LLVMIR },
+    { "time-trace", '\0', OPT_ARG_REQUIRED, OPT_TIMETRACE },
     { "trace", 't', OPT_ARG_NONE, OPT_TRACE },
     { "width", 'w', OPT_ARG_REQUIRED, OPT_WIDTH },
     { "immerr", '\0', OPT_ARG_NONE, OPT_IMMERR },
@@ -97,6 +119,12 @@ static opt_arg_t args[] =
     { "extfun", '\0', OPT_ARG_NONE, OPT_EXTFUN },
     { "simplebuiltin", '\0', OPT_ARG_NONE, OPT_SIMPLEBUILTIN },
     { "lint-llvm", '\0', OPT_ARG_NONE, OPT_LINT_LLVM },
+    { "norefattrs", '\0', OPT_ARG_NONE, OPT_NOREFATTRS },
+    { "notbaa", '\0', OPT_ARG_NONE, OPT_NOTBAA },
+    { "nodevirt", '\0', OPT_ARG_NONE, OPT_NODEVIRT },
+    { "noswitch", '\0', OPT_ARG_NONE, OPT_NOSWITCH },
+    { "noniche", '\0', OPT_ARG_NONE, OPT_NONICHE },
+    { "layout", '\0', OPT_ARG_NONE, OPT_LAYOUT },
 
     OPT_ARGS_FINISH
 };
@@ -112,6 +140,13 @@ static void usage()
         "  --version, -v   Print the version of the compiler and exit.\n"
         "  --help, -h      Print this help text and exit.\n"
         "  --debug, -d     Don't optimise the output.\n"
+        "  --opt-level, -O Optimization level.\n"
+        "    =0            None (default with --debug).\n"
+        "    =1            Quick optimizations only.\n"
+        "    =2            Standard optimizations, with vectorization (default).\n"
+        "    =3            Also optimizations that may make the code larger.\n"
+        "    =s            Like 2, but favor smaller code.\n"
+        "    =z            Smallest code: no vectorization or loop unrolling.\n"
         "  --define, -D    Define the specified build flag.\n"
         "    =name\n"
         "  --strip, -s     Strip debug info.\n"
@@ -120,21 +155,36 @@ static void usage()
         "  --output, -o    Write output to this directory.\n"
         "    =path         Defaults to the current directory.\n"
         "  --library, -l   Generate a C-API compatible static library.\n"
-        "  --runtimebc     Compile with the LLVM bitcode file for the runtime.\n"
+        "  --runtimebc     Compile with the LLVM bitcode file for the runtime\n"
+        "                  (conestd.bc, found on the --path or beside the compiler),\n"
+        "                  so its functions can be inlined.\n"
+        "  --lto           Emit LLVM bitcode object files, for link-time optimization.\n"
+        "  --malloc        Allocate so and rc references with the C library's malloc\n"
+        "                  and free, rather than the runtime's allocator (conestd).\n"
         "  --wasm          Compile for WebAssembly target.\n"
         "  --pic           Compile using position independent code.\n"
         "  --nopic         Don't compile using position independent code.\n"
         "  --docs, -g      Generate code documentation.\n"
         "  --docs-public   Generate code documentation for public types only.\n"
+        "  --jobs, -j      Number of threads used to parse and generate modules.\n"
+        "    =count        Defaults to 1. Use 0 for one thread per CPU.\n"
+        "  --split         Generate a separate object file for each module,\n"
+        "                  optimized and emitted concurrently (see --jobs).\n"
+        "  --cache-dir     Cache generated code in this directory, and reuse it\n"
+        "    =path         when the same LLVM IR is generated with the same options.\n"
+        "  --reachable     Only check and generate functions reachable from main\n"
+        "                  (unused functions are not checked for errors).\n"
+        "                  Ignored with --library, where all functions are exported.\n"
         ,
         "Rarely needed options:\n"
         "  --safe          Allow only the listed packages to use C FFI.\n"
         "    =package      With no packages listed, only builtin is allowed.\n"
         "  --cpu           Set the target CPU.\n"
-        "    =name         Default is the host CPU.\n"
+        "    =name         Default is generic. Use native for the host CPU\n"
+        "                  (with all its features).\n"
         "  --features      CPU features to enable or disable.\n"
         "    =+this,-that  Use + to enable, - to disable.\n"
-        "                  Defaults to detecting all CPU features from the host.\n"
+        "                  Defaults to the CPU's own (all the host's, with --cpu=native).\n"
         "  --triple        Set the target triple.\n"
         "    =name         Defaults to the host triple.\n"
         "  --stats         Print some compiler stats.\n"
@@ -153,6 +203,9 @@ static void usage()
         "  --ir            Output an IR tree for the whole program.\n"
         "  --asm           Output an assembly file.\n"
         "  --llvmir        Output an LLVM IR file.\n"
+        "  --time-trace    Write a trace of compile times (per stage, module,\n"
+        "    =file.json    function and LLVM pass) for Chrome's trace viewer\n"
+        "                  or Perfetto.\n"
         "  --trace, -t     Enable parse trace.\n"
         "  --width, -w     Width to target when printing the IR.\n"
         "    =columns      Defaults to the terminal width.\n"
@@ -163,6 +216,14 @@ static void usage()
         "  --simplebuiltin Use a minimal builtin package.\n"
         "  --files         Print source file names as each is processed.\n"
         "  --lint-llvm     Run the LLVM linting pass on generated IR.\n"
+        "  --norefattrs    Don't tell LLVM what reference permissions guarantee\n"
+        "                  (noalias, readonly, nonnull, dereferenceable).\n"
+        "  --notbaa        Don't tell LLVM that values of different types never overlap.\n"
+        "  --nodevirt      Always call methods through a virtual reference's vtable.\n"
+        "  --noswitch      Test a match's cases one by one, rather than with a switch.\n"
+        "  --noniche       Give a union's tag a field of its own, rather than keeping it\n"
+        "                  in values its fields never hold, or in padding.\n"
+        "  --layout        Print each union's size and where it keeps its tag.\n"
         ,
         "" // "Runtime options for Cone programs (not for use with Cone compiler):\n"
     );
@@ -219,7 +280,9 @@ int coneOptSet(ConeOptions *opt, int *argc, char **argv) {
     opt.pic = 1;
 #endif
     opt->release = 1;
+    opt->jobs = 1;
     opt->package_search_paths = NULL;
+    opt->exe_path = argv[0];
 
     while ((id = optNext(&s)) != -1) {
         switch (id) {
@@ -236,8 +299,13 @@ int coneOptSet(ConeOptions *opt, int *argc, char **argv) {
         case OPT_OUTPUT: opt->output = s.arg_val; break;
         case OPT_LIBRARY: opt->library = 1; break;
         case OPT_RUNTIMEBC: opt->runtimebc = 1; break;
+        case OPT_LTO: opt->lto = 1; break;
+        case OPT_MALLOC: opt->libc_alloc = 1; break;
         case OPT_PIC: opt->pic = 1; break;
         case OPT_NOPIC: opt->pic = 0; break;
+        case OPT_SPLIT: opt->split = 1; break;
+        case OPT_CACHEDIR: opt->cache_dir = s.arg_val; break;
+        case OPT_REACHABLE: opt->reachable = 1; break;
         case OPT_DOCS:
         {
             opt->docs = 1;
@@ -272,6 +340,7 @@ int coneOptSet(ConeOptions *opt, int *argc, char **argv) {
         case OPT_IR: opt->print_ir = 1; break;
         case OPT_ASM: opt->print_asm = 1; break;
         case OPT_LLVMIR: opt->print_llvmir = 1; break;
+        case OPT_TIMETRACE: opt->time_trace = s.arg_val; break;
         case OPT_TRACE: opt->parse_trace = 1; break;
         case OPT_WIDTH: opt->ir_print_width = atoi(s.arg_val); break;
             // case OPT_IMMERR: errors_set_immediate(opt.check.errors, 1); break;
@@ -281,6 +350,29 @@ int coneOptSet(ConeOptions *opt, int *argc, char **argv) {
         case OPT_FILENAMES: opt->print_filenames = 1; break;
         case OPT_CHECKTREE: opt->check_tree = 1; break;
         case OPT_LINT_LLVM: opt->lint_llvm = 1; break;
+        case OPT_NOREFATTRS: opt->no_ref_attrs = 1; break;
+        case OPT_NOTBAA: opt->no_tbaa = 1; break;
+        case OPT_NODEVIRT: opt->no_devirt = 1; break;
+        case OPT_NOSWITCH: opt->no_switch = 1; break;
+        case OPT_NONICHE: opt->no_niche = 1; break;
+        case OPT_LAYOUT: opt->print_layout = 1; break;
+
+        case OPT_JOBS:
+        {
+            int n = atoi(s.arg_val);
+            if (n >= 0)
+                opt->jobs = n;
+            else
+                ok = 0;
+        }
+        break;
+
+        case OPT_OPTLEVEL:
+            if (strlen(s.arg_val) == 1 && strchr("0123sz", s.arg_val[0]))
+                opt->opt_level = s.arg_val[0];
+            else
+                ok = 0;
+            break;
 
         case OPT_VERBOSE:
         {
@@ -310,5 +402,11 @@ int coneOptSet(ConeOptions *opt, int *argc, char **argv) {
             usage();
         return -1;
     }
+
+    // Without -O, release builds (the default) use the standard optimizations and --debug
+    // builds none. Debug builds used to get a few quick passes (mem2reg, reassociate, GVN
+    // and simplifycfg); -O1 is now the nearest to that.
+    if (!opt->opt_level)
+        opt->opt_level = opt->release? '2' : '0';
     return 1;
 }
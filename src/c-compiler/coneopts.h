@@ -20,8 +20,11 @@ typedef struct ConeOptions {
 
     char* srcpath;    // Full path
     char* srcname;    // Just the filename
+    char* exe_path;   // Path of the compiler itself (to find its runtime bitcode)
 
     char* output;
+    char* cache_dir;    // Directory for caching generated code (NULL = no caching)
+    char* time_trace;   // File to write a trace of compile times to (NULL = none)
     char* link_arch;
     char* linker;
 
@@ -34,13 +37,19 @@ typedef struct ConeOptions {
     void* data; // User-defined data for unit test callbacks
 
     int ptrsize;    // Size of a pointer (in bits)
+    int jobs;       // Number of threads used to compile (1 = default, 0 = one per CPU)
+    char opt_level; // Optimization level: '0'-'3', or 's'/'z' to optimize for size
 
     // Boolean flags
     int wasm;        // 1=WebAssembly
     int release;    // 0=debug (no optimizations). 1=release (default)
     int library;    // 1=generate a C-API compatible static library
     int runtimebc;    // Compile with the LLVM bitcode file for the runtime
+    int lto;        // Emit LLVM bitcode objects, for link-time optimization
+    int libc_alloc; // so and rc allocate with libc's malloc/free, not the runtime's allocator
     int pic;        // Compile using position independent code
+    int split;      // Generate a separate object file for each module
+    int reachable;  // Only check and generate functions reachable from main
     int print_stats;    // Print some compiler statistics
     int verify;        // Verify LLVM IR
     int extfun;        // Set function default linkage to external
@@ -52,6 +61,12 @@ typedef struct ConeOptions {
     int print_llvmir;    // Print out LLVM IR
     int check_tree;        // Verify IR well-formedness
     int lint_llvm;        // Run the LLVM linting pass on generated IR
+    int no_ref_attrs;     // Don't add LLVM attributes for what reference permissions guarantee
+    int no_tbaa;          // Don't add type-based alias analysis metadata to loads and stores
+    int no_devirt;        // Don't call methods through virtual references directly
+    int no_switch;        // Don't generate a match as a switch
+    int no_niche;         // Don't keep a union's tag in unused values or padding
+    int print_layout;     // Print each union's size and where it keeps its tag
     int docs;            // Generate code documentation
     int docs_private;    // Generate code docs for private
     int verbosity;       // 0 - 4 (0 = default)
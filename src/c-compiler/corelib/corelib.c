@@ -56,7 +56,8 @@ void stdPermInit() {
     opaqPerm = newPermNodeStr("opaq", MayAlias | RaceSafe | IsLockless);
 }
 
-char *corelibSource =
+// Types and regions every program gets
+static char *corelibTypes =
 "union Option[T] {\n"
   "struct None {}\n"
   "struct Some {value T}\n"
@@ -67,6 +68,41 @@ char *corelibSource =
   "struct Error {value E}\n"
 "}\n"
 
+// Regions served by the runtime (conestd/region.c).
+// coneArenaReset frees all the calling thread's arena memory at once, e.g., after each request
+// a service loop handles. Nothing checks that no +arena reference is used after the reset,
+// so it may only be called once every one of them is gone, or they will dangle.
+"extern fn coneArenaAlloc(size usize) *u8\n"
+"extern fn coneArenaReset()\n"
+"extern fn coneSlabAlloc(size usize) *u8\n"
+"extern fn coneSlabFree(p *u8, size usize)\n"
+
+"struct arena:\n"
+"  fn @nonnull _alloc(size usize) *u8 inline {coneArenaAlloc(size)}\n"
+
+"struct @move slab:\n"
+"  fn @nonnull _alloc(size usize) *u8 inline {coneSlabAlloc(size)}\n"
+"  fn _free(p *u8, size usize) inline {coneSlabFree(p, size)}\n"
+;
+
+// The so and rc regions, using the runtime's thread-caching allocator (conestd/alloc.c)
+static char *corelibConeAlloc =
+"extern fn coneAlloc(size usize) *u8\n"
+"extern fn coneFree(p *u8, size usize)\n"
+
+"struct @move so:\n"
+"  fn @nonnull _alloc(size usize) *u8 inline {coneAlloc(size)}\n"
+"  fn _free(p *u8, size usize) inline {coneFree(p, size)}\n"
+
+"struct rc:\n"
+"  cnt usize\n"
+"  fn @nonnull _alloc(size usize) *u8 inline {coneAlloc(size)}\n"
+"  fn _free(p *u8, size usize) inline {coneFree(p, size)}\n"
+"  fn init() rc inline {rc[1usize]}\n"
+;
+
+// The so and rc regions, using the C library's malloc and free (--malloc)
+static char *corelibLibcAlloc =
 "extern fn malloc(size usize) *u8\n"
 
 "struct @move so:\n"
@@ -78,8 +114,13 @@ char *corelibSource =
 "  fn init() rc inline {rc[1usize]}\n"
 ;
 
+char *corelibSource;
+
 // Set up the standard library, whose names are always shared by all modules
-void stdlibInit(int ptrsize) {
+void stdlibInit(int ptrsize, int libcalloc) {
+    char *regions = libcalloc ? corelibLibcAlloc : corelibConeAlloc;
+    corelibSource = memAllocStr(corelibTypes, strlen(corelibTypes) + strlen(regions));
+    strcat(corelibSource, regions);
 
     unknownType = (INode*)newAbsenceNode();
     unknownType->tag = UnknownTag;
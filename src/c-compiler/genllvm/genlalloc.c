@@ -57,10 +57,10 @@ void genlDealiasFlds(GenState *gen, LLVMValueRef ref, RefNode *refnode) {
     for (nodelistFor(&strnode->fields, cnt, nodesp)) {
         FieldDclNode *field = (FieldDclNode *)*nodesp;
         RefNode *vartype = (RefNode *)field->vtype;
-        if (vartype->tag != RefTag || !(isRegion(vartype->region, rcName) || isRegion(vartype->region, soName)))
+        if (vartype->tag != RefTag || !(isRegion(vartype->region, rcName) || regionIsOwner(vartype->region)))
             continue;
         LLVMValueRef fldref = LLVMBuildStructGEP(gen->builder, ref, field->index, &field->namesym->namestr);
-        if (isRegion(vartype->region, soName))
+        if (regionIsOwner(vartype->region))
             genlDealiasOwn(gen, fldref, vartype);
         else
             genlRcCounter(gen, fldref, -1, vartype);
@@ -121,13 +121,23 @@ void genlAllocFillArray(GenState *gen, LLVMValueRef nbrelems, ArrayNode *arrayli
     LLVMPositionBuilderAtEnd(gen->builder, loopend);
 }
 
+// Allocations bigger than this go on the heap, even when they cannot escape
+#define GenStackAllocMax 512
+
+// Does an allocation (or the variable that owns it) go on the stack?
+// The escape pass marks which can; only small ones do.
+static int genlOnStack(GenState *gen, INode *node, RefNode *reftype) {
+    return (node->flags & FlagStackAlloc)
+        && LLVMABISizeOfType(gen->datalayout, reftype->typeinfo->structype) <= GenStackAllocMax;
+}
+
 // Generate region-based allocation and initialization logc
 // It returns a reference to the allocated/initialized object (or null)
 // This is roughly what it does:
 //
 // fn allocate(size usize) +region-uni T
 //   imm ref = region::_alloc(T.size) as +region-uni T
-//   if (ref is None)
+//   if (ref is None)           // Skipped when _alloc is @nonnull
 //     panic or return None
 //   ref.region.init()
 //   ref.perm.init()
@@ -168,33 +178,47 @@ LLVMValueRef genlallocref(GenState *gen, RefNode *allocatenode) {
         sizeval = LLVMBuildAdd(gen->builder, sizeval, extra, "");
     }
 
-    // Do region allocation (using its _alloc method) and then bitcast to multi-layered-struct ptr
     FnDclNode *allocmeth = (FnDclNode*)iTypeFindFnField(region, allocMethodName);
-    LLVMValueRef malloc = genlFnCallInternal(gen, SimpleDispatch, (INode*)allocmeth, 1, &sizeval);
-    LLVMValueRef ptrstructype = LLVMBuildBitCast(gen->builder, malloc, reftype->typeinfo->ptrstructype, "");
-
-    // Handle when allocation fails (returns NULL pointer)
-    LLVMValueRef isNull = LLVMBuildIsNull(gen->builder, ptrstructype, "isnull");
-    LLVMBasicBlockRef endif = genlInsertBlock(gen, "endif");
-    LLVMBasicBlockRef initblk = genlInsertBlock(gen, "initblk");
+    LLVMValueRef ptrstructype;
+    LLVMBasicBlockRef endif = NULL;
     LLVMValueRef blkvals[2];
     LLVMBasicBlockRef blks[2];
+    int nullpath = allocatenode->flags & FlagQues;
+    int onstack = genlOnStack(gen, (INode*)allocatenode, reftype);
+    if (onstack) {
+        // A small value that never outlives its function goes on the stack instead (see escape.h)
+        ptrstructype = genlAlloca(gen, reftype->typeinfo->structype, "stackalloc");
+    }
+    else {
+        // Do region allocation (using its _alloc method) and then bitcast to multi-layered-struct ptr
+        LLVMValueRef malloc = genlFnCallInternal(gen, SimpleDispatch, (INode*)allocmeth, 1, &sizeval);
+        ptrstructype = LLVMBuildBitCast(gen->builder, malloc, reftype->typeinfo->ptrstructype, "");
+    }
 
-    // Generate null/panic block, used when alloc returns 0
-    LLVMBasicBlockRef panicblk = genlInsertBlock(gen, "panicblk");
-    LLVMBuildCondBr(gen->builder, isNull, panicblk, initblk);
-    LLVMPositionBuilderAtEnd(gen->builder, panicblk);
-    if (!(allocatenode->flags & FlagQues))
-        genlPanic(gen);
-    blkvals[0] = LLVMBuildBitCast(gen->builder, ptrstructype, valueptrtyp, "");
-    if (reftype->tag == ArrayRefTag) {
-        LLVMValueRef tuplevalnull = LLVMGetUndef(reftypellvm);
-        tuplevalnull = LLVMBuildInsertValue(gen->builder, tuplevalnull, blkvals[0], 0, "fatptr");
-        blkvals[0] = LLVMBuildInsertValue(gen->builder, tuplevalnull, LLVMConstInt(genlType(gen, (INode*)usizeType), 0, 0), 1, "fatsize");
+    // Handle when allocation fails (returns NULL pointer), unless the region promises it never does
+    if (!onstack && !(allocmeth->flags & FlagNonNull)) {
+        LLVMValueRef isNull = LLVMBuildIsNull(gen->builder, ptrstructype, "isnull");
+        endif = genlInsertBlock(gen, "endif");
+        LLVMBasicBlockRef initblk = genlInsertBlock(gen, "initblk");
+
+        // Generate null/panic block, used when alloc returns 0
+        LLVMBasicBlockRef panicblk = genlInsertBlock(gen, "panicblk");
+        genlBranchUnlikely(gen, isNull, panicblk, initblk);
+        LLVMPositionBuilderAtEnd(gen->builder, panicblk);
+        if (nullpath) {
+            blkvals[0] = LLVMBuildBitCast(gen->builder, ptrstructype, valueptrtyp, "");
+            if (reftype->tag == ArrayRefTag) {
+                LLVMValueRef tuplevalnull = LLVMGetUndef(reftypellvm);
+                tuplevalnull = LLVMBuildInsertValue(gen->builder, tuplevalnull, blkvals[0], 0, "fatptr");
+                blkvals[0] = LLVMBuildInsertValue(gen->builder, tuplevalnull, LLVMConstInt(genlType(gen, (INode*)usizeType), 0, 0), 1, "fatsize");
+            }
+            blks[0] = panicblk;
+            LLVMBuildBr(gen->builder, endif);
+        }
+        else
+            genlPanic(gen, (INode*)allocatenode);
+        LLVMPositionBuilderAtEnd(gen->builder, initblk);
     }
-    blks[0] = panicblk;
-    LLVMBuildBr(gen->builder, endif);
-    LLVMPositionBuilderAtEnd(gen->builder, initblk);
 
     // Initialize region using its 'init' method, if supplied
     INode *reginitmeth = iTypeFindFnField(region, initMethodName);
@@ -237,21 +261,50 @@ LLVMValueRef genlallocref(GenState *gen, RefNode *allocatenode) {
         tupleval = LLVMBuildInsertValue(gen->builder, tupleval, valuep, 0, "fatptr");
         valuep = LLVMBuildInsertValue(gen->builder, tupleval, nbrelems, 1, "fatsize");
     }
+    if (endif == NULL)
+        return valuep;
     blkvals[1] = valuep;
-    blks[1] = initblk;
+    blks[1] = LLVMGetInsertBlock(gen->builder);
 
     // Finish up block, start new one, and return allocated
     LLVMBuildBr(gen->builder, endif);
     LLVMPositionBuilderAtEnd(gen->builder, endif);
     LLVMValueRef phi = LLVMBuildPhi(gen->builder, reftypellvm, "allocphi");
-    LLVMAddIncoming(phi, blkvals, blks, 2);
+    if (nullpath)
+        LLVMAddIncoming(phi, blkvals, blks, 2);
+    else
+        LLVMAddIncoming(phi, &blkvals[1], &blks[1], 1);
     return phi;
 }
 
+// Give an allocation back to its region's _free method (or else to free()),
+// where start points to the beginning of the allocation
+static void genlRegionFree(GenState *gen, LLVMValueRef start, RefNode *refnode) {
+    INode *region = itypeGetTypeDcl(refnode->region);
+    FnDclNode *freemeth = (FnDclNode*)iTypeFindFnField(region, freeMethodName);
+    if (freemeth == NULL) {
+        genlFree(gen, start);
+        return;
+    }
+    genlType(gen, (INode*)refnode);     // Make sure typeinfo is populated
+    LLVMValueRef args[2];
+    args[0] = LLVMBuildBitCast(gen->builder, start, LLVMPointerType(LLVMInt8TypeInContext(gen->context), 0), "");
+    args[1] = LLVMConstInt(genlType(gen, (INode*)usizeType), LLVMABISizeOfType(gen->datalayout, refnode->typeinfo->structype), 0);
+    genlFnCallInternal(gen, SimpleDispatch, (INode*)freemeth, 2, args);
+}
+
 // Dealias an own allocated reference
 void genlDealiasOwn(GenState *gen, LLVMValueRef ref, RefNode *refnode) {
     genlDealiasFlds(gen, ref, refnode);
-    genlFree(gen, ref);
+
+    // Point back from the value to the start of the allocation, past any region fields
+    genlType(gen, (INode*)refnode);     // Make sure typeinfo is populated
+    unsigned long long offset = LLVMOffsetOfElement(gen->datalayout, refnode->typeinfo->structype, ValueField);
+    if (offset > 0) {
+        LLVMValueRef back = LLVMConstInt(genlType(gen, (INode*)usizeType), -(long long)offset, 1);
+        ref = LLVMBuildGEP(gen->builder, LLVMBuildBitCast(gen->builder, ref, LLVMPointerType(LLVMInt8TypeInContext(gen->context), 0), ""), &back, 1, "allocstart");
+    }
+    genlRegionFree(gen, ref, refnode);
 }
 
 // Add to the counter of an rc allocated reference
@@ -276,7 +329,7 @@ void genlRcCounter(GenState *gen, LLVMValueRef ref, long long amount, RefNode *r
         LLVMBuildCondBr(gen->builder, test, dofree, nofree);
         LLVMPositionBuilderAtEnd(gen->builder, dofree);
         genlDealiasFlds(gen, ref, refnode);
-        genlFree(gen, cntptr);
+        genlRegionFree(gen, cntptr, refnode);
         LLVMBuildBr(gen->builder, nofree);
         LLVMPositionBuilderAtEnd(gen->builder, nofree);
     }
@@ -293,8 +346,11 @@ void genlDealiasNodes(GenState *gen, Nodes *nodes) {
         RefNode *reftype = (RefNode *)var->vtype;
         if (reftype->tag == RefTag) {
             LLVMValueRef ref = LLVMBuildLoad(gen->builder, var->llvmvar, "allocref");
-            if (isRegion(reftype->region, soName)) {
-                genlDealiasOwn(gen, ref, reftype);
+            if (regionIsOwner(reftype->region)) {
+                if (genlOnStack(gen, (INode*)var, reftype))
+                    genlDealiasFlds(gen, ref, reftype);     // Its storage is in the stack frame
+                else
+                    genlDealiasOwn(gen, ref, reftype);
             }
             else if (isRegion(reftype->region, rcName)) {
                 genlRcCounter(gen, ref, -1, reftype);
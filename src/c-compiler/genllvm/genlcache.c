@@ -0,0 +1,74 @@
+/** Caching of generated code
+ * @file
+ *
+ * With --cache-dir, the files emitted for some LLVM IR (object, and asm or
+ * optimized IR if requested) are cached, keyed by a hash of that IR before it
+ * is optimized, along with the target and options that affect what is emitted.
+ * When the same IR shows up again, its files are copied from the cache,
+ * skipping optimization and emission.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "../conec.h"
+#include "../shared/cache.h"
+#include "../shared/fileio.h"
+#include "../coneopts.h"
+#include "genllvm.h"
+
+#include <llvm-c/BitWriter.h>
+#include <llvm-c/TargetMachine.h>
+#include <llvm/Config/llvm-config.h>
+
+#include <string.h>
+
+// Fold a string into a hash (NULL is distinct from "")
+static uint64_t genlCacheHashStr(uint64_t hash, char *str) {
+    return str ? cacheHash(hash, str, strlen(str) + 1) : cacheHash(hash, "\xff", 1);
+}
+
+// Compute the cache key for code generated from mod (before it is optimized)
+uint64_t genlCacheKey(ConeOptions *opt, LLVMModuleRef mod) {
+    uint64_t key = genlCacheHashStr(CacheHashInit, CONE_RELEASE);
+    key = genlCacheHashStr(key, LLVM_VERSION_STRING);
+    key = genlCacheHashStr(key, opt->triple);
+    key = genlCacheHashStr(key, opt->cpu);
+    key = genlCacheHashStr(key, opt->features);
+
+    // Options that change the optimization passes or what gets emitted
+    int flags[] = { opt->release, opt->opt_level, opt->pic || opt->library, opt->wasm, opt->split,
+        opt->lto, opt->print_asm, opt->print_llvmir };
+    key = cacheHash(key, flags, sizeof(flags));
+
+    LLVMMemoryBufferRef bitcode = LLVMWriteBitcodeToMemoryBuffer(mod);
+    key = cacheHash(key, LLVMGetBufferStart(bitcode), LLVMGetBufferSize(bitcode));
+    LLVMDisposeMemoryBuffer(bitcode);
+    return key;
+}
+
+// Restore the cached outputs for code named srcname. Return 0 if not all were cached.
+int genlCacheFetch(ConeOptions *opt, uint64_t key, char *srcname) {
+    char *oext = opt->wasm? "wasm" : objext;
+    char *aext = opt->wasm? "wat" : asmext;
+    char *objpath = fileMakePath(opt->output, srcname, oext);
+    char *asmpath = opt->print_asm? fileMakePath(opt->output, srcname, aext) : NULL;
+    char *irpath = opt->print_llvmir? fileMakePath(opt->output, srcname, "ir") : NULL;
+
+    int hit = cacheFetch(key, oext, objpath)
+        && (!asmpath || cacheFetch(key, aext, asmpath))
+        && (!irpath || cacheFetch(key, "ir", irpath));
+    cacheCount(hit);
+    return hit;
+}
+
+// Keep the outputs just generated for code named srcname
+void genlCacheKeep(ConeOptions *opt, uint64_t key, char *srcname) {
+    char *oext = opt->wasm? "wasm" : objext;
+    char *aext = opt->wasm? "wat" : asmext;
+    cacheKeep(key, oext, fileMakePath(opt->output, srcname, oext));
+    if (opt->print_asm)
+        cacheKeep(key, aext, fileMakePath(opt->output, srcname, aext));
+    if (opt->print_llvmir)
+        cacheKeep(key, "ir", fileMakePath(opt->output, srcname, "ir"));
+}
@@ -0,0 +1,156 @@
+/** Function multiversioning
+ * @file
+ *
+ * A function declared with @multiversion is generated several times: once for the
+ * target CPU and once for each newer x86-64 microarchitecture level (v2, v3 with AVX2,
+ * v4 with AVX-512). Its name is bound to an ifunc, whose resolver the loader calls once,
+ * when the program starts, to pick the best clone this CPU can run. Calls then
+ * go to that clone with no further checks. So one binary can ship to a mixed fleet of machines,
+ * yet use the fast path on newer ones.
+ *
+ * The resolver uses the CPU features that libgcc (or compiler-rt) detects in __cpu_model,
+ * as __builtin_cpu_supports does. Multiversioning only applies to x86-64 targets whose
+ * CPU is generic or an x86-64 level, and whose objects are ELF (as only ELF has ifuncs);
+ * @multiversion is otherwise ignored.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "../ir/ir.h"
+#include "../shared/memory.h"
+#include "../coneopts.h"
+#include "genllvm.h"
+
+#include <string.h>
+
+// The x86-64 levels, from the lowest, with the __cpu_model feature bits each needs.
+// Bits: popcnt 2, sse3 5, ssse3 6, sse4.1 7, sse4.2 8, avx 9, avx2 10, fma 14,
+// avx512f 15, bmi 16, bmi2 17, avx512vl 20, avx512bw 21, avx512dq 22, avx512cd 23.
+// (The few features not in __cpu_model, e.g., movbe for v3, come with these on real CPUs.)
+typedef struct {
+    char *cpu;
+    uint32_t features;
+} GenCpuLevel;
+
+static GenCpuLevel genlCpuLevels[] = {
+    { "x86-64-v2", 0x0001e4 },
+    { "x86-64-v3", 0x0347e4 },
+    { "x86-64-v4", 0xf3c7e4 },
+};
+#define GenCpuLevelCnt (sizeof(genlCpuLevels) / sizeof(GenCpuLevel))
+
+// Does the target triple's OS use ELF objects (e.g., not Mach-O for darwin or COFF for windows)?
+static int genlCpuElf(char *triple) {
+    if (strstr(triple, "windows") || strstr(triple, "mingw") || strstr(triple, "cygwin"))
+        return 0;
+    return strstr(triple, "linux") || strstr(triple, "bsd") || strstr(triple, "gnu")
+        || strstr(triple, "-elf");
+}
+
+// Return the number of levels the target CPU already has, or -1 if functions cannot be multiversioned
+static int genlCpuBaseLevel(ConeOptions *opt) {
+    if (strncmp(opt->triple, "x86_64", 6) != 0 || !genlCpuElf(opt->triple))
+        return -1;
+    if (strcmp(opt->cpu, "generic") == 0 || strcmp(opt->cpu, "x86-64") == 0)
+        return 0;
+    int level;
+    for (level = 0; level < (int)GenCpuLevelCnt; ++level) {
+        if (strcmp(opt->cpu, genlCpuLevels[level].cpu) == 0)
+            return level + 1;
+    }
+    return -1;
+}
+
+// Name a clone after the function it clones and its CPU
+static char *genlCloneName(char *fnname, char *suffix) {
+    char *name = memAllocStr(fnname, strlen(fnname) + strlen(suffix) + 1);
+    strcat(name, ".");
+    strcat(name, suffix);
+    return name;
+}
+
+// The CPU a clone is for: the target's own (the default) below the base level
+static char *genlCloneCpu(int level, int base) {
+    return level < base? "default" : genlCpuLevels[level].cpu;
+}
+
+// Generate the resolver that returns the best clone for the CPU running the program
+static LLVMValueRef genlCpuResolver(GenState *gen, char *fnname, LLVMTypeRef fntype, LLVMValueRef *clones, int base) {
+    LLVMTypeRef i32type = LLVMInt32TypeInContext(gen->context);
+    LLVMTypeRef fnptrtype = LLVMPointerType(fntype, 0);
+    LLVMValueRef resolver = LLVMAddFunction(gen->module, genlCloneName(fnname, "resolver"),
+        LLVMFunctionType(fnptrtype, NULL, 0, 0));
+    LLVMSetLinkage(resolver, LLVMInternalLinkage);
+
+    // libgcc's CPU detection, which has not necessarily run yet when the resolver does
+    LLVMValueRef cpuinit = LLVMGetNamedFunction(gen->module, "__cpu_indicator_init");
+    if (!cpuinit)
+        cpuinit = LLVMAddFunction(gen->module, "__cpu_indicator_init",
+            LLVMFunctionType(LLVMVoidTypeInContext(gen->context), NULL, 0, 0));
+    LLVMValueRef cpumodel = LLVMGetNamedGlobal(gen->module, "__cpu_model");
+    if (!cpumodel) {
+        LLVMTypeRef fields[4] = { i32type, i32type, i32type, LLVMArrayType(i32type, 1) };
+        cpumodel = LLVMAddGlobal(gen->module, LLVMStructTypeInContext(gen->context, fields, 4, 0), "__cpu_model");
+    }
+
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(gen->context);
+    LLVMPositionBuilderAtEnd(builder, LLVMAppendBasicBlockInContext(gen->context, resolver, "entry"));
+    LLVMBuildCall(builder, cpuinit, NULL, 0, "");
+    LLVMValueRef indexes[3] = { LLVMConstInt(i32type, 0, 0), LLVMConstInt(i32type, 3, 0), LLVMConstInt(i32type, 0, 0) };
+    LLVMValueRef features = LLVMBuildLoad(builder, LLVMBuildInBoundsGEP(builder, cpumodel, indexes, 3, ""), "features");
+
+    // Pick the highest level whose features are all present
+    LLVMValueRef best = clones[0];
+    int level;
+    for (level = base; level < (int)GenCpuLevelCnt; ++level) {
+        LLVMValueRef needs = LLVMConstInt(i32type, genlCpuLevels[level].features, 0);
+        LLVMValueRef has = LLVMBuildICmp(builder, LLVMIntEQ, LLVMBuildAnd(builder, features, needs, ""), needs, "");
+        best = LLVMBuildSelect(builder, has, clones[level - base + 1], best, "");
+    }
+    LLVMBuildRet(builder, best);
+    LLVMDisposeBuilder(builder);
+    return resolver;
+}
+
+// Declare a @multiversion function: its clones, and the ifunc that dispatches to them.
+// Return NULL if the target cannot multiversion it, so it is declared as usual.
+LLVMValueRef genlCpuDispatch(GenState *gen, FnDclNode *glofn, char *fnname) {
+    int base = genlCpuBaseLevel(gen->opt);
+    if (base < 0 || base == (int)GenCpuLevelCnt)
+        return NULL;
+
+    // The first clone is for the target CPU, the rest add a level each
+    LLVMTypeRef fntype = genlType(gen, glofn->vtype);
+    LLVMValueRef clones[GenCpuLevelCnt + 1];
+    int level;
+    for (level = base - 1; level < (int)GenCpuLevelCnt; ++level) {
+        char *cpu = genlCloneCpu(level, base);
+        LLVMValueRef clone = LLVMAddFunction(gen->module, genlCloneName(fnname, cpu), fntype);
+        LLVMSetLinkage(clone, LLVMInternalLinkage);
+        if (level >= base)
+            LLVMAddAttributeAtIndex(clone, LLVMAttributeFunctionIndex,
+                LLVMCreateStringAttribute(gen->context, "target-cpu", 10, cpu, strlen(cpu)));
+        genlFnRefAttrs(gen, glofn, clone);
+        genlFnDebugInfo(gen, glofn, clone, genlCloneName(fnname, cpu));
+        clones[level - base + 1] = clone;
+    }
+
+    LLVMValueRef resolver = genlCpuResolver(gen, fnname, fntype, clones, base);
+    return LLVMAddGlobalIFunc(gen->module, fnname, strlen(fnname), fntype, 0, resolver);
+}
+
+// Generate the implementation of each clone of a @multiversion function
+void genlCpuClones(GenState *gen, FnDclNode *fnnode) {
+    LLVMValueRef ifunc = fnnode->llvmvar;
+    size_t len;
+    const char *name = LLVMGetValueName2(ifunc, &len);
+    char *fnname = memAllocStr((char*)name, len);
+    int base = genlCpuBaseLevel(gen->opt);
+    int level;
+    for (level = base - 1; level < (int)GenCpuLevelCnt; ++level) {
+        fnnode->llvmvar = LLVMGetNamedFunction(gen->module, genlCloneName(fnname, genlCloneCpu(level, base)));
+        genlFn(gen, fnnode);
+    }
+    fnnode->llvmvar = ifunc;
+}
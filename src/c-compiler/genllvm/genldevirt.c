@@ -0,0 +1,202 @@
+/** Devirtualization of method calls and field accesses through virtual references
+ * @file
+ *
+ * A virtual reference carries a pointer to the vtable of its object's struct.
+ * Calling a method through it loads the method's address from the vtable and calls
+ * that indirectly, which LLVM can neither inline nor optimize across.
+ * Since the whole program is type checked before it is generated, every struct
+ * that may be behind some trait's virtual reference is already known.
+ * So a method call goes directly to the implementing struct's method when:
+ * - Only one struct implements the trait's vtable, or
+ * - The virtual reference was just built from a reference to a known struct,
+ *   either right there or as the value of an immutable variable.
+ * Otherwise, if most of the places that build such virtual references do so from
+ * the same struct, its method is called directly when the vtable is that struct's,
+ * and through the vtable only when it is not.
+ *
+ * Field accesses use a constant offset when the struct is known.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "../ir/ir.h"
+#include "../shared/memory.h"
+#include "../coneopts.h"
+#include "genllvm.h"
+
+#include <assert.h>
+
+// Return the vtable for a virtual reference's trait, ensuring it has been generated
+static Vtable *genlDevirtVtable(GenState *gen, INode *vref) {
+    RefNode *vreftype = (RefNode*)iexpGetTypeDcl(vref);
+    assert(vreftype->tag == VirtRefTag);
+    Vtable *vtable = ((StructNode*)itypeGetTypeDcl(vreftype->vtexp))->vtable;
+    if (vtable->llvmvtable == NULL)
+        genlVtable(gen, vtable);
+    return vtable;
+}
+
+// Return the implementation of vtable that virtual reference vref must be using, or NULL if not known
+static VtableImpl *genlDevirtKnownImpl(GenState *gen, Vtable *vtable, INode *vref) {
+    if (gen->opt->no_devirt)
+        return NULL;
+    if (vtable->impl->used == 1)
+        return (VtableImpl*)nodesGet(vtable->impl, 0);
+
+    // An immutable variable's virtual reference is whatever it was initialized with
+    while (vref->tag == VarNameUseTag) {
+        VarDclNode *var = (VarDclNode*)((NameUseNode*)vref)->dclnode;
+        if (var->tag != VarDclTag || var->value == NULL || (permGetFlags(var->perm) & MayWrite))
+            return NULL;
+        vref = var->value;
+    }
+
+    // Is it converted from a reference to a struct (not a trait, whose vtable depends on its tag)?
+    if (vref->tag != CastTag || (vref->flags & FlagRecast))
+        return NULL;
+    INode *fromtype = iexpGetTypeDcl(((CastNode*)vref)->exp);
+    if (fromtype->tag != RefTag)
+        return NULL;
+    StructNode *strnode = (StructNode*)itypeGetTypeDcl(((RefNode*)fromtype)->vtexp);
+    if (strnode->tag != StructTag || (strnode->flags & TraitType))
+        return NULL;
+    INode **nodesp;
+    uint32_t cnt;
+    for (nodesFor(vtable->impl, cnt, nodesp)) {
+        if (((VtableImpl*)*nodesp)->structdcl == (INode*)strnode)
+            return (VtableImpl*)*nodesp;
+    }
+    return NULL;
+}
+
+// Return the implementation that most places build vtable's virtual references from,
+// if it is more than half of them, or NULL otherwise.
+static VtableImpl *genlDevirtDominantImpl(GenState *gen, Vtable *vtable, uint32_t *coercions) {
+    if (gen->opt->no_devirt)
+        return NULL;
+    VtableImpl *dominant = NULL;
+    *coercions = 0;
+    INode **nodesp;
+    uint32_t cnt;
+    for (nodesFor(vtable->impl, cnt, nodesp)) {
+        VtableImpl *impl = (VtableImpl*)*nodesp;
+        *coercions += impl->coercions;
+        if (dominant == NULL || impl->coercions > dominant->coercions)
+            dominant = impl;
+    }
+    return dominant && dominant->coercions * 2 > *coercions ? dominant : NULL;
+}
+
+// Return impl's implementation of a virtual method, if it can be called directly
+// with the arguments of the call through the vtable (recasting references), or NULL otherwise
+static FnDclNode *genlDevirtMethod(GenState *gen, VtableImpl *impl, FnDclNode *methdcl,
+    uint32_t fnargcnt, LLVMValueRef *fnargs) {
+
+    FnDclNode *implmeth = (FnDclNode*)nodesGet(impl->methfld, methdcl->vtblidx);
+    if (implmeth->tag != FnDclTag || implmeth->llvmvar == NULL || (implmeth->flags & FlagInline))
+        return NULL;
+    LLVMTypeRef fntype = LLVMGetElementType(LLVMTypeOf(implmeth->llvmvar));
+    if (LLVMGetReturnType(fntype) != genlType(gen, ((FnSigNode*)itypeGetTypeDcl(methdcl->vtype))->rettype)
+        || LLVMCountParamTypes(fntype) != fnargcnt)
+        return NULL;
+    LLVMTypeRef *parmtypes = (LLVMTypeRef*)memAllocBlk(fnargcnt * sizeof(LLVMTypeRef));
+    LLVMGetParamTypes(fntype, parmtypes);
+    if (LLVMGetTypeKind(parmtypes[0]) != LLVMPointerTypeKind)
+        return NULL;
+    uint32_t i;
+    for (i = 1; i < fnargcnt; ++i) {
+        if (LLVMTypeOf(fnargs[i]) != parmtypes[i]
+            && (LLVMGetTypeKind(LLVMTypeOf(fnargs[i])) != LLVMPointerTypeKind
+                || LLVMGetTypeKind(parmtypes[i]) != LLVMPointerTypeKind))
+            return NULL;
+    }
+    return implmeth;
+}
+
+// Build a direct call to a virtual method's implementation, passing the virtual reference's object as self
+static LLVMValueRef genlDevirtCall(GenState *gen, FnDclNode *implmeth, uint32_t fnargcnt, LLVMValueRef *fnargs) {
+    LLVMTypeRef fntype = LLVMGetElementType(LLVMTypeOf(implmeth->llvmvar));
+    LLVMTypeRef *parmtypes = (LLVMTypeRef*)memAllocBlk(fnargcnt * sizeof(LLVMTypeRef));
+    LLVMGetParamTypes(fntype, parmtypes);
+    LLVMValueRef *implargs = (LLVMValueRef*)memAllocBlk(fnargcnt * sizeof(LLVMValueRef));
+    implargs[0] = LLVMBuildExtractValue(gen->builder, fnargs[0], 0, "");
+    uint32_t i;
+    for (i = 1; i < fnargcnt; ++i)
+        implargs[i] = fnargs[i];
+    for (i = 0; i < fnargcnt; ++i) {
+        if (LLVMTypeOf(implargs[i]) != parmtypes[i])
+            implargs[i] = LLVMBuildBitCast(gen->builder, implargs[i], parmtypes[i], "");
+    }
+    return LLVMBuildCall(gen->builder, implmeth->llvmvar, implargs, fnargcnt, "");
+}
+
+// Generate a method call through a virtual reference (the first argument),
+// directly to the implementing method when that is known or likely
+LLVMValueRef genlVirtCall(GenState *gen, FnCallNode *fncall, uint32_t fnargcnt, LLVMValueRef *fnargs) {
+    INode *self = nodesGet(fncall->args, 0);
+    FnDclNode *methdcl = (FnDclNode*)((NameUseNode *)fncall->objfn)->dclnode;
+    Vtable *vtable = genlDevirtVtable(gen, self);
+
+    // Known implementation: call it directly
+    VtableImpl *impl = genlDevirtKnownImpl(gen, vtable, self);
+    FnDclNode *implmeth;
+    if (impl && (implmeth = genlDevirtMethod(gen, impl, methdcl, fnargcnt, fnargs)))
+        return genlDevirtCall(gen, implmeth, fnargcnt, fnargs);
+
+    // Likely implementation: call it directly if the vtable is its, otherwise through the vtable
+    uint32_t coercions;
+    impl = genlDevirtDominantImpl(gen, vtable, &coercions);
+    if (impl == NULL || (implmeth = genlDevirtMethod(gen, impl, methdcl, fnargcnt, fnargs)) == NULL)
+        return genlFnCallInternal(gen, VirtDispatch, fncall->objfn, fnargcnt, fnargs);
+
+    LLVMBasicBlockRef joinblk = genlInsertBlock(gen, "virtjoin");
+    LLVMBasicBlockRef virtblk = genlInsertBlock(gen, "virtcall");
+    LLVMBasicBlockRef directblk = genlInsertBlock(gen, "devirt");
+    LLVMValueRef vtablep = LLVMBuildExtractValue(gen->builder, fnargs[0], 1, "");
+    LLVMValueRef isimpl = LLVMBuildICmp(gen->builder, LLVMIntEQ, vtablep, impl->llvmvtablep, "");
+    LLVMValueRef br = LLVMBuildCondBr(gen->builder, isimpl, directblk, virtblk);
+
+    // Weigh the branch by how many places build virtual references from each
+    LLVMTypeRef i32type = LLVMInt32TypeInContext(gen->context);
+    LLVMMetadataRef weights[3] = {
+        LLVMMDStringInContext2(gen->context, "branch_weights", 14),
+        LLVMValueAsMetadata(LLVMConstInt(i32type, impl->coercions, 0)),
+        LLVMValueAsMetadata(LLVMConstInt(i32type, coercions - impl->coercions, 0))
+    };
+    LLVMSetMetadata(br, LLVMGetMDKindIDInContext(gen->context, "prof", 4),
+        LLVMMetadataAsValue(gen->context, LLVMMDNodeInContext2(gen->context, weights, 3)));
+
+    LLVMValueRef rets[2];
+    LLVMBasicBlockRef blks[2];
+    LLVMPositionBuilderAtEnd(gen->builder, directblk);
+    rets[0] = genlDevirtCall(gen, implmeth, fnargcnt, fnargs);
+    blks[0] = LLVMGetInsertBlock(gen->builder);
+    LLVMBuildBr(gen->builder, joinblk);
+
+    LLVMPositionBuilderAtEnd(gen->builder, virtblk);
+    rets[1] = genlFnCallInternal(gen, VirtDispatch, fncall->objfn, fnargcnt, fnargs);
+    blks[1] = LLVMGetInsertBlock(gen->builder);
+    LLVMBuildBr(gen->builder, joinblk);
+
+    LLVMPositionBuilderAtEnd(gen->builder, joinblk);
+    if (LLVMGetTypeKind(LLVMTypeOf(rets[0])) == LLVMVoidTypeKind)
+        return rets[0];
+    LLVMValueRef phi = LLVMBuildPhi(gen->builder, LLVMTypeOf(rets[0]), "");
+    LLVMAddIncoming(phi, rets, blks, 2);
+    return phi;
+}
+
+// Return the byte offset of a virtual field in the object a virtual reference points to,
+// as a constant if its struct is known, or else as loaded from the vtable
+LLVMValueRef genlVirtFieldOffset(GenState *gen, INode *vref, LLVMValueRef vtablep, FieldDclNode *flddcl) {
+    Vtable *vtable = genlDevirtVtable(gen, vref);
+    VtableImpl *impl = genlDevirtKnownImpl(gen, vtable, vref);
+    if (impl) {
+        FieldDclNode *implfld = (FieldDclNode*)nodesGet(impl->methfld, flddcl->vtblidx);
+        unsigned long long offset = LLVMOffsetOfElement(gen->datalayout, genlType(gen, impl->structdcl), implfld->index);
+        return LLVMConstInt(LLVMInt32TypeInContext(gen->context), offset, 0);
+    }
+    LLVMValueRef vtblfldp = LLVMBuildStructGEP(gen->builder, vtablep, flddcl->vtblidx, &flddcl->namesym->namestr); // *u32
+    return LLVMBuildLoad(gen->builder, vtblfldp, "");
+}
@@ -36,6 +36,11 @@ LLVMValueRef genlIf(GenState *gen, IfNode *ifnode) {
     INode **nodesp;
     uint32_t cnt;
 
+    // A match on one value's variant or integer value is best as a switch
+    LLVMValueRef matchval;
+    if (genlMatch(gen, ifnode, &matchval))
+        return matchval;
+
     // If we are returning a value in each block, set up space for phi info
     vtype = itypeGetTypeDcl(ifnode->vtype);
     count = ifnode->condblk->used / 2;
@@ -393,6 +398,20 @@ LLVMValueRef genlFnCall(GenState *gen, FnCallNode *fncall) {
         *fnarg++ = genlExpr(gen, *nodesp);
     }
 
+    // Intrinsics like += load and store their borrowed self's value
+    INode *self = fnargcnt > 0 ? nodesGet(fncall->args, 0) : NULL;
+    if (self && self->tag == BorrowTag && objfn->tag == VarNameUseTag) {
+        FnDclNode *fndcl = (FnDclNode *)((NameUseNode *)objfn)->dclnode;
+        if (fndcl->tag == FnDclTag && fndcl->value && fndcl->value->tag == IntrinsicTag) {
+            LLVMValueRef after = LLVMGetLastInstruction(LLVMGetInsertBlock(gen->builder));
+            LLVMValueRef fncallret = genlFnCallInternal(gen, dispatch, objfn, fnargcnt, fnargs);
+            genlTbaaAfter(gen, after, fnargs[0], ((RefNode *)self)->vtexp);
+            return fncallret;
+        }
+    }
+
+    if (dispatch == VirtDispatch)
+        return genlVirtCall(gen, fncall, fnargcnt, fnargs);
     return genlFnCallInternal(gen, dispatch, objfn, fnargcnt, fnargs);
 }
 
@@ -505,21 +524,12 @@ LLVMValueRef genlConvert(GenState *gen, INode* exp, INode* to) {
             }
         }
         else {
-            // Use tag field to lookup correct vtable
-            INode **nodesp;
-            uint32_t cnt;
-            for (nodelistFor(&strnode->fields, cnt, nodesp)) {
-                if ((*nodesp)->flags & IsTagField) {
-                    FieldDclNode *tagnode = (FieldDclNode*)*nodesp;
-                    LLVMValueRef val = LLVMBuildStructGEP(gen->builder, genexp, tagnode->index, "tagref");
-                    val = LLVMBuildLoad(gen->builder, val, "tag");
-                    LLVMValueRef indexes[2];
-                    indexes[0] = LLVMConstInt(genlUsize(gen), 0, 0);
-                    indexes[1] = val;
-                    vtablep = LLVMBuildGEP(gen->builder, vtable->llvmvtables, indexes, 2, "");
-                    vtablep = LLVMBuildLoad(gen->builder, vtablep, "");
-                }
-            }
+            // Use tag to lookup correct vtable
+            LLVMValueRef indexes[2];
+            indexes[0] = LLVMConstInt(genlUsize(gen), 0, 0);
+            indexes[1] = genlTagValue(gen, strnode, genexp, 1);
+            vtablep = LLVMBuildGEP(gen->builder, vtable->llvmvtables, indexes, 2, "");
+            vtablep = LLVMBuildLoad(gen->builder, vtablep, "");
         }
         LLVMValueRef vref = LLVMGetUndef(genlType(gen, totype));
         LLVMTypeRef vptr = LLVMPointerType(LLVMInt8TypeInContext(gen->context), 0);
@@ -635,59 +645,85 @@ LLVMValueRef genlIsType(GenState *gen, CastNode *isnode) {
         assert(0 && "Could not find specialized type's vtable");
     }
 
-    // Special handling for nullable pointers
-    if (structtype->flags & NullablePtr) {
-        LLVMTypeRef ptrtype = structtype->llvmtype;
-        if (LLVMGetTypeKind(ptrtype) != LLVMPointerTypeKind)
-            val = LLVMBuildExtractValue(gen->builder, val, 0, "ptr"); // VirtRef & ArrayRef
-        LLVMValueRef nullptr = LLVMConstPointerNull(ptrtype);
-        LLVMIntPredicate cmpop = structtype->fields.used == 1 ? LLVMIntEQ : LLVMIntNE;
-        return LLVMBuildICmp(gen->builder, cmpop, val, nullptr, "isnull");
-    }
-
     // Pattern match whether termnode's tag matches desired concrete struct type
-    // Find and extract tag field from val, then compare with to-type's tag number
-    INode **nodesp;
-    uint32_t cnt;
-    for (nodelistFor(&structtype->fields, cnt, nodesp)) {
-        if ((*nodesp)->flags & IsTagField) {
-            FieldDclNode *tagnode = (FieldDclNode*)*nodesp;
-            if (istype->tag == RefTag) {
-                val = LLVMBuildStructGEP(gen->builder, val, tagnode->index, "tagref");
-                val = LLVMBuildLoad(gen->builder, val, "tag");
-            }
-            else
-                val = LLVMBuildExtractValue(gen->builder, val, tagnode->index, "tag");
-            LLVMValueRef tagval = LLVMConstInt(genlType(gen, tagnode->vtype), structtype->tagnbr, 0);
-            return LLVMBuildICmp(gen->builder, LLVMIntEQ, val, tagval, "istag");
-        }
-    }
-    assert(0 && "Should not reach here, because type check ensures type has a tag field");
-    return NULL;
+    LLVMValueRef tag = genlTagValue(gen, structtype, val, istype->tag == RefTag);
+    LLVMValueRef tagval = LLVMConstInt(LLVMTypeOf(tag), structtype->tagnbr, 0);
+    return LLVMBuildICmp(gen->builder, LLVMIntEQ, tag, tagval, "istag");
 }
 
-// Generate a panic
-void genlPanic(GenState *gen) {
-    // Declare trap() external function
-    char *fnname = "llvm.trap";
+// Declare the panic function every failure path calls: conePanic(file, line).
+// It is cold and never returns, so LLVM moves the paths that call it out of the way
+// and does not treat them as live successors. The weak definition here just traps.
+// The runtime (conestd) may define a conePanic that first reports where it happened.
+static LLVMValueRef genlPanicFn(GenState *gen) {
+    char *fnname = "conePanic";
     LLVMValueRef fn = LLVMGetNamedFunction(gen->module, fnname);
-    if (!fn) {
-        LLVMTypeRef rettype = LLVMVoidTypeInContext(gen->context);
-        LLVMTypeRef fnsig = LLVMFunctionType(rettype, NULL, 0, 0);
-        fn = LLVMAddFunction(gen->module, fnname, fnsig);
+    if (fn)
+        return fn;
+    LLVMTypeRef parms[2] = { LLVMPointerType(LLVMInt8TypeInContext(gen->context), 0), LLVMInt32TypeInContext(gen->context) };
+    fn = LLVMAddFunction(gen->module, fnname, LLVMFunctionType(LLVMVoidTypeInContext(gen->context), parms, 2, 0));
+    LLVMSetLinkage(fn, LLVMWeakAnyLinkage);
+    char *attrs[] = { "noreturn", "cold", "noinline", "nounwind" };
+    int i;
+    for (i = 0; i < 4; ++i) {
+        unsigned kind = LLVMGetEnumAttributeKindForName(attrs[i], strlen(attrs[i]));
+        LLVMAddAttributeAtIndex(fn, LLVMAttributeFunctionIndex, LLVMCreateEnumAttribute(gen->context, kind, 0));
+    }
+
+    // Its body: llvm.trap()
+    LLVMValueRef trap = LLVMGetNamedFunction(gen->module, "llvm.trap");
+    if (!trap)
+        trap = LLVMAddFunction(gen->module, "llvm.trap", LLVMFunctionType(LLVMVoidTypeInContext(gen->context), NULL, 0, 0));
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(gen->context);
+    LLVMPositionBuilderAtEnd(builder, LLVMAppendBasicBlockInContext(gen->context, fn, "entry"));
+    LLVMBuildCall(builder, trap, NULL, 0, "");
+    LLVMBuildUnreachable(builder);
+    LLVMDisposeBuilder(builder);
+    return fn;
+}
+
+// Generate a panic, reporting srcnode's source file and line.
+// This ends the current block, as a panic never returns.
+void genlPanic(GenState *gen, INode *srcnode) {
+    LLVMValueRef fn = genlPanicFn(gen);
+
+    // Each source file's name is only stored once
+    if (gen->panicLexer != srcnode->lexer) {
+        gen->panicLexer = srcnode->lexer;
+        gen->panicFile = LLVMBuildGlobalStringPtr(gen->builder, srcnode->lexer->url, "srcfile");
     }
-    LLVMBuildCall(gen->builder, fn, NULL, 0, "");
+    LLVMValueRef args[2] = { gen->panicFile, LLVMConstInt(LLVMInt32TypeInContext(gen->context), srcnode->linenbr, 0) };
+    LLVMValueRef call = LLVMBuildCall(gen->builder, fn, args, 2, "");
+    LLVMAddCallSiteAttribute(call, LLVMAttributeFunctionIndex,
+        LLVMCreateEnumAttribute(gen->context, LLVMGetEnumAttributeKindForName("noreturn", 8), 0));
+    LLVMBuildUnreachable(gen->builder);
 }
 
-void genlBoundsCheck(GenState *gen, LLVMValueRef index, LLVMValueRef count) {
-    // Do runtime bounds check and panic
+// Branch to unlikelyblk when cond is true, which is expected to (almost) never happen.
+// unlikelyblk should be a new block, which is moved to the end of the function.
+void genlBranchUnlikely(GenState *gen, LLVMValueRef cond, LLVMBasicBlockRef unlikelyblk, LLVMBasicBlockRef likelyblk) {
+    LLVMMoveBasicBlockAfter(unlikelyblk, LLVMGetLastBasicBlock(gen->fn));
+    LLVMValueRef br = LLVMBuildCondBr(gen->builder, cond, unlikelyblk, likelyblk);
+
+    // The same weights as __builtin_expect
+    LLVMTypeRef i32type = LLVMInt32TypeInContext(gen->context);
+    LLVMMetadataRef weights[3] = {
+        LLVMMDStringInContext2(gen->context, "branch_weights", 14),
+        LLVMValueAsMetadata(LLVMConstInt(i32type, 1, 0)),
+        LLVMValueAsMetadata(LLVMConstInt(i32type, 2000, 0))
+    };
+    LLVMSetMetadata(br, LLVMGetMDKindIDInContext(gen->context, "prof", 4),
+        LLVMMetadataAsValue(gen->context, LLVMMDNodeInContext2(gen->context, weights, 3)));
+}
+
+// Panic unless index < count
+void genlBoundsCheck(GenState *gen, INode *srcnode, LLVMValueRef index, LLVMValueRef count) {
     LLVMBasicBlockRef panicblk = genlInsertBlock(gen, "panic");
     LLVMBasicBlockRef boundsblk = genlInsertBlock(gen, "boundsok");
-    LLVMValueRef compare = LLVMBuildICmp(gen->builder, LLVMIntULT, index, count, "");
-    LLVMBuildCondBr(gen->builder, compare, boundsblk, panicblk);
+    LLVMValueRef outside = LLVMBuildICmp(gen->builder, LLVMIntUGE, index, count, "");
+    genlBranchUnlikely(gen, outside, panicblk, boundsblk);
     LLVMPositionBuilderAtEnd(gen->builder, panicblk);
-    genlPanic(gen);
-    LLVMBuildBr(gen->builder, boundsblk);
+    genlPanic(gen, srcnode);
     LLVMPositionBuilderAtEnd(gen->builder, boundsblk);
 }
 
@@ -706,7 +742,8 @@ LLVMValueRef genlArrayIndex(GenState *gen, FnCallNode *fncall, ArrayNode *objtyp
         assert(dimen->tag == ULitTag);
         LLVMValueRef count = LLVMConstInt(genlUsize(gen), dimen->uintlit, 0);
         LLVMValueRef index = genlExpr(gen, nodesGet(fncall->args, arg));
-        genlBoundsCheck(gen, index, count);
+        if (!(fncall->flags & FlagInBounds))
+            genlBoundsCheck(gen, (INode*)fncall, index, count);
         indexp[arg+1] = index;
     }
     return LLVMBuildGEP(gen->builder, genlAddr(gen, fncall->objfn), indexp, nindex+1, "");
@@ -735,7 +772,8 @@ LLVMValueRef genlAddr(GenState *gen, INode *lval) {
             LLVMValueRef arrref = genlExpr(gen, fncall->objfn);
             LLVMValueRef count = LLVMBuildExtractValue(gen->builder, arrref, 1, "count");
             LLVMValueRef index = genlExpr(gen, nodesGet(fncall->args, 0));
-            genlBoundsCheck(gen, index, count);
+            if (!(fncall->flags & FlagInBounds))
+                genlBoundsCheck(gen, (INode*)fncall, index, count);
             LLVMValueRef sliceptr = LLVMBuildExtractValue(gen->builder, arrref, 0, "sliceptr");
             return LLVMBuildGEP(gen->builder, sliceptr, &index, 1, "");
         }
@@ -745,7 +783,8 @@ LLVMValueRef genlAddr(GenState *gen, INode *lval) {
             LLVMValueRef arrref = genlExpr(gen, deref->vtexp);
             LLVMValueRef count = LLVMBuildExtractValue(gen->builder, arrref, 1, "count");
             LLVMValueRef index = genlExpr(gen, nodesGet(fncall->args, 0));
-            genlBoundsCheck(gen, index, count);
+            if (!(fncall->flags & FlagInBounds))
+                genlBoundsCheck(gen, (INode*)fncall, index, count);
             LLVMValueRef sliceptr = LLVMBuildExtractValue(gen->builder, arrref, 0, "sliceptr");
             return LLVMBuildGEP(gen->builder, sliceptr, &index, 1, "");
         }
@@ -766,8 +805,7 @@ LLVMValueRef genlAddr(GenState *gen, INode *lval) {
             LLVMValueRef objVRef = genlExpr(gen, fncall->objfn);
             LLVMValueRef objpRef = LLVMBuildExtractValue(gen->builder, objVRef, 0, ""); // *u8
             LLVMValueRef vtable = LLVMBuildExtractValue(gen->builder, objVRef, 1, "");
-            LLVMValueRef vtblfldp = LLVMBuildStructGEP(gen->builder, vtable, flddcl->vtblidx, &flddcl->namesym->namestr); // *u32
-            LLVMValueRef vtblfld = LLVMBuildLoad(gen->builder, vtblfldp, "");
+            LLVMValueRef vtblfld = genlVirtFieldOffset(gen, fncall->objfn, vtable, flddcl);
             LLVMValueRef fldpRef = LLVMBuildGEP(gen->builder, objpRef, &vtblfld, 1, "");
             return LLVMBuildBitCast(gen->builder, fldpRef, LLVMPointerType(genlType(gen, flddcl->vtype), 0), "");
         }
@@ -804,9 +842,32 @@ void genlStore(GenState *gen, INode *lval, LLVMValueRef rval) {
         return;
     LLVMValueRef lvalptr = genlAddr(gen, lval);
     RefNode *reftype = (RefNode *)((IExpNode*)lval)->vtype;
-    if (reftype->tag == RefTag && isRegion(reftype->region, rcName))
-        genlRcCounter(gen, LLVMBuildLoad(gen->builder, lvalptr, "dealiasref"), -1, reftype);
-    LLVMBuildStore(gen->builder, rval, lvalptr);
+    if (reftype->tag == RefTag && isRegion(reftype->region, rcName)) {
+        LLVMValueRef oldref = LLVMBuildLoad(gen->builder, lvalptr, "dealiasref");
+        genlTbaa(gen, oldref, lval);
+        genlRcCounter(gen, oldref, -1, reftype);
+    }
+    genlTbaa(gen, LLVMBuildStore(gen->builder, rval, lvalptr), lval);
+}
+
+// Is this lval's value somewhere in memory that a reference or pointer leads to?
+static int genlIsMemory(INode *lval) {
+    switch (lval->tag) {
+    case DerefTag:
+        return 1;
+    case FldAccessTag:
+    {
+        INode *objfn = ((FnCallNode *)lval)->objfn;
+        return iexpGetTypeDcl(objfn)->tag != VirtRefTag && genlIsMemory(objfn);
+    }
+    case ArrIndexTag:
+    {
+        INode *objfn = ((FnCallNode *)lval)->objfn;
+        return iexpGetTypeDcl(objfn)->tag != ArrayTag || genlIsMemory(objfn);
+    }
+    default:
+        return 0;
+    }
 }
 
 // Generate a term
@@ -861,28 +922,19 @@ LLVMValueRef genlExpr(GenState *gen, INode *termnode) {
         INode **nodesp;
         uint32_t cnt;
         if (littype->tag == StructTag) {
-            if (littype->flags & NullablePtr) {
-                // Special optimized logic for creating nullable ref/ptr value
-                StructNode *strnode = (StructNode *)littype;
-                LLVMTypeRef ptrtype = strnode->llvmtype;
-                if (lit->args->used == 1) {
-                    if (LLVMGetTypeKind(ptrtype) != LLVMPointerTypeKind) {
-                        LLVMValueRef strval = LLVMGetUndef(ptrtype);
-                        LLVMValueRef null = LLVMConstPointerNull(LLVMStructGetTypeAtIndex(ptrtype, 0));
-                        return LLVMBuildInsertValue(gen->builder, strval, null, 0, "null");
-                    }
-                    return LLVMConstPointerNull(ptrtype);
-                }
+            // A variant's tag may not be in a field of its own
+            LLVMValueRef strval = LLVMGetUndef(genlType(gen, littype));
+            StructNode *base = structGetBaseTrait((StructNode *)littype);
+            uint32_t tagidx = base && base->taglayout ? base->taglayout->tagfld->index : size;
+            unsigned int pos = 0;
+            for (nodesFor(lit->args, cnt, nodesp)) {
+                if (pos == tagidx)
+                    strval = genlTagInsert(gen, (StructNode *)littype, strval);
                 else
-                    return genlExpr(gen, nodesGet(lit->args, 1));
-            }
-            else {
-                LLVMValueRef strval = LLVMGetUndef(genlType(gen, littype));
-                unsigned int pos = 0;
-                for (nodesFor(lit->args, cnt, nodesp))
-                    strval = LLVMBuildInsertValue(gen->builder, strval, genlExpr(gen, *nodesp), pos++, "literal");
-                return strval;
+                    strval = LLVMBuildInsertValue(gen->builder, strval, genlExpr(gen, *nodesp), pos, "literal");
+                ++pos;
             }
+            return strval;
         }
         else if (littype->tag == IntNbrTag || littype->tag == UintNbrTag || littype->tag == FloatNbrTag) {
             return genlConvert(gen, nodesGet(lit->args, 0), lit->objfn);
@@ -916,9 +968,9 @@ LLVMValueRef genlExpr(GenState *gen, INode *termnode) {
         LLVMValueRef val = genlExpr(gen, anode->exp);
         RefNode *reftype = (RefNode*)iexpGetTypeDcl(termnode);
         if (reftype->tag == RefTag) {
-            if (isRegion(reftype->region, soName))
+            if (regionIsOwner(reftype->region))
                 genlDealiasOwn(gen, val, reftype);
-            else
+            else if (anode->aliasamt != 0)   // 0 when the rc optimization pass removed it
                 genlRcCounter(gen, val, anode->aliasamt, reftype);
         }
         else if (reftype->tag == TTupleTag) {
@@ -931,7 +983,7 @@ LLVMValueRef genlExpr(GenState *gen, INode *termnode) {
                 if (*countp != 0) {
                     reftype = (RefNode *)itypeGetTypeDcl(*nodesp);
                     LLVMValueRef strval = LLVMBuildExtractValue(gen->builder, val, index, "");
-                    if (isRegion(reftype->region, soName))
+                    if (regionIsOwner(reftype->region))
                         genlDealiasOwn(gen, strval, reftype);
                     else
                         genlRcCounter(gen, strval, *countp, reftype);
@@ -946,8 +998,11 @@ LLVMValueRef genlExpr(GenState *gen, INode *termnode) {
     case ArrIndexTag:
     {
         // If no borrowing is involved, just get address of lval, then load value
-        if (!(termnode->flags & FlagBorrow))
-            return LLVMBuildLoad(gen->builder, genlAddr(gen, termnode), "");
+        if (!(termnode->flags & FlagBorrow)) {
+            LLVMValueRef elem = LLVMBuildLoad(gen->builder, genlAddr(gen, termnode), "");
+            genlTbaa(gen, elem, termnode);
+            return elem;
+        }
 
         // If borrowing, alter fncall to shortcut around the borrow node
         FnCallNode *fncall = (FnCallNode *)termnode;
@@ -967,6 +1022,12 @@ LLVMValueRef genlExpr(GenState *gen, INode *termnode) {
         else if (termnode->flags & FlagBorrow) {
             return LLVMBuildStructGEP(gen->builder, genlAddr(gen, fncall->objfn), flddcl->index, &flddcl->namesym->namestr);
         }
+        else if (genlIsMemory(fncall->objfn)) {
+            // Load just the field, not the whole struct, so the load can say what it accesses
+            LLVMValueRef fld = LLVMBuildLoad(gen->builder, genlAddr(gen, termnode), &flddcl->namesym->namestr);
+            genlTbaa(gen, fld, termnode);
+            return fld;
+        }
         else {
             return LLVMBuildExtractValue(gen->builder, genlExpr(gen, fncall->objfn), flddcl->index, &flddcl->namesym->namestr);
         }
@@ -979,9 +1040,11 @@ LLVMValueRef genlExpr(GenState *gen, INode *termnode) {
         LLVMValueRef lvalptr = genlAddr(gen, lval);
         LLVMValueRef rvalptr = genlAddr(gen, rval);
         LLVMValueRef rightval = LLVMBuildLoad(gen->builder, rvalptr, "");
+        genlTbaa(gen, rightval, rval);
         LLVMValueRef leftval = LLVMBuildLoad(gen->builder, lvalptr, "");
-        LLVMBuildStore(gen->builder, rightval, lvalptr);
-        LLVMBuildStore(gen->builder, leftval, rvalptr);
+        genlTbaa(gen, leftval, lval);
+        genlTbaa(gen, LLVMBuildStore(gen->builder, rightval, lvalptr), lval);
+        genlTbaa(gen, LLVMBuildStore(gen->builder, leftval, rvalptr), rval);
         return leftval;
     }
     case AssignTag:
@@ -994,7 +1057,8 @@ LLVMValueRef genlExpr(GenState *gen, INode *termnode) {
             // Normal assignment, except value of expression is contents of lval before mutation
             LLVMValueRef lvalptr = genlAddr(gen, lval);
             LLVMValueRef leftval = LLVMBuildLoad(gen->builder, lvalptr, "");
-            LLVMBuildStore(gen->builder, valueref, lvalptr);
+            genlTbaa(gen, leftval, lval);
+            genlTbaa(gen, LLVMBuildStore(gen->builder, valueref, lvalptr), lval);
             return leftval;
         }
 
@@ -1078,7 +1142,11 @@ LLVMValueRef genlExpr(GenState *gen, INode *termnode) {
     case ArrayAllocTag:
         return genlallocref(gen, (RefNode*)termnode);
     case DerefTag:
-        return LLVMBuildLoad(gen->builder, genlExpr(gen, ((StarNode*)termnode)->vtexp), "deref");
+    {
+        LLVMValueRef val = LLVMBuildLoad(gen->builder, genlExpr(gen, ((StarNode*)termnode)->vtexp), "deref");
+        genlTbaa(gen, val, termnode);
+        return val;
+    }
     case OrLogicTag: case AndLogicTag:
         return genlLogic(gen, (LogicNode*)termnode);
     case NotLogicTag:
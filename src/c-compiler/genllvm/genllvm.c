@@ -12,6 +12,8 @@
 #include "../coneopts.h"
 #include "../ir/nametbl.h"
 #include "../shared/fileio.h"
+#include "../shared/cache.h"
+#include "../shared/timetrace.h"
 #include "genllvm.h"
 
 #include <llvm-c/ExecutionEngine.h>
@@ -28,14 +30,6 @@
 #include <assert.h>
 #include <string.h>
 
-#ifdef _WIN32
-#define asmext "asm"
-#define objext "obj"
-#else
-#define asmext "s"
-#define objext "o"
-#endif
-
 // Generate parameter variable
 void genlParmVar(GenState *gen, VarDclNode *var) {
     assert(var->tag == VarDclTag);
@@ -48,6 +42,11 @@ void genlParmVar(GenState *gen, VarDclNode *var) {
 void genlFn(GenState *gen, FnDclNode *fnnode) {
     if ((fnnode->flags & FlagInline) || fnnode->value->tag == IntrinsicTag)
         return;
+    if (LLVMIsAGlobalIFunc(fnnode->llvmvar)) {
+        genlCpuClones(gen, fnnode);
+        return;
+    }
+    timeTraceBegin("Gen fn", fnnode->namesym? &fnnode->namesym->namestr : NULL);
 
     LLVMValueRef svfn = gen->fn;
     LLVMBuilderRef svbuilder = gen->builder;
@@ -88,6 +87,7 @@ void genlFn(GenState *gen, FnDclNode *fnnode) {
     gen->fn = svfn;
     gen->allocaPoint = svallocaPoint;
     gen->fnblock = svfnblock;
+    timeTraceEnd();
 }
 
 // Insert every alloca before the allocaPoint in the function's entry block.
@@ -153,10 +153,72 @@ char *genlMangleMethName(char *workbuf, FnDclNode *node) {
     return workbuf;
 }
 
+// Add debug metadata on an implemented function (debug mode only)
+void genlFnDebugInfo(GenState *gen, FnDclNode *glofn, LLVMValueRef fn, char *manglednm) {
+    if (gen->opt->release || !glofn->value)
+        return;
+    char *fnname = glofn->namesym? &glofn->namesym->namestr : "";
+    LLVMMetadataRef fntype = LLVMDIBuilderCreateSubroutineType(gen->dibuilder,
+        gen->difile, NULL, 0, 0);
+    LLVMMetadataRef sp = LLVMDIBuilderCreateFunction(gen->dibuilder, gen->difile,
+        fnname, strlen(fnname), manglednm, strlen(manglednm),
+        gen->difile, glofn->linenbr, fntype, 0, 1, glofn->linenbr, LLVMDIFlagPublic, 0);
+    LLVMSetSubprogram(fn, sp);
+}
+
+// Add what a reference parameter or return value guarantees as LLVM attributes at index
+static void genlRefAttrs(GenState *gen, LLVMValueRef fn, LLVMAttributeIndex index, INode *type, int isparm) {
+    RefNode *reftype = (RefNode*)itypeGetTypeDcl(type);
+    if (reftype->tag != RefTag)
+        return;
+    char *attrs[3];
+    int nattrs = 0;
+    attrs[nattrs++] = "nonnull";
+
+    // A borrowed reference's value outlives the call, so it can be read anywhere in the function.
+    // A uni reference is the only one to its value, and an imm value cannot change:
+    // either way, nothing else writes it while the function runs (noalias).
+    // Nor may the function itself write through an imm or ro reference (readonly).
+    if (reftype->region == borrowRef) {
+        LLVMTypeRef valtype = genlType(gen, reftype->vtexp);
+        if (LLVMTypeIsSized(valtype)) {
+            unsigned kind = LLVMGetEnumAttributeKindForName("dereferenceable", 15);
+            LLVMAddAttributeAtIndex(fn, index, LLVMCreateEnumAttribute(gen->context, kind,
+                LLVMABISizeOfType(gen->datalayout, valtype)));
+        }
+        uint16_t flags = permGetFlags(reftype->perm);
+        if (isparm && (!(flags & MayAlias) || (flags & (MayWrite | RaceSafe)) == RaceSafe))
+            attrs[nattrs++] = "noalias";
+        if (isparm && !(flags & MayWrite))
+            attrs[nattrs++] = "readonly";
+    }
+
+    int i;
+    for (i = 0; i < nattrs; ++i) {
+        unsigned kind = LLVMGetEnumAttributeKindForName(attrs[i], strlen(attrs[i]));
+        LLVMAddAttributeAtIndex(fn, index, LLVMCreateEnumAttribute(gen->context, kind, 0));
+    }
+}
+
+// Tell LLVM what the permissions of a function's reference parameters and return value guarantee.
+// Once the function is inlined, LLVM keeps its noalias facts as alias scopes on loads and stores.
+// Extern functions are not held to Cone's permissions, so get none.
+void genlFnRefAttrs(GenState *gen, FnDclNode *glofn, LLVMValueRef fn) {
+    if (gen->opt->no_ref_attrs || (glofn->flags & FlagExtern))
+        return;
+    FnSigNode *fnsig = (FnSigNode*)itypeGetTypeDcl(glofn->vtype);
+    genlRefAttrs(gen, fn, LLVMAttributeReturnIndex, fnsig->rettype, 0);
+    uint32_t cnt;
+    INode **nodesp;
+    LLVMAttributeIndex index = 1;
+    for (nodesFor(fnsig->parms, cnt, nodesp))
+        genlRefAttrs(gen, fn, index++, ((IExpNode*)*nodesp)->vtype, 1);
+}
+
 // Generate LLVMValueRef for a global function
 void genlGloFnName(GenState *gen, FnDclNode *glofn) {
-    // Do not generate inline functions
-    if (glofn->flags & FlagInline)
+    // Do not generate inline functions, or unused ones (--reachable)
+    if (glofn->flags & (FlagInline | FlagDeferred))
         return;
 
     // Add function to the module
@@ -164,6 +226,15 @@ void genlGloFnName(GenState *gen, FnDclNode *glofn) {
         char workbuf[2048] = { '\0' };
         char *manglednm = genlMangleMethName(workbuf, glofn);
         char *fnname = glofn->namesym? &glofn->namesym->namestr : "";
+
+        // A @multiversion function's name dispatches to its CPU-specific clones
+        if ((glofn->flags & FlagMultiversion) && glofn->value
+            && (glofn->llvmvar = genlCpuDispatch(gen, glofn, manglednm))) {
+            if (fnname[0] == '_')
+                LLVMSetVisibility(glofn->llvmvar, LLVMHiddenVisibility);
+            return;
+        }
+
         glofn->llvmvar = LLVMAddFunction(gen->module, manglednm, genlType(gen, glofn->vtype));
 
         // Specify appropriate storage class, visibility and call convention
@@ -179,15 +250,8 @@ void genlGloFnName(GenState *gen, FnDclNode *glofn) {
             LLVMSetVisibility(glofn->llvmvar, LLVMHiddenVisibility);
         }
 
-        // Add metadata on implemented functions (debug mode only)
-        if (!gen->opt->release && glofn->value) {
-            LLVMMetadataRef fntype = LLVMDIBuilderCreateSubroutineType(gen->dibuilder,
-                gen->difile, NULL, 0, 0);
-            LLVMMetadataRef sp = LLVMDIBuilderCreateFunction(gen->dibuilder, gen->difile,
-                fnname, strlen(fnname), manglednm, strlen(manglednm),
-                gen->difile, glofn->linenbr, fntype, 0, 1, glofn->linenbr, LLVMDIFlagPublic, 0);
-            LLVMSetSubprogram(glofn->llvmvar, sp);
-        }
+        genlFnRefAttrs(gen, glofn, glofn->llvmvar);
+        genlFnDebugInfo(gen, glofn, glofn->llvmvar, manglednm);
     }
 }
 
@@ -258,7 +322,7 @@ void genlGlobalImpl(GenState *gen, INode *node) {
                 genlFn(gen, (FnDclNode*)*nodesp);
             }
         }
-        else if (((FnDclNode*)node)->value) {
+        else if (((FnDclNode*)node)->value && !(node->flags & FlagDeferred)) {
             genlFn(gen, (FnDclNode*)node);
         }
         break;
@@ -283,9 +347,17 @@ void genlPackage(GenState *gen, ProgramNode *pgm) {
         gen->difile = LLVMDIBuilderCreateFile(gen->dibuilder, "main.cone", 9, ".", 1);
         gen->compileUnit = LLVMDIBuilderCreateCompileUnit(gen->dibuilder, LLVMDWARFSourceLanguageC,
             gen->difile, "Cone compiler", 13, 0, "", 0, 0, "", 0, LLVMDWARFEmissionFull, 0, 0, 0, "", 0, "", 0);
+        // Without the version flag, reading the module back in (e.g., when splitting) drops debug info
+        LLVMAddModuleFlag(gen->module, LLVMModuleFlagBehaviorWarning, "Debug Info Version", 18,
+            LLVMValueAsMetadata(LLVMConstInt(LLVMInt32TypeInContext(gen->context), LLVMDebugMetadataVersion(), 0)));
     }
 
     // First, generate global symbols for all modules, so that forward references succeed
+    // When splitting, remember where each module's symbols end, to know which module owns them
+    if (gen->opt->split) {
+        gen->modlastfn = (LLVMValueRef*)memAllocBlk(pgm->modules->used * sizeof(LLVMValueRef));
+        gen->modlastglobal = (LLVMValueRef*)memAllocBlk(pgm->modules->used * sizeof(LLVMValueRef));
+    }
     INode **nodesp;
     uint32_t cnt;
     for (nodesFor(pgm->modules, cnt, nodesp)) {
@@ -296,6 +368,11 @@ void genlPackage(GenState *gen, ProgramNode *pgm) {
         for (nodesFor(mod->nodes, icnt, inodesp)) {
             genlGlobalSyms(gen, *inodesp);
         }
+        if (gen->opt->split) {
+            uint32_t modindex = pgm->modules->used - cnt;
+            gen->modlastfn[modindex] = LLVMGetLastFunction(gen->module);
+            gen->modlastglobal[modindex] = LLVMGetLastGlobal(gen->module);
+        }
     }
 
     // Now generate implementation logic, including function logic or var init
@@ -337,10 +414,21 @@ LLVMTargetMachineRef genlCreateMachine(ConeOptions *opt) {
     }
 
     // Create a specific target machine
-    opt_level = opt->release? LLVMCodeGenLevelAggressive : LLVMCodeGenLevelNone;
+    switch (opt->opt_level) {
+    case '0': opt_level = LLVMCodeGenLevelNone; break;
+    case '1': opt_level = LLVMCodeGenLevelLess; break;
+    case '3': opt_level = LLVMCodeGenLevelAggressive; break;
+    default: opt_level = LLVMCodeGenLevelDefault; break;
+    }
     reloc = (opt->pic || opt->library)? LLVMRelocPIC : LLVMRelocDefault;
     if (!opt->cpu)
         opt->cpu = "generic";
+    // Target the host's CPU, with all the features it has
+    else if (strcmp(opt->cpu, "native") == 0) {
+        opt->cpu = LLVMGetHostCPUName();
+        if (!opt->features)
+            opt->features = LLVMGetHostCPUFeatures();
+    }
     if (!opt->features)
         opt->features = "";
     if (!(machine = LLVMCreateTargetMachine(target, opt->triple, opt->cpu, opt->features, opt_level, reloc, LLVMCodeModelDefault))) {
@@ -351,17 +439,28 @@ LLVMTargetMachineRef genlCreateMachine(ConeOptions *opt) {
     return machine;
 }
 
-// Generate requested object file
-void genlOut(char *objpath, char *asmpath, LLVMModuleRef mod, char *triple, LLVMTargetMachineRef machine) {
-    char *err;
-    LLVMTargetDataRef dataref;
-    char *layout;
-
+// Give the module its target's triple and data layout
+void genlSetTarget(LLVMModuleRef mod, char *triple, LLVMTargetMachineRef machine) {
     LLVMSetTarget(mod, triple);
-    dataref = LLVMCreateTargetDataLayout(machine);
-    layout = LLVMCopyStringRepOfTargetData(dataref);
+    LLVMTargetDataRef dataref = LLVMCreateTargetDataLayout(machine);
+    char *layout = LLVMCopyStringRepOfTargetData(dataref);
     LLVMSetDataLayout(mod, layout);
     LLVMDisposeMessage(layout);
+    LLVMDisposeTargetData(dataref);
+}
+
+// Generate requested object file (holding LLVM bitcode instead of machine code, if bitcode is set)
+void genlOut(char *objpath, char *asmpath, LLVMModuleRef mod, char *triple, LLVMTargetMachineRef machine, int bitcode) {
+    char *err;
+
+    timeTraceBegin("Emit", objpath);
+    genlSetTarget(mod, triple, machine);
+
+    // A bitcode object file is written first, as emitting machine code alters the module
+    if (bitcode) {
+        if (LLVMWriteBitcodeToFile(mod, objpath) != 0)
+            errorMsg(ErrorGenErr, "Could not emit bitcode file %s", objpath);
+    }
 
     // Generate assembly file if requested
     if (asmpath && LLVMTargetMachineEmitToFile(machine, mod, asmpath, LLVMAssemblyFile, &err) != 0) {
@@ -370,18 +469,67 @@ void genlOut(char *objpath, char *asmpath, LLVMModuleRef mod, char *triple, LLVM
     }
 
     // Generate .o or .obj file
-    if (LLVMTargetMachineEmitToFile(machine, mod, objpath, LLVMObjectFile, &err) != 0) {
+    if (!bitcode && LLVMTargetMachineEmitToFile(machine, mod, objpath, LLVMObjectFile, &err) != 0) {
         errorMsg(ErrorGenErr, "Could not emit obj file: %s", err);
         LLVMDisposeMessage(err);
     }
+    timeTraceEnd();
+}
+
+// Serialize the LLVM IR to a file
+void genlPrintModule(LLVMModuleRef mod, char *path) {
+    char *err;
+    if (LLVMPrintModuleToFile(mod, path, &err) != 0) {
+        errorMsg(ErrorGenErr, "Could not emit LLVM IR file %s: %s", path, err);
+        LLVMDisposeMessage(err);
+    }
+}
+
+// Generate object (and asm, if requested) files named after srcname
+// With --lto, the object file holds LLVM bitcode, for the linker to optimize
+void genlOutFiles(ConeOptions *opt, char *srcname, LLVMModuleRef mod, LLVMTargetMachineRef machine) {
+    genlOut(fileMakePath(opt->output, srcname, opt->wasm? "wasm" : objext),
+        opt->print_asm? fileMakePath(opt->output, srcname, opt->wasm? "wat" : asmext) : NULL,
+        mod, opt->triple, machine, opt->lto);
+}
+
+// Optimize the generated LLVM IR, using LLVM's standard pipeline for the -O level.
+// The target machine (if any) lets LLVM tune for the target (e.g., vector widths and costs).
+void genlOptimize(ConeOptions *opt, LLVMModuleRef mod, LLVMTargetMachineRef machine) {
+    // With --lto, only run what is worth doing before the linker optimizes the whole program
+    char *pipeline;
+    switch (opt->opt_level) {
+    case '0': pipeline = opt->lto? "lto-pre-link<O0>" : "default<O0>"; break;
+    case '1': pipeline = opt->lto? "lto-pre-link<O1>" : "default<O1>"; break;
+    case '3': pipeline = opt->lto? "lto-pre-link<O3>" : "default<O3>"; break;
+    case 's': pipeline = opt->lto? "lto-pre-link<Os>" : "default<Os>"; break;
+    case 'z': pipeline = opt->lto? "lto-pre-link<Oz>" : "default<Oz>"; break;
+    default: pipeline = opt->lto? "lto-pre-link<O2>" : "default<O2>"; break;
+    }
+
+    // Vectorize and unroll loops at -O2 and up, as clang does (-Os skips unrolling, -Oz both)
+    int speed = opt->opt_level == '2' || opt->opt_level == '3';
+    int vectorize = speed || opt->opt_level == 's';
+
+    if (machine)
+        genlSetTarget(mod, opt->triple, machine);
+    timeTraceBegin("Optimize", pipeline);
+    LLVMErrorRef err = genlRunPasses(mod, pipeline, machine, vectorize, speed);
+    if (err) {
+        char *msg = LLVMGetErrorMessage(err);
+        errorMsg(ErrorGenErr, "Could not optimize: %s", msg);
+        LLVMDisposeErrorMessage(msg);
+    }
+    timeTraceEnd();
 }
 
 // Generate IR nodes into LLVM IR using LLVM
 void genpgm(GenState *gen, ProgramNode *pgm) {
-    char *err;
 
     // Generate IR to LLVM IR 
+    timeTraceBegin("LLVM gen", NULL);
     genlPackage(gen, pgm);
+    timeTraceEnd();
 
     // Verify generated IR
     if (gen->opt->verify) {
@@ -396,36 +544,51 @@ void genpgm(GenState *gen, ProgramNode *pgm) {
     }
 
     // Serialize the LLVM IR, if requested
-    if (gen->opt->print_llvmir && LLVMPrintModuleToFile(gen->module, fileMakePath(gen->opt->output, gen->opt->srcname, "preir"), &err) != 0) {
-        errorMsg(ErrorGenErr, "Could not emit pre-ir file: %s", err);
-        LLVMDisposeMessage(err);
+    if (gen->opt->print_llvmir)
+        genlPrintModule(gen->module, fileMakePath(gen->opt->output, gen->opt->srcname, "preir"));
+
+    // Load the runtime's bitcode, to be linked into the code so its functions can be inlined
+    int runtime = gen->opt->runtimebc && genlRuntimeLoad(gen->opt);
+
+    // Optimize and emit each module separately (and concurrently), if requested
+    if (gen->opt->split) {
+        genlSplit(gen, pgm);
+        LLVMDisposeModule(gen->module);
+        return;
+    }
+
+    if (runtime) {
+        if (gen->machine)
+            genlSetTarget(gen->module, gen->opt->triple, gen->machine);
+        genlRuntimeLink(gen->module, 1);
+    }
+
+    // Reuse the code generated earlier from the same LLVM IR, if cached
+    int caching = cacheEnabled() && gen->machine;
+    uint64_t cachekey;
+    if (caching) {
+        timerBegin(CodeGenTimer);
+        cachekey = genlCacheKey(gen->opt, gen->module);
+        if (genlCacheFetch(gen->opt, cachekey, gen->opt->srcname)) {
+            LLVMDisposeModule(gen->module);
+            return;
+        }
     }
 
     // Optimize the generated LLVM IR
     timerBegin(OptTimer);
-    LLVMPassManagerRef passmgr = LLVMCreatePassManager();
-    LLVMAddPromoteMemoryToRegisterPass(passmgr);     // Demote allocas to registers.
-    //LLVMAddInstructionCombiningPass(passmgr);        // Do simple "peephole" and bit-twiddling optimizations
-    LLVMAddReassociatePass(passmgr);                 // Reassociate expressions.
-    LLVMAddGVNPass(passmgr);                         // Eliminate common subexpressions.
-    LLVMAddCFGSimplificationPass(passmgr);           // Simplify the control flow graph
-    if (gen->opt->release)
-        LLVMAddFunctionInliningPass(passmgr);        // Function inlining
-    LLVMRunPassManager(passmgr, gen->module);
-    LLVMDisposePassManager(passmgr);
+    genlOptimize(gen->opt, gen->module, gen->machine);
 
     // Serialize the LLVM IR, if requested
-    if (gen->opt->print_llvmir && LLVMPrintModuleToFile(gen->module, fileMakePath(gen->opt->output, gen->opt->srcname, "ir"), &err) != 0) {
-        errorMsg(ErrorGenErr, "Could not emit ir file: %s", err);
-        LLVMDisposeMessage(err);
-    }
+    if (gen->opt->print_llvmir)
+        genlPrintModule(gen->module, fileMakePath(gen->opt->output, gen->opt->srcname, "ir"));
 
     // Transform IR to target's ASM and OBJ
     timerBegin(CodeGenTimer);
     if (gen->machine)
-        genlOut(fileMakePath(gen->opt->output, gen->opt->srcname, gen->opt->wasm? "wasm" : objext),
-            gen->opt->print_asm? fileMakePath(gen->opt->output, gen->opt->srcname, gen->opt->wasm? "wat" : asmext) : NULL,
-            gen->module, gen->opt->triple, gen->machine);
+        genlOutFiles(gen->opt, gen->opt->srcname, gen->module, gen->machine);
+    if (caching && errors == 0)
+        genlCacheKeep(gen->opt, cachekey, gen->opt->srcname);
 
     LLVMDisposeModule(gen->module);
     // LLVMContextDispose(gen.context);  // Only need if we created a new context
@@ -452,8 +615,13 @@ void genSetup(GenState *gen, ConeOptions *opt) {
     gen->block = NULL;
     gen->blockstack = memAllocBlk(sizeof(GenBlockState)*GenBlockStackMax);
     gen->blockstackcnt = 0;
+    gen->modlastfn = NULL;
+    gen->modlastglobal = NULL;
+    gen->panicLexer = NULL;
+    gen->panicFile = NULL;
 
     gen->emptyStructType = genlEmptyStruct(gen);
+    gen->tbaaroot = NULL;
 }
 
 void genClose(GenState *gen) {
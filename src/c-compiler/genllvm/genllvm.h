@@ -13,8 +13,17 @@
 
 #include <llvm-c/Core.h>
 #include <llvm-c/DebugInfo.h>
+#include <llvm-c/Error.h>
 #include <llvm-c/ExecutionEngine.h>
 
+#ifdef _WIN32
+#define asmext "asm"
+#define objext "obj"
+#else
+#define asmext "s"
+#define objext "o"
+#endif
+
 // An entry for each active loop block in current control flow stack
 #define GenBlockStackMax 256
 typedef struct {
@@ -26,6 +35,38 @@ typedef struct {
     uint32_t phiCnt;
 } GenBlockState;
 
+// The scalar types in the TBAA type tree (see genlTbaa)
+enum GenTbaaScalar {
+    TbaaByte,       // u8, i8 and Bool, whose accesses may alias any value's bytes
+    TbaaInt16,
+    TbaaInt32,
+    TbaaInt64,
+    TbaaFloat32,
+    TbaaFloat64,
+    TbaaPointer,    // All references and pointers
+    TbaaScalars
+};
+
+// Where a tagged trait's variants keep their tag (see genlniche.c)
+enum GenTagKind {
+    TagLeading,     // In the tag field
+    TagTrailing,    // After all fields, in what would otherwise be padding
+    TagNiche        // In values that a field of the dataful variant never holds
+};
+
+// How a tagged trait's tag is stored and found.
+// Tag number t is stored as value start + t - lo, except for the dataful variant's.
+typedef struct GenTagLayout {
+    int kind;                   // GenTagKind
+    FieldDclNode *tagfld;       // The trait's tag field
+    StructNode *dataful;        // Variant whose tag is implied by a valid value there, or NULL
+    LLVMTypeRef valtype;        // Type of the value that stores the tag (an integer or pointer)
+    unsigned long long offset;  // Its byte offset in every variant
+    uint64_t start;             // Value that stores tag number lo
+    uint64_t count;             // Number of values, from start, that may store a tag
+    uint32_t lo, hi;            // Tag numbers stored there
+} GenTagLayout;
+
 typedef struct GenState {
     LLVMTargetMachineRef machine;
     LLVMTargetDataRef datalayout;
@@ -42,6 +83,15 @@ typedef struct GenState {
 
     LLVMTypeRef emptyStructType;
 
+    LLVMMetadataRef tbaaroot;                   // Root of the TBAA type tree, made when first needed
+    LLVMMetadataRef tbaascalar[TbaaScalars];    // TBAA type nodes for scalar types
+
+    Lexer *panicLexer;              // Source file whose name panicFile points to
+    LLVMValueRef panicFile;
+
+    LLVMValueRef *modlastfn;        // Last function declared for each module (when splitting)
+    LLVMValueRef *modlastglobal;    // Last global declared for each module (when splitting)
+
     ConeOptions *opt;
     INode *fnblock;
     GenBlockState *blockstack;
@@ -61,6 +111,50 @@ void genpgm(GenState *gen, ProgramNode *pgm);
 void genlFn(GenState *gen, FnDclNode *fnnode);
 void genlGloVarName(GenState *gen, VarDclNode *glovar);
 void genlGloFnName(GenState *gen, FnDclNode *glofn);
+// Add debug metadata on an implemented function (debug mode only)
+void genlFnDebugInfo(GenState *gen, FnDclNode *glofn, LLVMValueRef fn, char *manglednm);
+// Add LLVM attributes for what a function's reference parameters and return value guarantee
+void genlFnRefAttrs(GenState *gen, FnDclNode *glofn, LLVMValueRef fn);
+// Use provided options (triple, etc.) to creation a machine
+LLVMTargetMachineRef genlCreateMachine(ConeOptions *opt);
+// Give the module its target's triple and data layout
+void genlSetTarget(LLVMModuleRef mod, char *triple, LLVMTargetMachineRef machine);
+// Optimize the generated LLVM IR
+void genlOptimize(ConeOptions *opt, LLVMModuleRef mod, LLVMTargetMachineRef machine);
+// Generate requested object file
+void genlOut(char *objpath, char *asmpath, LLVMModuleRef mod, char *triple, LLVMTargetMachineRef machine, int bitcode);
+// Serialize the LLVM IR to a file
+void genlPrintModule(LLVMModuleRef mod, char *path);
+// Generate object (and asm, if requested) files named after srcname
+void genlOutFiles(ConeOptions *opt, char *srcname, LLVMModuleRef mod, LLVMTargetMachineRef machine);
+
+// genlcache.c
+// Compute the cache key for code generated from mod (before it is optimized)
+uint64_t genlCacheKey(ConeOptions *opt, LLVMModuleRef mod);
+// Restore the cached outputs for code named srcname. Return 0 if not all were cached.
+int genlCacheFetch(ConeOptions *opt, uint64_t key, char *srcname);
+// Keep the outputs just generated for code named srcname
+void genlCacheKeep(ConeOptions *opt, uint64_t key, char *srcname);
+
+// genlcpu.c
+// Declare a @multiversion function's clones and dispatching ifunc. Return NULL if it cannot be.
+LLVMValueRef genlCpuDispatch(GenState *gen, FnDclNode *glofn, char *fnname);
+// Generate the implementation of each clone of a @multiversion function
+void genlCpuClones(GenState *gen, FnDclNode *fnnode);
+
+// genlpasses.cpp
+// Run an LLVM pass pipeline over mod, tuned as asked, tracing each pass with --time-trace
+LLVMErrorRef genlRunPasses(LLVMModuleRef mod, char *pipeline, LLVMTargetMachineRef machine, int vectorize, int unroll);
+
+// genlruntime.c
+// Load the runtime's bitcode, once, before any modules link it in. Return 0 if not found.
+int genlRuntimeLoad(ConeOptions *opt);
+// Link the runtime's bitcode into mod, making its definitions internal to mod if asked.
+void genlRuntimeLink(LLVMModuleRef mod, int internal);
+
+// genlsplit.c
+// Optimize and emit each module's code as a separate object file, using several threads
+void genlSplit(GenState *gen, ProgramNode *pgm);
 
 // genlstmt.c
 LLVMBasicBlockRef genlInsertBlock(GenState *gen, char *name);
@@ -70,8 +164,35 @@ LLVMValueRef genlBlock(GenState *gen, BlockNode *blk);
 LLVMValueRef genlExpr(GenState *gen, INode *termnode);
 // Generate a function call, including special intrinsics (Internal version)
 LLVMValueRef genlFnCallInternal(GenState *gen, int dispatch, INode *objfn, uint32_t fnargcnt, LLVMValueRef *fnargs);
-// Generate a panic
-void genlPanic(GenState *gen);
+// Generate a panic, reporting srcnode's source file and line
+void genlPanic(GenState *gen, INode *srcnode);
+// Branch to unlikelyblk when cond is true, which is expected to (almost) never happen
+void genlBranchUnlikely(GenState *gen, LLVMValueRef cond, LLVMBasicBlockRef unlikelyblk, LLVMBasicBlockRef likelyblk);
+
+// genldevirt.c
+// Generate a method call through a virtual reference (the first argument),
+// directly to the implementing method when that is known or likely
+LLVMValueRef genlVirtCall(GenState *gen, FnCallNode *fncall, uint32_t fnargcnt, LLVMValueRef *fnargs);
+// Return the byte offset of a virtual field in the object a virtual reference points to
+LLVMValueRef genlVirtFieldOffset(GenState *gen, INode *vref, LLVMValueRef vtablep, FieldDclNode *flddcl);
+
+// genlmatch.c
+// Generate an if whose conditions test one variable's variant or integer value as a switch.
+// Return 0 (generating nothing) if it is not like that.
+int genlMatch(GenState *gen, IfNode *ifnode, LLVMValueRef *result);
+
+// genlniche.c
+// Record that a tagged trait's variants keep their tag in its tag field
+void genlTagInit(GenState *gen, StructNode *base, FieldDclNode *tagfld);
+// Generate the types of a same-size tagged trait (whose variants' types are opaque so far),
+// keeping the tag in unused values or padding, if that makes them smaller. Return 0 if not.
+int genlTagLayout(GenState *gen, StructNode *base);
+// Generate the type of a same-size trait, whose variants' types are all laid out
+void genlSameSizeBase(GenState *gen, StructNode *base, LLVMTypeRef layouttype);
+// Generate the tag number of a tagged trait's value (or what a reference to it points to)
+LLVMValueRef genlTagValue(GenState *gen, StructNode *strnode, LLVMValueRef val, int isref);
+// Store a variant's tag into a value of its type
+LLVMValueRef genlTagInsert(GenState *gen, StructNode *strnode, LLVMValueRef strval);
 
 // genlalloc.c
 // Build usable metadata about a reference 
@@ -97,5 +218,9 @@ LLVMTypeRef genlUsize(GenState *gen);
 LLVMTypeRef genlEmptyStruct(GenState* gen);
 // Generate a vtable type
 void genlVtable(GenState *gen, Vtable *vtable);
+// Attach TBAA metadata to a load or store of lval's value
+void genlTbaa(GenState *gen, LLVMValueRef inst, INode *lval);
+// Attach TBAA metadata to the loads and stores through ptr (to lval) that follow instruction after
+void genlTbaaAfter(GenState *gen, LLVMValueRef after, LLVMValueRef ptr, INode *lval);
 
 #endif
@@ -0,0 +1,266 @@
+/** Generate a match as a switch
+ * @file
+ *
+ * A match is parsed into an if .. elif chain whose conditions all test one
+ * captured value (see parseMatch). Generated as is, each case tests in turn,
+ * so it takes longer to reach later cases. When every condition checks the same
+ * variable for a variant (`is` or a bound pattern) or for equality with an integer
+ * literal, the chain is instead generated as one LLVM switch. LLVM then lowers that
+ * to a jump table, bit tests, or a balanced tree of range checks, whichever suits
+ * the case values. So the dispatch takes constant (or logarithmic) time however
+ * many cases there are.
+ *
+ * The value switched on is:
+ * - The tag of a tagged struct, or of what a reference points to
+ * - The implementation index stored in a virtual reference's vtable
+ * - An integer itself
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "../ir/ir.h"
+#include "../shared/memory.h"
+#include "../coneopts.h"
+#include "genllvm.h"
+
+#include <string.h>
+
+// How a match case's condition finds the value it switches on
+enum GenMatchKind {
+    MatchNone,      // Not a switchable condition
+    MatchTag,       // Tag field of a struct value
+    MatchTagRef,    // Tag field of the struct a reference points to
+    MatchVirtRef,   // Implementation index in a virtual reference's vtable
+    MatchInt        // The integer value itself
+};
+
+// What a match case's condition tests
+typedef struct {
+    INode *var;             // The variable whose value is tested
+    int kind;               // How to get the switched-on value (GenMatchKind)
+    StructNode *variant;    // Variant tested for, for MatchTag or MatchTagRef
+    Vtable *vtable;         // The virtual reference's vtable, for MatchVirtRef
+    uint64_t caseval;       // Value the condition is true for
+    int exhaustive;         // Whether cases for each caseval cover every possible value
+} GenMatchCase;
+
+// Return the tag field of a tagged struct, or NULL if it has none
+static FieldDclNode *genlMatchTagField(StructNode *strnode) {
+    INode **nodesp;
+    uint32_t cnt;
+    for (nodelistFor(&strnode->fields, cnt, nodesp)) {
+        if ((*nodesp)->flags & IsTagField)
+            return (FieldDclNode*)*nodesp;
+    }
+    return NULL;
+}
+
+// Describe what a condition tests into mcase. Return 0 if it cannot be switched on.
+static int genlMatchCase(GenState *gen, INode *cond, GenMatchCase *mcase) {
+    mcase->kind = MatchNone;
+
+    // Is a variable's value some variant?
+    if (cond->tag == IsTag) {
+        CastNode *isnode = (CastNode*)cond;
+        if (isnode->exp->tag != VarNameUseTag)
+            return 0;
+        mcase->var = ((NameUseNode*)isnode->exp)->dclnode;
+        INode *exptype = iexpGetTypeDcl(isnode->exp);
+        INode *istype = itypeGetTypeDcl(isnode->typ);
+        StructNode *structtype = (StructNode*)(istype->tag == RefTag ? itypeGetTypeDcl(((RefNode*)istype)->vtexp) : istype);
+        if (structtype->tag != StructTag || (structtype->flags & TraitType))
+            return 0;
+
+        // A virtual reference's variant is known by its vtable
+        if (exptype->tag == VirtRefTag) {
+            mcase->vtable = ((StructNode*)itypeGetTypeDcl(((RefNode*)exptype)->vtexp))->vtable;
+            INode **nodesp;
+            uint32_t cnt;
+            for (nodesFor(mcase->vtable->impl, cnt, nodesp)) {
+                if (((VtableImpl*)*nodesp)->structdcl == (INode*)structtype) {
+                    mcase->kind = MatchVirtRef;
+                    mcase->caseval = mcase->vtable->impl->used - cnt;
+                    return 1;
+                }
+            }
+            return 0;
+        }
+
+        // Otherwise by its tag
+        if (genlMatchTagField(structtype) == NULL)
+            return 0;
+        mcase->variant = structtype;
+        mcase->kind = istype->tag == RefTag ? MatchTagRef : MatchTag;
+        mcase->caseval = structtype->tagnbr;
+        return 1;
+    }
+
+    // Does a variable's integer value equal a literal (or named constant)?
+    if (cond->tag == FnCallTag) {
+        FnCallNode *fncall = (FnCallNode*)cond;
+        if (fncall->objfn->tag != VarNameUseTag || fncall->args->used != 2)
+            return 0;
+        FnDclNode *fndcl = (FnDclNode*)((NameUseNode*)fncall->objfn)->dclnode;
+        if (fndcl->tag != FnDclTag || fndcl->value == NULL || fndcl->value->tag != IntrinsicTag
+            || ((IntrinsicNode*)fndcl->value)->intrinsicFn != EqIntrinsic)
+            return 0;
+        INode *var = nodesGet(fncall->args, 0);
+        INode *lit = nodesGet(fncall->args, 1);
+        INode *vartype = iexpGetTypeDcl(var);
+        if (var->tag != VarNameUseTag || (vartype->tag != UintNbrTag && vartype->tag != IntNbrTag))
+            return 0;
+        // An untyped literal is converted to the variable's type
+        while (lit->tag == VarNameUseTag && ((NameUseNode*)lit)->dclnode->tag == ConstDclTag)
+            lit = ((ConstDclNode*)((NameUseNode*)lit)->dclnode)->value;
+        if (lit->tag == CastTag)
+            lit = ((CastNode*)lit)->exp;
+        if (lit->tag != ULitTag)
+            return 0;
+        mcase->var = ((NameUseNode*)var)->dclnode;
+        mcase->kind = MatchInt;
+        // Keep only the bits the switch compares, so literals for the same value are seen as repeats
+        mcase->caseval = ((ULitNode*)lit)->uintlit;
+        unsigned bits = ((NbrNode*)vartype)->bits;
+        if (bits < 64)
+            mcase->caseval &= ((uint64_t)1 << bits) - 1;
+        return 1;
+    }
+    return 0;
+}
+
+// Return the cases of an if (the last for else, if any), if it can be generated as a switch, or NULL otherwise
+static GenMatchCase *genlMatchCases(GenState *gen, IfNode *ifnode) {
+    if (gen->opt->no_switch)
+        return NULL;
+    uint32_t count = ifnode->condblk->used / 2;
+    GenMatchCase *cases = (GenMatchCase*)memAllocBlk(count * sizeof(GenMatchCase));
+    GenMatchCase *mcase = cases;
+    INode **nodesp;
+    uint32_t cnt;
+    for (nodesFor(ifnode->condblk, cnt, nodesp)) {
+        if (*nodesp == elseCond)
+            mcase->kind = MatchNone;
+        else if (!genlMatchCase(gen, *nodesp, mcase)
+            || (mcase != cases && (mcase->var != cases->var || mcase->kind != cases->kind)))
+            return NULL;
+        ++mcase;
+        ++nodesp; --cnt;
+    }
+
+    // A single test is as good as a switch
+    uint32_t ncases = cases[count - 1].kind == MatchNone ? count - 1 : count;
+    if (ncases < 2)
+        return NULL;
+
+    // Do the cases cover every implementation of a virtual reference's vtable?
+    cases->exhaustive = 0;
+    if (cases->kind == MatchVirtRef) {
+        uint32_t implcnt = cases->vtable->impl->used;
+        char *covered = memAllocBlk(implcnt);
+        memset(covered, 0, implcnt);
+        uint32_t ncovered = 0;
+        for (mcase = cases; mcase < cases + ncases; ++mcase) {
+            if (!covered[mcase->caseval]) {
+                covered[mcase->caseval] = 1;
+                ++ncovered;
+            }
+        }
+        cases->exhaustive = ncovered == implcnt;
+    }
+    return cases;
+}
+
+// Generate the value a match switches on
+static LLVMValueRef genlMatchValue(GenState *gen, GenMatchCase *mcase, INode *cond) {
+    INode *var = cond->tag == IsTag ? ((CastNode*)cond)->exp : nodesGet(((FnCallNode*)cond)->args, 0);
+    LLVMValueRef val = genlExpr(gen, var);
+    switch (mcase->kind) {
+    case MatchTag:
+    case MatchTagRef:
+        return genlTagValue(gen, mcase->variant, val, mcase->kind == MatchTagRef);
+    case MatchVirtRef: {
+        if (mcase->vtable->llvmvtable == NULL)
+            genlVtable(gen, mcase->vtable);
+        LLVMValueRef vtablep = LLVMBuildExtractValue(gen->builder, val, 1, "");
+        val = LLVMBuildStructGEP(gen->builder, vtablep, mcase->vtable->methfld->used, "implidx");
+        return LLVMBuildLoad(gen->builder, val, "impl");
+    }
+    default:
+        return val;
+    }
+}
+
+// Generate an if whose conditions test one variable's variant or integer value as a switch.
+// Return 0 (generating nothing) if it is not like that.
+int genlMatch(GenState *gen, IfNode *ifnode, LLVMValueRef *result) {
+    GenMatchCase *cases = genlMatchCases(gen, ifnode);
+    if (cases == NULL)
+        return 0;
+
+    // If we are returning a value in each block, set up space for phi info
+    INode *vtype = itypeGetTypeDcl(ifnode->vtype);
+    uint32_t count = ifnode->condblk->used / 2;
+    uint32_t phicnt = 0;
+    LLVMValueRef *blkvals = NULL;
+    LLVMBasicBlockRef *blks = NULL;
+    if (vtype != unknownType) {
+        blkvals = memAllocBlk(count * sizeof(LLVMValueRef));
+        blks = memAllocBlk(count * sizeof(LLVMBasicBlockRef));
+    }
+
+    // Switch to each case's block (the first, when cases repeat a value).
+    // Otherwise go to else's block, or past the match (unless every value has a case).
+    LLVMValueRef val = genlMatchValue(gen, cases, nodesGet(ifnode->condblk, 0));
+    LLVMTypeRef valtype = LLVMTypeOf(val);
+    LLVMBasicBlockRef switchblk = LLVMGetInsertBlock(gen->builder);
+    LLVMBasicBlockRef endif = genlInsertBlock(gen, "endif");
+    LLVMBasicBlockRef *caseblks = memAllocBlk(count * sizeof(LLVMBasicBlockRef));
+    uint32_t i;
+    for (i = 0; i < count; ++i)
+        caseblks[i] = LLVMInsertBasicBlockInContext(gen->context, endif, cases[i].kind == MatchNone ? "else" : "case");
+    LLVMBasicBlockRef elseblk = endif;
+    if (cases[count - 1].kind == MatchNone)
+        elseblk = caseblks[count - 1];
+    else if (cases->exhaustive) {
+        elseblk = LLVMInsertBasicBlockInContext(gen->context, endif, "nomatch");
+        LLVMPositionBuilderAtEnd(gen->builder, elseblk);
+        LLVMBuildUnreachable(gen->builder);
+        LLVMPositionBuilderAtEnd(gen->builder, switchblk);
+    }
+    LLVMValueRef sw = LLVMBuildSwitch(gen->builder, val, elseblk, count);
+    for (i = 0; i < count && cases[i].kind != MatchNone; ++i) {
+        uint32_t prior;
+        for (prior = 0; prior < i && cases[prior].caseval != cases[i].caseval; ++prior);
+        if (prior == i)
+            LLVMAddCase(sw, LLVMConstInt(valtype, cases[i].caseval, 0), caseblks[i]);
+    }
+
+    // Generate each case's code block, along with jump to endif if block does not end with a return
+    INode **nodesp;
+    uint32_t cnt;
+    i = 0;
+    for (nodesFor(ifnode->condblk, cnt, nodesp)) {
+        LLVMPositionBuilderAtEnd(gen->builder, caseblks[i++]);
+        cnt--; nodesp++;
+        LLVMValueRef blkval = genlBlock(gen, (BlockNode*)*nodesp);
+        uint16_t lastStmttype = nodesLast(((BlockNode*)*nodesp)->stmts)->tag;
+        if (lastStmttype != ReturnTag && lastStmttype != BreakTag && lastStmttype != ContinueTag) {
+            LLVMBuildBr(gen->builder, endif);
+            // Remember value and block if needed for phi merge
+            if (vtype != unknownType) {
+                blkvals[phicnt] = blkval;
+                blks[phicnt++] = LLVMGetInsertBlock(gen->builder);
+            }
+        }
+    }
+
+    // Merge point at end of match. Create merged phi value if needed.
+    LLVMPositionBuilderAtEnd(gen->builder, endif);
+    *result = NULL;
+    if (phicnt) {
+        *result = LLVMBuildPhi(gen->builder, genlType(gen, vtype), "ifval");
+        LLVMAddIncoming(*result, blkvals, blks, phicnt);
+    }
+    return 1;
+}
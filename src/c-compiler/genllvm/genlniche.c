@@ -0,0 +1,537 @@
+/** Layout of tagged unions: where their variants keep the tag
+ * @file
+ *
+ * Every variant of a same-size tagged trait (a union) starts out with a tag field,
+ * and all are padded to the size of the largest. A separate tag often costs
+ * a whole alignment unit: Option[&T] would take 16 bytes to hold an 8 byte reference.
+ * So the tag is instead kept in the first of these that makes the union smaller:
+ * - A niche: values that some field of the largest (dataful) variant never holds.
+ *   A reference is never null, nor misaligned for what it points to, so its lowest
+ *   values are free. So are the tag values a nested union does not use.
+ *   Every other variant stores its tag number at the same offset (after any fields
+ *   before its tag field), and fits its own fields after that.
+ *   A valid value there means the dataful variant.
+ * - The padding after the variants' fields, as a trailing tag.
+ * Each variant keeps its (now zero-size) tag field, so that field indexes do not change.
+ *
+ * Bool values are not used as a niche: LLVM leaves the upper bits of a stored i1
+ * unspecified, so other values of its byte could not be told apart from false or true.
+ * Neither are raw pointers, which may be null.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "../ir/ir.h"
+#include "../shared/memory.h"
+#include "../coneopts.h"
+#include "genllvm.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// A run of values that a field (or some part of it) never holds
+typedef struct {
+    FieldDclNode *fld;          // Variant's field it is in
+    LLVMTypeRef valtype;        // Type of the value (an integer or pointer)
+    unsigned long long offset;  // Byte offset of the value in the variant
+    uint64_t start;             // First unused value
+    uint64_t count;             // Number of unused values from start
+} GenNiche;
+
+// A variant's type, while working out where to keep the tag
+typedef struct {
+    StructNode *strnode;
+    LLVMTypeRef *elems;         // Element types (with room for padding and a trailing tag)
+    uint32_t elemcnt;           // Number of element types
+    unsigned long long end;     // Where the last element ends (unpadded)
+    unsigned long long size;
+    unsigned int align;
+} GenTagVariant;
+
+// Record that a tagged trait's variants keep their tag in its tag field
+void genlTagInit(GenState *gen, StructNode *base, FieldDclNode *tagfld) {
+    GenTagLayout *layout = (GenTagLayout *)memAllocBlk(sizeof(GenTagLayout));
+    layout->kind = TagLeading;
+    layout->tagfld = tagfld;
+    layout->dataful = NULL;
+    layout->valtype = genlType(gen, tagfld->vtype);
+    layout->offset = 0;
+    layout->start = 0;
+    unsigned int bits = LLVMGetIntTypeWidth(layout->valtype);
+    layout->count = bits < 64 ? (uint64_t)1 << bits : UINT64_MAX;
+    layout->lo = 0;
+    layout->hi = base->derived->used > 0 ? base->derived->used - 1 : 0;
+    base->taglayout = layout;
+}
+
+// Remember a niche, if it has more values than best
+static void genlNicheFound(FieldDclNode *fld, unsigned long long offset, LLVMTypeRef valtype,
+    uint64_t start, uint64_t count, GenNiche *best) {
+    if (count <= best->count)
+        return;
+    best->fld = fld;
+    best->offset = offset;
+    best->valtype = valtype;
+    best->start = start;
+    best->count = count;
+}
+
+// The number of values (from null up) that a reference to vtexp never holds:
+// null and any that are misaligned for what it points to
+static uint64_t genlNicheRefValues(GenState *gen, LLVMTypeRef vtexp) {
+    return LLVMTypeIsSized(vtexp) ? LLVMABIAlignmentOfType(gen->datalayout, vtexp) : 1;
+}
+
+// Find the largest niche in a value of some type, at some offset in variant field fld
+static void genlNicheFind(GenState *gen, INode *type, FieldDclNode *fld, unsigned long long offset, GenNiche *best) {
+    type = itypeGetTypeDcl(type);
+    LLVMTypeRef llvmtype = genlType(gen, type);
+    switch (type->tag) {
+    case RefTag:
+        genlNicheFound(fld, offset, llvmtype, 0, genlNicheRefValues(gen, LLVMGetElementType(llvmtype)), best);
+        return;
+
+    case ArrayRefTag: {
+        LLVMTypeRef ptrtype = LLVMStructGetTypeAtIndex(llvmtype, 0);
+        genlNicheFound(fld, offset, ptrtype, 0, genlNicheRefValues(gen, LLVMGetElementType(ptrtype)), best);
+        return;
+    }
+
+    // The vtable pointer
+    case VirtRefTag: {
+        LLVMTypeRef ptrtype = LLVMStructGetTypeAtIndex(llvmtype, 1);
+        genlNicheFound(fld, offset + LLVMOffsetOfElement(gen->datalayout, llvmtype, 1), ptrtype, 0,
+            genlNicheRefValues(gen, LLVMGetElementType(ptrtype)), best);
+        return;
+    }
+
+    case StructTag: {
+        StructNode *strnode = (StructNode *)type;
+
+        // A nested union's unused tag values
+        if (strnode->flags & TraitType) {
+            GenTagLayout *layout = strnode->taglayout;
+            if (layout && strnode->basetrait == NULL && (strnode->flags & SameSize)) {
+                uint64_t used = layout->hi - layout->lo + 1;
+                unsigned long long tagoff = layout->kind == TagLeading ?
+                    LLVMOffsetOfElement(gen->datalayout, llvmtype, layout->tagfld->index) : layout->offset;
+                genlNicheFound(fld, offset + tagoff, layout->valtype, layout->start + used, layout->count - used, best);
+            }
+            return;
+        }
+
+        // Any field of a plain struct
+        if (strnode->basetrait || (strnode->flags & OpaqueType))
+            return;
+        INode **nodesp;
+        uint32_t cnt;
+        for (nodelistFor(&strnode->fields, cnt, nodesp)) {
+            FieldDclNode *strfld = (FieldDclNode *)*nodesp;
+            genlNicheFind(gen, strfld->vtype, fld,
+                offset + LLVMOffsetOfElement(gen->datalayout, llvmtype, strfld->index), best);
+        }
+        return;
+    }
+
+    case TTupleTag: {
+        INode **nodesp;
+        uint32_t cnt;
+        unsigned index = 0;
+        for (nodesFor(((TupleNode *)type)->elems, cnt, nodesp))
+            genlNicheFind(gen, *nodesp, fld, offset + LLVMOffsetOfElement(gen->datalayout, llvmtype, index++), best);
+        return;
+    }
+
+    default:
+        return;
+    }
+}
+
+// Measure a variant laid out with its element types
+static void genlTagMeasure(GenState *gen, GenTagVariant *var) {
+    LLVMTypeRef structype = LLVMStructTypeInContext(gen->context, var->elems, var->elemcnt, 0);
+    var->size = LLVMABISizeOfType(gen->datalayout, structype);
+    var->align = LLVMABIAlignmentOfType(gen->datalayout, structype);
+    var->end = var->elemcnt == 0 ? 0 : LLVMOffsetOfElement(gen->datalayout, structype, var->elemcnt - 1)
+        + LLVMABISizeOfType(gen->datalayout, var->elems[var->elemcnt - 1]);
+}
+
+// Lay out every variant with the tag field's slot holding tagslot,
+// and room for 3 more elements (padding, trailing tag, padding)
+static GenTagVariant *genlTagVariants(GenState *gen, StructNode *base, LLVMTypeRef tagslot) {
+    uint32_t tagidx = base->taglayout->tagfld->index;
+    GenTagVariant *vars = (GenTagVariant *)memAllocBlk(base->derived->used * sizeof(GenTagVariant));
+    GenTagVariant *var = vars;
+    INode **nodesp;
+    uint32_t cnt;
+    for (nodesFor(base->derived, cnt, nodesp)) {
+        var->strnode = (StructNode *)*nodesp;
+        var->elemcnt = var->strnode->fields.used;
+        var->elems = (LLVMTypeRef *)memAllocBlk((var->elemcnt + 3) * sizeof(LLVMTypeRef));
+        INode **fldnodesp;
+        uint32_t fldcnt;
+        LLVMTypeRef *elemp = var->elems;
+        for (nodelistFor(&var->strnode->fields, fldcnt, fldnodesp)) {
+            FieldDclNode *fld = (FieldDclNode *)*fldnodesp;
+            *elemp++ = fld->index == tagidx ? tagslot : genlType(gen, fld->vtype);
+        }
+        genlTagMeasure(gen, var);
+        ++var;
+    }
+    return vars;
+}
+
+// Return the size of a union of these variants: the largest, rounded up to the strictest alignment
+static unsigned long long genlTagUnionSize(GenTagVariant *vars, uint32_t count, unsigned int *align) {
+    unsigned long long size = 0;
+    *align = 1;
+    uint32_t i;
+    for (i = 0; i < count; ++i) {
+        if (vars[i].size > size)
+            size = vars[i].size;
+        if (vars[i].align > *align)
+            *align = vars[i].align;
+    }
+    return (size + *align - 1) / *align * *align;
+}
+
+// Lay out variants with the tag after all their fields. Return the union's size.
+static unsigned long long genlTagTrailing(GenState *gen, StructNode *base, GenTagVariant *vars, GenTagLayout *layout) {
+    uint32_t count = base->derived->used;
+    LLVMTypeRef i8type = LLVMInt8TypeInContext(gen->context);
+    unsigned int tagalign = LLVMABIAlignmentOfType(gen->datalayout, layout->valtype);
+    unsigned long long tagoff = 0;
+    uint32_t i;
+    for (i = 0; i < count; ++i) {
+        if (vars[i].end > tagoff)
+            tagoff = vars[i].end;
+    }
+    tagoff = (tagoff + tagalign - 1) / tagalign * tagalign;
+    for (i = 0; i < count; ++i) {
+        GenTagVariant *var = &vars[i];
+        var->elems[var->elemcnt++] = LLVMArrayType(i8type, (unsigned)(tagoff - var->end));
+        var->elems[var->elemcnt++] = layout->valtype;
+        genlTagMeasure(gen, var);
+    }
+    layout->kind = TagTrailing;
+    layout->offset = tagoff;
+    unsigned int align;
+    return genlTagUnionSize(vars, count, &align);
+}
+
+// Lay out variants with the tag in a niche of the largest variant (with no tag of its own).
+// Return the union's size, or 0 if there is no niche with room for every other variant's tag.
+// Also return the field the niche is in.
+static unsigned long long genlTagNiche(GenState *gen, StructNode *base, GenTagVariant *vars,
+    GenTagLayout *layout, FieldDclNode **nichefld) {
+    uint32_t count = base->derived->used;
+    uint32_t tagidx = layout->tagfld->index;
+    if (count < 2 || tagidx != base->fields.used - 1)
+        return 0;
+
+    // The dataful variant is the largest
+    GenTagVariant *dataful = vars;
+    uint32_t i;
+    for (i = 1; i < count; ++i) {
+        if (vars[i].size > dataful->size)
+            dataful = &vars[i];
+    }
+    uint32_t lo = dataful == vars ? 1 : 0;
+    uint32_t hi = dataful == &vars[count - 1] ? count - 2 : count - 1;
+
+    // Find its field with the most values it never holds
+    GenNiche best;
+    best.count = 0;
+    LLVMTypeRef structype = LLVMStructTypeInContext(gen->context, dataful->elems, dataful->elemcnt, 0);
+    INode **nodesp;
+    uint32_t cnt;
+    for (nodelistFor(&dataful->strnode->fields, cnt, nodesp)) {
+        FieldDclNode *fld = (FieldDclNode *)*nodesp;
+        if (fld->index > tagidx)
+            genlNicheFind(gen, fld->vtype, fld, LLVMOffsetOfElement(gen->datalayout, structype, fld->index), &best);
+    }
+    if (best.count < (uint64_t)hi - lo + 1)
+        return 0;
+
+    // Every other variant stores its tag at the niche's offset, in place of its tag field
+    LLVMTypeRef i8type = LLVMInt8TypeInContext(gen->context);
+    LLVMTypeRef prefix[2];
+    prefix[1] = best.valtype;
+    for (i = 0; i < count; ++i) {
+        GenTagVariant *var = &vars[i];
+        if (var == dataful)
+            continue;
+        prefix[0] = LLVMArrayType(i8type, 0);
+        var->elems[tagidx] = LLVMStructTypeInContext(gen->context, prefix, 2, 0);
+        structype = LLVMStructTypeInContext(gen->context, var->elems, var->elemcnt, 0);
+        unsigned long long tagoff = LLVMOffsetOfElement(gen->datalayout, structype, tagidx);
+        if (tagoff > best.offset)
+            return 0;
+        prefix[0] = LLVMArrayType(i8type, (unsigned)(best.offset - tagoff));
+        var->elems[tagidx] = LLVMStructTypeInContext(gen->context, prefix, 2, 0);
+        structype = LLVMStructTypeInContext(gen->context, var->elems, var->elemcnt, 0);
+        if (LLVMOffsetOfElement(gen->datalayout, structype, tagidx)
+            + LLVMOffsetOfElement(gen->datalayout, var->elems[tagidx], 1) != best.offset)
+            return 0;
+        genlTagMeasure(gen, var);
+    }
+
+    layout->kind = TagNiche;
+    layout->dataful = dataful->strnode;
+    layout->valtype = best.valtype;
+    layout->offset = best.offset;
+    layout->start = best.start;
+    layout->count = best.count;
+    layout->lo = lo;
+    layout->hi = hi;
+    *nichefld = best.fld;
+    unsigned int align;
+    return genlTagUnionSize(vars, count, &align);
+}
+
+// Generate the types of a same-size tagged trait (whose variants' types are opaque so far),
+// keeping the tag in unused values or padding, if that makes them smaller. Return 0 if not.
+int genlTagLayout(GenState *gen, StructNode *base) {
+    uint32_t count = base->derived->used;
+    if (count == 0)
+        return 0;
+    INode **nodesp;
+    uint32_t cnt;
+    for (nodesFor(base->derived, cnt, nodesp)) {
+        if ((*nodesp)->flags & OpaqueType)
+            return 0;
+    }
+
+    // Size of the union with a leading tag, then as small as a niche or trailing tag make it
+    unsigned int align;
+    GenTagLayout *leading = base->taglayout;
+    GenTagVariant *vars = genlTagVariants(gen, base, leading->valtype);
+    unsigned long long leadsize = genlTagUnionSize(vars, count, &align);
+    unsigned long long size = leadsize;
+    GenTagLayout *layout = NULL;
+    GenTagVariant *layoutvars = NULL;
+    FieldDclNode *nichefld = NULL;
+    if (!gen->opt->no_niche) {
+        LLVMTypeRef notag = LLVMArrayType(LLVMInt8TypeInContext(gen->context), 0);
+        GenTagLayout *niche = (GenTagLayout *)memAllocBlk(sizeof(GenTagLayout));
+        *niche = *leading;
+        vars = genlTagVariants(gen, base, notag);
+        unsigned long long nichesize = genlTagNiche(gen, base, vars, niche, &nichefld);
+        if (nichesize > 0 && nichesize < size) {
+            size = nichesize;
+            layout = niche;
+            layoutvars = vars;
+        }
+        GenTagLayout *trailing = (GenTagLayout *)memAllocBlk(sizeof(GenTagLayout));
+        *trailing = *leading;
+        vars = genlTagVariants(gen, base, notag);
+        unsigned long long trailsize = genlTagTrailing(gen, base, vars, trailing);
+        if (trailsize < size) {
+            size = trailsize;
+            layout = trailing;
+            layoutvars = vars;
+        }
+    }
+    if (gen->opt->print_layout) {
+        printf("%s: %llu bytes (%llu with a leading tag), tag ", &base->namesym->namestr, size, leadsize);
+        if (layout == NULL)
+            printf("in its own field\n");
+        else if (layout->kind == TagTrailing)
+            printf("after the fields, at byte %llu\n", layout->offset);
+        else
+            printf("in unused values of %s.%s\n", &layout->dataful->namesym->namestr, &nichefld->namesym->namestr);
+    }
+    if (layout == NULL)
+        return 0;
+
+    // Pad every variant to the union's size
+    LLVMTypeRef i8type = LLVMInt8TypeInContext(gen->context);
+    GenTagVariant *var;
+    GenTagVariant *alignvar = NULL;
+    for (var = layoutvars; var < layoutvars + count; ++var) {
+        var->elems[var->elemcnt++] = LLVMArrayType(i8type, (unsigned)(size - var->end));
+        LLVMStructSetBody(var->strnode->llvmtype, var->elems, var->elemcnt, 0);
+        if (alignvar == NULL || var->align > alignvar->align
+            || (var->align == alignvar->align && var->end > alignvar->end))
+            alignvar = var;
+    }
+    base->taglayout = layout;
+    genlSameSizeBase(gen, base, alignvar->strnode->llvmtype);
+    return 1;
+}
+
+// Mark the bytes that a value of some type holds (not its padding), at some offset
+static void genlSameSizeCover(GenState *gen, LLVMTypeRef type, unsigned long long offset, char *covered) {
+    switch (LLVMGetTypeKind(type)) {
+    case LLVMStructTypeKind: {
+        unsigned i;
+        for (i = 0; i < LLVMCountStructElementTypes(type); ++i)
+            genlSameSizeCover(gen, LLVMStructGetTypeAtIndex(type, i),
+                offset + LLVMOffsetOfElement(gen->datalayout, type, i), covered);
+        return;
+    }
+    case LLVMArrayTypeKind: {
+        LLVMTypeRef elemtype = LLVMGetElementType(type);
+        unsigned long long elemsize = LLVMABISizeOfType(gen->datalayout, elemtype);
+        unsigned i;
+        for (i = 0; i < LLVMGetArrayLength(type); ++i)
+            genlSameSizeCover(gen, elemtype, offset + i * elemsize, covered);
+        return;
+    }
+    default:
+        memset(covered + offset, 1, LLVMStoreSizeOfType(gen->datalayout, type));
+        return;
+    }
+}
+
+// Are the bytes every variant's fields hold also held by layouttype's fields?
+// (LLVM does not keep what is in a value's padding.)
+static int genlSameSizeCovers(GenState *gen, StructNode *base, LLVMTypeRef layouttype) {
+    unsigned long long size = LLVMABISizeOfType(gen->datalayout, layouttype);
+    if (size > 0x10000)
+        return 0;
+    char *covered = memAllocBlk(size);
+    char *needed = memAllocBlk(size);
+    memset(covered, 0, size);
+    genlSameSizeCover(gen, layouttype, 0, covered);
+    INode **nodesp;
+    uint32_t cnt;
+    for (nodesFor(base->derived, cnt, nodesp)) {
+        StructNode *strnode = (StructNode *)*nodesp;
+        LLVMTypeRef structype = strnode->llvmtype;
+        if (structype == layouttype)
+            continue;
+        memset(needed, 0, size);
+        uint32_t i;
+        for (i = 0; i < strnode->fields.used; ++i)
+            genlSameSizeCover(gen, LLVMStructGetTypeAtIndex(structype, i),
+                LLVMOffsetOfElement(gen->datalayout, structype, i), needed);
+        unsigned long long byte;
+        for (byte = 0; byte < size; ++byte) {
+            if (needed[byte] && !covered[byte])
+                return 0;
+        }
+    }
+    return 1;
+}
+
+// Generate the type of a same-size trait, whose variants' types are all laid out
+// (layouttype being the most strictly aligned). It is layouttype, if that holds every variant's
+// fields. Otherwise it is the trait's own fields, then integers filling out the rest.
+void genlSameSizeBase(GenState *gen, StructNode *base, LLVMTypeRef layouttype) {
+    unsigned int elemcnt = LLVMCountStructElementTypes(layouttype);
+    LLVMTypeRef *elems = (LLVMTypeRef *)memAllocBlk((elemcnt + 8) * sizeof(LLVMTypeRef));
+    LLVMGetStructElementTypes(layouttype, elems);
+    if (genlSameSizeCovers(gen, base, layouttype)) {
+        LLVMStructSetBody(base->llvmtype, elems, elemcnt, 0);
+        return;
+    }
+
+    // Fill out from where the trait's fields end, with the largest aligned integers that fit
+    unsigned long long size = LLVMABISizeOfType(gen->datalayout, layouttype);
+    unsigned int align = LLVMABIAlignmentOfType(gen->datalayout, layouttype);
+    elemcnt = base->fields.used;
+    unsigned long long offset = 0;
+    if (elemcnt > 0) {
+        LLVMTypeRef fieldstype = LLVMStructTypeInContext(gen->context, elems, elemcnt, 0);
+        offset = LLVMOffsetOfElement(gen->datalayout, fieldstype, elemcnt - 1)
+            + LLVMABISizeOfType(gen->datalayout, elems[elemcnt - 1]);
+    }
+    unsigned int intsize;
+    for (intsize = 1; intsize < align && offset < size; intsize <<= 1) {
+        if (offset & intsize) {
+            elems[elemcnt++] = LLVMIntTypeInContext(gen->context, intsize * 8);
+            offset += intsize;
+        }
+    }
+    if (size - offset >= align) {
+        elems[elemcnt++] = LLVMArrayType(LLVMIntTypeInContext(gen->context, align * 8), (unsigned)((size - offset) / align));
+        offset += (size - offset) / align * align;
+    }
+    for (intsize = align >> 1; intsize > 0; intsize >>= 1) {
+        if (size - offset >= intsize) {
+            elems[elemcnt++] = LLVMIntTypeInContext(gen->context, intsize * 8);
+            offset += intsize;
+        }
+    }
+    LLVMTypeRef filled = LLVMStructTypeInContext(gen->context, elems, elemcnt, 0);
+    if (LLVMABIAlignmentOfType(gen->datalayout, filled) < align)
+        elems[elemcnt++] = LLVMArrayType(layouttype, 0);
+    LLVMStructSetBody(base->llvmtype, elems, elemcnt, 0);
+}
+
+// Generate the value that stores some tag number
+static LLVMValueRef genlTagConst(GenState *gen, GenTagLayout *layout, uint32_t tagnbr) {
+    uint64_t val = layout->start + tagnbr - layout->lo;
+    if (LLVMGetTypeKind(layout->valtype) == LLVMPointerTypeKind)
+        return LLVMConstIntToPtr(LLVMConstInt(genlUsize(gen), val, 0), layout->valtype);
+    return LLVMConstInt(layout->valtype, val, 0);
+}
+
+// Generate the tag number of a tagged trait's value (or what a reference to it points to)
+LLVMValueRef genlTagValue(GenState *gen, StructNode *strnode, LLVMValueRef val, int isref) {
+    StructNode *base = structGetBaseTrait(strnode);
+    if (base->taglayout == NULL || base->llvmtype == NULL)
+        genlType(gen, (INode *)base);
+    GenTagLayout *layout = base->taglayout;
+
+    // A tag field is in every variant at the same index
+    if (layout->kind == TagLeading) {
+        uint32_t tagidx = layout->tagfld->index;
+        if (!isref)
+            return LLVMBuildExtractValue(gen->builder, val, tagidx, "tag");
+        val = LLVMBuildStructGEP(gen->builder, val, tagidx, "tagref");
+        return LLVMBuildLoad(gen->builder, val, "tag");
+    }
+
+    // Otherwise, load the value at the tag's offset
+    if (!isref) {
+        LLVMValueRef tempspaceptr = genlAlloca(gen, LLVMTypeOf(val), "");
+        LLVMBuildStore(gen->builder, val, tempspaceptr);
+        val = tempspaceptr;
+    }
+    LLVMTypeRef i8ptrtype = LLVMPointerType(LLVMInt8TypeInContext(gen->context), 0);
+    val = LLVMBuildBitCast(gen->builder, val, i8ptrtype, "");
+    LLVMValueRef offset = LLVMConstInt(LLVMInt32TypeInContext(gen->context), layout->offset, 0);
+    val = LLVMBuildInBoundsGEP(gen->builder, val, &offset, 1, "");
+    val = LLVMBuildBitCast(gen->builder, val, LLVMPointerType(layout->valtype, 0), "tagref");
+    val = LLVMBuildLoad(gen->builder, val, "tag");
+
+    // Work out the tag number it stores
+    LLVMTypeRef tagtype = genlType(gen, layout->tagfld->vtype);
+    if (LLVMGetTypeKind(layout->valtype) == LLVMPointerTypeKind)
+        val = LLVMBuildPtrToInt(gen->builder, val, genlUsize(gen), "");
+    LLVMTypeRef valtype = LLVMTypeOf(val);
+    if (layout->dataful == NULL)
+        return valtype == tagtype ? val : LLVMBuildIntCast2(gen->builder, val, tagtype, 0, "tag");
+    LLVMValueRef rel = LLVMBuildSub(gen->builder, val, LLVMConstInt(valtype, layout->start, 0), "niche");
+    LLVMValueRef isniche = LLVMBuildICmp(gen->builder, LLVMIntULE, rel,
+        LLVMConstInt(valtype, layout->hi - layout->lo, 0), "isniche");
+    if (valtype != tagtype)
+        rel = LLVMBuildIntCast2(gen->builder, rel, tagtype, 0, "");
+    if (layout->lo > 0)
+        rel = LLVMBuildAdd(gen->builder, rel, LLVMConstInt(tagtype, layout->lo, 0), "");
+    return LLVMBuildSelect(gen->builder, isniche, rel,
+        LLVMConstInt(tagtype, layout->dataful->tagnbr, 0), "tag");
+}
+
+// Store a variant's tag into a value of its type
+LLVMValueRef genlTagInsert(GenState *gen, StructNode *strnode, LLVMValueRef strval) {
+    GenTagLayout *layout = structGetBaseTrait(strnode)->taglayout;
+    if (strnode == layout->dataful)
+        return strval;
+    LLVMValueRef tag = genlTagConst(gen, layout, strnode->tagnbr);
+    uint32_t tagidx = layout->tagfld->index;
+    switch (layout->kind) {
+    case TagTrailing:
+        return LLVMBuildInsertValue(gen->builder, strval, tag, strnode->fields.used + 1, "literal");
+    case TagNiche: {
+        LLVMTypeRef prefixtype = LLVMStructGetTypeAtIndex(LLVMTypeOf(strval), tagidx);
+        LLVMValueRef prefix = LLVMBuildInsertValue(gen->builder, LLVMGetUndef(prefixtype), tag, 1, "");
+        return LLVMBuildInsertValue(gen->builder, strval, prefix, tagidx, "literal");
+    }
+    default:
+        return LLVMBuildInsertValue(gen->builder, strval, tag, tagidx, "literal");
+    }
+}
@@ -0,0 +1,101 @@
+/** Running LLVM's optimization passes
+ * @file
+ *
+ * LLVM's C API runs a pass pipeline (LLVMRunPasses) but offers no hook
+ * into the pass builder's instrumentation. This runs the same pipeline
+ * the same way, and with --time-trace, traces every pass that runs
+ * (on the module, a call graph SCC, a function or a loop),
+ * nested within the pass manager or adaptor that runs it.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include <llvm/Analysis/LazyCallGraph.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/PassInstrumentation.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Passes/StandardInstrumentations.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm-c/Error.h>
+#include <llvm-c/TargetMachine.h>
+
+#include <string>
+#include <unordered_map>
+
+extern "C" {
+#include "../shared/memory.h"
+#include "../shared/timetrace.h"
+}
+
+using namespace llvm;
+
+// Trace events keep the names they are given, so copy each distinct name once (per thread)
+static char *genlPassName(StringRef name) {
+    static thread_local std::unordered_map<std::string, char*> names;
+    char *&str = names[name.str()];
+    if (str == NULL)
+        str = memAllocStr((char*)name.data(), name.size());
+    return str;
+}
+
+// Name the function (or module) a pass runs on
+static char *genlPassUnitName(Any unit) {
+    if (any_isa<const Module *>(unit))
+        return genlPassName(any_cast<const Module *>(unit)->getName());
+    if (any_isa<const Function *>(unit))
+        return genlPassName(any_cast<const Function *>(unit)->getName());
+    if (any_isa<const Loop *>(unit))
+        return genlPassName(any_cast<const Loop *>(unit)->getHeader()->getParent()->getName());
+    if (any_isa<const LazyCallGraph::SCC *>(unit)) {
+        const LazyCallGraph::SCC *scc = any_cast<const LazyCallGraph::SCC *>(unit);
+        return scc->size() ? genlPassName(scc->begin()->getFunction().getName()) : NULL;
+    }
+    return NULL;
+}
+
+// Run an LLVM pass pipeline over mod, tuned as asked, tracing each pass with --time-trace
+extern "C" LLVMErrorRef genlRunPasses(LLVMModuleRef mod, char *pipeline, LLVMTargetMachineRef machine,
+                                      int vectorize, int unroll) {
+    PipelineTuningOptions tuning;
+    tuning.LoopVectorization = vectorize != 0;
+    tuning.SLPVectorization = vectorize != 0;
+    tuning.LoopInterleaving = vectorize != 0;
+    tuning.LoopUnrolling = unroll != 0;
+
+    PassInstrumentationCallbacks callbacks;
+    if (timeTraceOn) {
+        callbacks.registerBeforeNonSkippedPassCallback([](StringRef pass, Any unit) {
+            timeTraceBegin(genlPassName(pass), genlPassUnitName(unit));
+        });
+        callbacks.registerAfterPassCallback([](StringRef pass, Any unit, const PreservedAnalyses &) {
+            timeTraceEnd();
+        });
+        callbacks.registerAfterPassInvalidatedCallback([](StringRef pass, const PreservedAnalyses &) {
+            timeTraceEnd();
+        });
+    }
+    PassBuilder builder(reinterpret_cast<TargetMachine *>(machine), tuning, None, &callbacks);
+
+    LoopAnalysisManager loopam;
+    FunctionAnalysisManager fnam;
+    CGSCCAnalysisManager cgsccam;
+    ModuleAnalysisManager modam;
+    builder.registerLoopAnalyses(loopam);
+    builder.registerFunctionAnalyses(fnam);
+    builder.registerCGSCCAnalyses(cgsccam);
+    builder.registerModuleAnalyses(modam);
+    builder.crossRegisterProxies(loopam, fnam, cgsccam, modam);
+
+    // As LLVMRunPasses does, e.g., so that optnone functions are left alone
+    StandardInstrumentations standard(false);
+    standard.registerCallbacks(callbacks, &fnam);
+
+    ModulePassManager passes;
+    if (Error err = builder.parsePassPipeline(passes, pipeline))
+        return wrap(std::move(err));
+    passes.run(*unwrap(mod), modam);
+    return LLVMErrorSuccess;
+}
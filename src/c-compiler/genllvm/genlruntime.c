@@ -0,0 +1,116 @@
+/** Linking in the runtime's LLVM bitcode
+ * @file
+ *
+ * With --runtimebc, the C runtime (conestd), compiled to LLVM bitcode as conestd.bc,
+ * is linked into the generated code before it is optimized. The runtime's
+ * definitions become internal to the module, so LLVM can inline them into the
+ * Cone code that calls them, and drop the ones nothing uses.
+ *
+ * With --split, the runtime is linked into the main module's partition only,
+ * and stays external there for the other partitions to call. Giving each partition
+ * its own copy would also give each its own allocator caches and region state,
+ * so that memory allocated in one module's code could be freed to another's.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "../conec.h"
+#include "../shared/error.h"
+#include "../shared/fileio.h"
+#include "../shared/memory.h"
+#include "../coneopts.h"
+#include "genllvm.h"
+
+#include <llvm-c/BitReader.h>
+#include <llvm-c/Linker.h>
+
+#include <stdio.h>
+#include <string.h>
+
+static LLVMMemoryBufferRef genlRuntimeBitcode = NULL;
+
+// Find conestd.bc: in the package search paths, then alongside the compiler
+static char *genlRuntimeFind(ConeOptions *opt) {
+    char **searchPaths = opt->package_search_paths;
+    while (searchPaths && *searchPaths) {
+        char *path = fileMakePath(*searchPaths++, "conestd", "bc");
+        FILE *file = fopen(path, "rb");
+        if (file) {
+            fclose(file);
+            return path;
+        }
+    }
+    char *exe = opt->exe_path ? opt->exe_path : "";
+    return fileMakePath(memAllocStr(exe, fileFolder(exe)), "conestd", "bc");
+}
+
+// Load the runtime's bitcode, once, before any modules link it in. Return 0 if not found.
+int genlRuntimeLoad(ConeOptions *opt) {
+    char *path = genlRuntimeFind(opt);
+    char *err;
+    if (LLVMCreateMemoryBufferWithContentsOfFile(path, &genlRuntimeBitcode, &err) != 0) {
+        errorMsg(ErrorGenErr, "Could not load runtime bitcode %s: %s", path, err);
+        LLVMDisposeMessage(err);
+        genlRuntimeBitcode = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+// Link the runtime's bitcode into mod, making its definitions internal to mod if asked.
+// This is safe to do for several modules at once, each in its own context.
+void genlRuntimeLink(LLVMModuleRef mod, int internal) {
+    if (!genlRuntimeBitcode)
+        return;
+
+    LLVMContextRef context = LLVMGetModuleContext(mod);
+    LLVMMemoryBufferRef buffer = LLVMCreateMemoryBufferWithMemoryRange(LLVMGetBufferStart(genlRuntimeBitcode),
+        LLVMGetBufferSize(genlRuntimeBitcode), "conestd", 0);
+    LLVMModuleRef rtmod;
+    int failed = LLVMParseBitcodeInContext2(context, buffer, &rtmod);
+    LLVMDisposeMemoryBuffer(buffer);
+    if (failed) {
+        errorMsg(ErrorGenErr, "Could not read runtime bitcode");
+        return;
+    }
+    LLVMSetTarget(rtmod, LLVMGetTarget(mod));
+    LLVMSetDataLayout(rtmod, LLVMGetDataLayoutStr(mod));
+
+    // Remember what the runtime defines, as linking consumes the runtime's module
+    size_t namecnt = 0;
+    size_t len;
+    LLVMValueRef val;
+    for (val = LLVMGetFirstFunction(rtmod); val; val = LLVMGetNextFunction(val))
+        ++namecnt;
+    for (val = LLVMGetFirstGlobal(rtmod); val; val = LLVMGetNextGlobal(val))
+        ++namecnt;
+    char **names = (char**)memAllocBlk((namecnt + 1) * sizeof(char*));
+    namecnt = 0;
+    for (val = LLVMGetFirstFunction(rtmod); val; val = LLVMGetNextFunction(val)) {
+        if (!LLVMIsDeclaration(val) && LLVMGetLinkage(val) == LLVMExternalLinkage) {
+            const char *name = LLVMGetValueName2(val, &len);
+            names[namecnt++] = memAllocStr((char*)name, len);
+        }
+    }
+    for (val = LLVMGetFirstGlobal(rtmod); val; val = LLVMGetNextGlobal(val)) {
+        if (!LLVMIsDeclaration(val) && LLVMGetLinkage(val) == LLVMExternalLinkage) {
+            const char *name = LLVMGetValueName2(val, &len);
+            names[namecnt++] = memAllocStr((char*)name, len);
+        }
+    }
+
+    if (LLVMLinkModules2(mod, rtmod)) {
+        errorMsg(ErrorGenErr, "Could not link in runtime bitcode");
+        return;
+    }
+
+    // Now the runtime's definitions may only need to serve this module
+    if (!internal)
+        return;
+    size_t i;
+    for (i = 0; i < namecnt; ++i) {
+        if ((val = LLVMGetNamedFunction(mod, names[i])) || (val = LLVMGetNamedGlobal(mod, names[i])))
+            LLVMSetLinkage(val, LLVMInternalLinkage);
+    }
+}
@@ -0,0 +1,341 @@
+/** Split code generation
+ * @file
+ *
+ * Optimization and target code emission take most of a release build's time.
+ * With --split, the program's LLVM IR is divided into one partition per module,
+ * each with its own LLVM context, so that several threads can optimize and emit
+ * them at once. Every partition receives a copy of the whole program's IR,
+ * after which the functions and variables defined by other modules are turned
+ * into external declarations. Each partition is emitted as its own object file:
+ * the main module's is named after the program, other modules' files add the module name.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "../ir/ir.h"
+#include "../shared/error.h"
+#include "../shared/memory.h"
+#include "../shared/timer.h"
+#include "../shared/fileio.h"
+#include "../shared/thread.h"
+#include "../shared/cache.h"
+#include "../shared/timetrace.h"
+#include "../coneopts.h"
+#include "genllvm.h"
+
+#include <llvm-c/BitReader.h>
+#include <llvm-c/BitWriter.h>
+#include <llvm-c/Transforms/IPO.h>
+
+#include <string.h>
+
+// Shared state for all threads generating partitions
+typedef struct {
+    ConeOptions *opt;
+    LLVMMemoryBufferRef bitcode;    // The whole program's LLVM IR
+    int *fnowner;                   // Owning module's index for each function, or -1
+    uint32_t fncnt;
+    int *globalowner;               // Owning module's index for each global variable, or -1
+    uint32_t globalcnt;
+    uint32_t *parts;                // Index of each module that becomes a partition
+    char **partnames;               // Output file name for each partition
+    uint32_t partcnt;
+    uint32_t nextpart;              // Next partition to be generated
+    Mutex mutex;
+} GenSplit;
+
+// A thread generating partitions, with its own target machine
+typedef struct {
+    GenSplit *split;
+    LLVMTargetMachineRef machine;
+} GenSplitWorker;
+
+// Assign each function or global to the module whose symbols declared it,
+// using the last value each module declared (NULL when none were declared yet)
+static int *genlSplitOwners(LLVMValueRef first, LLVMValueRef (*nextfn)(LLVMValueRef), LLVMValueRef *modlast, uint32_t modcnt, uint32_t *cnt) {
+    LLVMValueRef val;
+    uint32_t n = 0;
+    for (val = first; val; val = nextfn(val))
+        ++n;
+    uint32_t slots = n? n : 1;
+    int *owner = (int*)memAllocBlk(slots * sizeof(int));
+    memset(owner, 0xff, slots * sizeof(int));
+
+    uint32_t index = 0;
+    LLVMValueRef prevlast = NULL;
+    val = first;
+    uint32_t mod;
+    for (mod = 0; mod < modcnt; ++mod) {
+        if (modlast[mod] == prevlast)
+            continue;   // This module declared nothing
+        while (val) {
+            int done = val == modlast[mod];
+            owner[index++] = mod;
+            val = nextfn(val);
+            if (done)
+                break;
+        }
+        prevlast = modlast[mod];
+    }
+    *cnt = n;
+    return owner;
+}
+
+// Is this a definition that only one partition should keep?
+// Internal and linkonce definitions can safely be duplicated in every partition.
+static int genlSplitIsOwned(LLVMValueRef val) {
+    return !LLVMIsDeclaration(val) && LLVMGetLinkage(val) == LLVMExternalLinkage;
+}
+
+// Which module's partition keeps the definition (definitions no module declared go to the main module)
+static int genlSplitOwner(int *owner, uint32_t cnt, uint32_t index) {
+    return (index < cnt && owner[index] >= 0)? owner[index] : 0;
+}
+
+// Replace a function defined by another partition with an external declaration
+static void genlSplitDeclareFn(LLVMModuleRef mod, LLVMValueRef fn) {
+    size_t len;
+    const char *name = LLVMGetValueName2(fn, &len);
+    char *fnname = memAllocStr((char*)name, len);
+    LLVMSetValueName2(fn, "", 0);
+
+    LLVMValueRef decl = LLVMAddFunction(mod, fnname, LLVMGlobalGetValueType(fn));
+    LLVMSetFunctionCallConv(decl, LLVMGetFunctionCallConv(fn));
+    LLVMSetVisibility(decl, LLVMGetVisibility(fn));
+    LLVMSetDLLStorageClass(decl, LLVMGetDLLStorageClass(fn));
+
+    // Keep attributes for the function, its return value and its parameters
+    int index;
+    int lastindex = (int)LLVMCountParams(fn);
+    for (index = -1; index <= lastindex; ++index) {
+        LLVMAttributeIndex attrindex = index < 0? (LLVMAttributeIndex)LLVMAttributeFunctionIndex : (LLVMAttributeIndex)index;
+        unsigned attrcnt = LLVMGetAttributeCountAtIndex(fn, attrindex);
+        if (attrcnt == 0)
+            continue;
+        LLVMAttributeRef *attrs = (LLVMAttributeRef*)memAllocBlk(attrcnt * sizeof(LLVMAttributeRef));
+        LLVMGetAttributesAtIndex(fn, attrindex, attrs);
+        unsigned i;
+        for (i = 0; i < attrcnt; ++i)
+            LLVMAddAttributeAtIndex(decl, attrindex, attrs[i]);
+    }
+
+    LLVMReplaceAllUsesWith(fn, decl);
+    LLVMDeleteFunction(fn);
+}
+
+// Replace a global variable defined by another partition with an external declaration
+static void genlSplitDeclareGlobal(LLVMModuleRef mod, LLVMValueRef global) {
+    size_t len;
+    const char *name = LLVMGetValueName2(global, &len);
+    char *globalname = memAllocStr((char*)name, len);
+    LLVMSetValueName2(global, "", 0);
+
+    LLVMValueRef decl = LLVMAddGlobal(mod, LLVMGlobalGetValueType(global), globalname);
+    LLVMSetGlobalConstant(decl, LLVMIsGlobalConstant(global));
+    LLVMSetThreadLocal(decl, LLVMIsThreadLocal(global));
+    LLVMSetVisibility(decl, LLVMGetVisibility(global));
+    LLVMSetDLLStorageClass(decl, LLVMGetDLLStorageClass(global));
+    LLVMSetAlignment(decl, LLVMGetAlignment(global));
+
+    LLVMReplaceAllUsesWith(global, decl);
+    LLVMDeleteGlobal(global);
+}
+
+// Replace the ifunc (of a @multiversion function) that an internal resolver serves,
+// when defined by another partition, with an external declaration.
+// The resolver and clones, which are internal, are then unused.
+static void genlSplitDeclareIFunc(LLVMModuleRef mod, LLVMValueRef resolver) {
+    LLVMUseRef use = LLVMGetFirstUse(resolver);
+    LLVMValueRef ifunc = use? LLVMGetUser(use) : NULL;
+    if (!ifunc || !LLVMIsAGlobalIFunc(ifunc))
+        return;
+
+    size_t len;
+    const char *name = LLVMGetValueName2(ifunc, &len);
+    char *fnname = memAllocStr((char*)name, len);
+    LLVMSetValueName2(ifunc, "", 0);
+
+    LLVMValueRef decl = LLVMAddFunction(mod, fnname, LLVMGlobalGetValueType(ifunc));
+    LLVMSetVisibility(decl, LLVMGetVisibility(ifunc));
+    LLVMReplaceAllUsesWith(ifunc, decl);
+    LLVMEraseGlobalIFunc(ifunc);
+}
+
+// Build, optimize and emit one partition in its own LLVM context
+static void genlSplitPart(GenSplit *split, LLVMTargetMachineRef machine, uint32_t part) {
+    ConeOptions *opt = split->opt;
+    int modindex = (int)split->parts[part];
+
+    LLVMContextRef context = LLVMContextCreate();
+    LLVMMemoryBufferRef buffer = LLVMCreateMemoryBufferWithMemoryRange(LLVMGetBufferStart(split->bitcode),
+        LLVMGetBufferSize(split->bitcode), "split", 0);
+    LLVMModuleRef mod;
+    int failed = LLVMParseBitcodeInContext2(context, buffer, &mod);
+    LLVMDisposeMemoryBuffer(buffer);
+    if (failed) {
+        errorMsg(ErrorGenErr, "Could not split code for %s", split->partnames[part]);
+        LLVMContextDispose(context);
+        return;
+    }
+
+    // Only keep definitions that this partition owns.
+    // Bitcode preserves the order of functions and globals, so owners are found by position.
+    LLVMValueRef val, next;
+    uint32_t index = 0;
+    for (val = LLVMGetFirstFunction(mod); val && index < split->fncnt; val = next, ++index) {
+        next = LLVMGetNextFunction(val);
+        if (genlSplitOwner(split->fnowner, split->fncnt, index) == modindex || LLVMIsDeclaration(val))
+            continue;
+        if (genlSplitIsOwned(val))
+            genlSplitDeclareFn(mod, val);
+        else if (LLVMGetLinkage(val) == LLVMInternalLinkage)
+            genlSplitDeclareIFunc(mod, val);
+    }
+    index = 0;
+    for (val = LLVMGetFirstGlobal(mod); val && index < split->globalcnt; val = next, ++index) {
+        next = LLVMGetNextGlobal(val);
+        if (genlSplitIsOwned(val) && genlSplitOwner(split->globalowner, split->globalcnt, index) != modindex)
+            genlSplitDeclareGlobal(mod, val);
+    }
+
+    // Drop what the partition no longer uses, so that its IR (and cache key)
+    // does not change when code only other partitions use does
+    LLVMPassManagerRef passmgr = LLVMCreatePassManager();
+    LLVMAddGlobalDCEPass(passmgr);
+    LLVMRunPassManager(passmgr, mod);
+    LLVMDisposePassManager(passmgr);
+
+    // Link in the runtime's bitcode (if loaded), so its functions can be inlined.
+    // Only the main module's partition gets it: the runtime's state must be shared.
+    if (opt->runtimebc && modindex == 0) {
+        if (machine)
+            genlSetTarget(mod, opt->triple, machine);
+        genlRuntimeLink(mod, 0);
+    }
+
+    // Reuse the code generated earlier from the same LLVM IR, if cached
+    int caching = cacheEnabled() && machine;
+    uint64_t cachekey;
+    if (caching) {
+        cachekey = genlCacheKey(opt, mod);
+        if (genlCacheFetch(opt, cachekey, split->partnames[part])) {
+            LLVMDisposeModule(mod);
+            LLVMContextDispose(context);
+            return;
+        }
+    }
+
+    genlOptimize(opt, mod, machine);
+
+    // Serialize the LLVM IR, if requested
+    if (opt->print_llvmir)
+        genlPrintModule(mod, fileMakePath(opt->output, split->partnames[part], "ir"));
+
+    if (machine)
+        genlOutFiles(opt, split->partnames[part], mod, machine);
+    if (caching && errors == 0)
+        genlCacheKeep(opt, cachekey, split->partnames[part]);
+
+    LLVMDisposeModule(mod);
+    LLVMContextDispose(context);
+}
+
+// Generate partitions until none are left
+static void genlSplitWork(GenSplitWorker *worker) {
+    GenSplit *split = worker->split;
+    while (1) {
+        mutexLock(&split->mutex);
+        uint32_t part = split->nextpart++;
+        mutexUnlock(&split->mutex);
+        if (part >= split->partcnt)
+            break;
+        timeTraceBegin("Split module", split->partnames[part]);
+        genlSplitPart(split, worker->machine, part);
+        timeTraceEnd();
+    }
+}
+
+// Entry point for a worker thread
+static void genlSplitWorkerThread(void *arg) {
+    timerWorkerThread();
+    genlSplitWork((GenSplitWorker*)arg);
+    memThreadEnd();
+}
+
+// Optimize and emit each module's code as a separate object file, using several threads
+void genlSplit(GenState *gen, ProgramNode *pgm) {
+    ConeOptions *opt = gen->opt;
+    uint32_t modcnt = pgm->modules->used;
+
+    timerBegin(CodeGenTimer);
+    GenSplit split;
+    split.opt = opt;
+    split.bitcode = LLVMWriteBitcodeToMemoryBuffer(gen->module);
+    split.fnowner = genlSplitOwners(LLVMGetFirstFunction(gen->module), LLVMGetNextFunction,
+        gen->modlastfn, modcnt, &split.fncnt);
+    split.globalowner = genlSplitOwners(LLVMGetFirstGlobal(gen->module), LLVMGetNextGlobal,
+        gen->modlastglobal, modcnt, &split.globalcnt);
+
+    // Only modules that own some definition get a partition (the main module always does)
+    char *hasdefs = (char*)memAllocBlk(modcnt);
+    memset(hasdefs, 0, modcnt);
+    hasdefs[0] = 1;
+    LLVMValueRef val;
+    uint32_t index = 0;
+    for (val = LLVMGetFirstFunction(gen->module); val; val = LLVMGetNextFunction(val), ++index) {
+        if (genlSplitIsOwned(val))
+            hasdefs[genlSplitOwner(split.fnowner, split.fncnt, index)] = 1;
+    }
+    index = 0;
+    for (val = LLVMGetFirstGlobal(gen->module); val; val = LLVMGetNextGlobal(val), ++index) {
+        if (genlSplitIsOwned(val))
+            hasdefs[genlSplitOwner(split.globalowner, split.globalcnt, index)] = 1;
+    }
+    split.parts = (uint32_t*)memAllocBlk(modcnt * sizeof(uint32_t));
+    split.partnames = (char**)memAllocBlk(modcnt * sizeof(char*));
+    split.partcnt = 0;
+    for (index = 0; index < modcnt; ++index) {
+        if (!hasdefs[index])
+            continue;
+        char *partname = opt->srcname;
+        ModuleNode *mod = (ModuleNode*)nodesGet(pgm->modules, index);
+        if (index > 0 && mod->namesym) {
+            partname = memAllocStr(opt->srcname, strlen(opt->srcname) + strlen(&mod->namesym->namestr) + 1);
+            strcat(partname, ".");
+            strcat(partname, &mod->namesym->namestr);
+        }
+        split.parts[split.partcnt] = index;
+        split.partnames[split.partcnt++] = partname;
+    }
+    split.nextpart = 0;
+    mutexInit(&split.mutex);
+
+    // Each thread gets its own target machine, as they are not safe to share
+    int nthreads = opt->jobs > 0? opt->jobs : threadCpuCount();
+    if ((uint32_t)nthreads > split.partcnt)
+        nthreads = split.partcnt;
+    GenSplitWorker *workers = (GenSplitWorker*)memAllocBlk(nthreads * sizeof(GenSplitWorker));
+    Thread *threads = (Thread*)memAllocBlk(nthreads * sizeof(Thread));
+    int i;
+    for (i = 0; i < nthreads; ++i) {
+        workers[i].split = &split;
+        workers[i].machine = gen->machine? (i == 0? gen->machine : genlCreateMachine(opt)) : NULL;
+    }
+
+    // This thread generates partitions alongside the workers
+    threadShareBegin();
+    int started = 1;
+    while (started < nthreads && threadStart(&threads[started], genlSplitWorkerThread, &workers[started]))
+        ++started;
+    genlSplitWork(&workers[0]);
+    for (i = started - 1; i > 0; --i)
+        threadJoin(threads[i]);
+    threadShareEnd();
+
+    for (i = 1; i < nthreads; ++i) {
+        if (workers[i].machine)
+            LLVMDisposeTargetMachine(workers[i].machine);
+    }
+    LLVMDisposeMemoryBuffer(split.bitcode);
+}
@@ -23,8 +23,8 @@
 #include <string.h>
 #include <assert.h>
 
-// Generate a specific vtable value for some struct
-void genlVtableImpl(GenState *gen, VtableImpl *impl, LLVMTypeRef vtableRef) {
+// Generate a specific vtable value for some struct, the index'th implementation of its vtable
+void genlVtableImpl(GenState *gen, VtableImpl *impl, uint32_t index, LLVMTypeRef vtableRef) {
     // Ensure the struct has been "built", as we need to point to its fields and methods
     LLVMTypeRef structRef = genlType(gen, impl->structdcl);
 
@@ -48,17 +48,20 @@ void genlVtableImpl(GenState *gen, VtableImpl *impl, LLVMTypeRef vtableRef) {
         }
         implRef = LLVMBuildInsertValue(gen->builder, implRef, val, pos++, "vtable entry");
     }
+    LLVMValueRef indexval = LLVMConstInt(LLVMInt32TypeInContext(gen->context), index, 0);
+    implRef = LLVMBuildInsertValue(gen->builder, implRef, indexval, pos, "vtable index");
 
-    // Create and initialize global variable to hold vtable info
+    // Create and initialize global variable to hold vtable info.
+    // Every copy is the same (ODR), so LLVM may fold loads from a known vtable.
     impl->llvmvtablep = LLVMAddGlobal(gen->module, vtableRef, impl->name);
     LLVMSetGlobalConstant(impl->llvmvtablep, 1);
-    LLVMSetLinkage(impl->llvmvtablep, LLVMLinkOnceAnyLinkage);
+    LLVMSetLinkage(impl->llvmvtablep, LLVMLinkOnceODRLinkage);
     LLVMSetInitializer(impl->llvmvtablep, implRef);
 }
 
 // Generate a vtable type
 void genlVtable(GenState *gen, Vtable *vtable) {
-    uint32_t fieldcnt = vtable->methfld->used;
+    uint32_t fieldcnt = vtable->methfld->used + 1;
     LLVMTypeRef *field_types = (LLVMTypeRef *)memAllocBlk(fieldcnt * sizeof(LLVMTypeRef));
     LLVMTypeRef *field_type_ptr = field_types;
 
@@ -89,24 +92,25 @@ void genlVtable(GenState *gen, Vtable *vtable) {
             // All virtual fields are 32-bit offsets into the object
             *field_type_ptr++ = LLVMInt32TypeInContext(gen->context);
     }
+    // Last is the implementation's index in vtable->impl, which match switches on
+    *field_type_ptr++ = LLVMInt32TypeInContext(gen->context);
 
     // Declare the vtable type itself
     LLVMTypeRef vtableRef = LLVMStructCreateNamed(gen->context, vtable->name);
-    if (fieldcnt > 0)
-        LLVMStructSetBody(vtableRef, field_types, fieldcnt, 0);
+    LLVMStructSetBody(vtableRef, field_types, fieldcnt, 0);
 
     // Build all the vtable globals that implement the vtable
     // as well as an array pointing to all these vtables
     LLVMValueRef *vtables = (LLVMValueRef *)memAllocBlk(vtable->impl->used * sizeof(LLVMValueRef *));
     LLVMValueRef *vtablesp = vtables;
     for (nodesFor(vtable->impl, cnt, nodesp)) {
-        genlVtableImpl(gen, (VtableImpl*)*nodesp, vtableRef);
+        genlVtableImpl(gen, (VtableImpl*)*nodesp, vtablesp - vtables, vtableRef);
         *vtablesp++ = ((VtableImpl*)*nodesp)->llvmvtablep;
     }
     LLVMValueRef vtablelist = LLVMConstArray(LLVMPointerType(vtableRef, 0), vtables, vtable->impl->used);
     vtable->llvmvtables = LLVMAddGlobal(gen->module, LLVMTypeOf(vtablelist), "vtable-list");
     LLVMSetGlobalConstant(vtable->llvmvtables, 1);
-    LLVMSetLinkage(vtable->llvmvtables, LLVMLinkOnceAnyLinkage);
+    LLVMSetLinkage(vtable->llvmvtables, LLVMLinkOnceODRLinkage);
     LLVMSetInitializer(vtable->llvmvtables, vtablelist);
 
     // Build the virtual reference type for this vtable. It is a fat pointer:
@@ -152,57 +156,20 @@ LLVMTypeRef genlStructFields(GenState *gen, LLVMTypeRef structype, StructNode *s
 
 // For tagged base traits (only do once, if needed):
 // - Auto-determine size of tag field
-// - Optimize optional references/pointers to use 0 for lack of pointer
+// - Record where the tag is (genlTagLayout may later find a better place for it)
 void genlSetupTaggedTrait(GenState *gen, StructNode *base) {
-    if (base->derived->used > 0x100) {
-        INode **nodesp;
-        uint32_t cnt;
-        for (nodelistFor(&base->fields, cnt, nodesp)) {
-            if ((*nodesp)->flags & IsTagField) {
-                EnumNode *enumnode = (EnumNode *)itypeGetTypeDcl(*nodesp);
-                if (base->derived->used > 0x1000000)
-                    enumnode->bytes = 4;
-                else if (base->derived->used > 0x10000)
-                    enumnode->bytes = 3;
-                else if (base->derived->used > 0x100)
-                    enumnode->bytes = 2;
-            }
-        }
-    }
-
-    // Set optimization flag if we have a nullable pointer variant types
-    if (base->flags & SameSize && base->derived->used == 2) {
-        // Look for 2 variants, one with one field (enum) and one with two
-        StructNode *nonenode = (StructNode*)nodesGet(base->derived, 0);
-        StructNode *somenode = (StructNode*)nodesGet(base->derived, 1);
-        if (nonenode->fields.used == 2 && somenode->fields.used == 1) {
-            StructNode *tempnode = nonenode;
-            nonenode = somenode;
-            somenode = tempnode;
-        }
-        else if (!(nonenode->fields.used == 1 && somenode->fields.used == 2))
-            nonenode = NULL;
-
-        // If some derived node's second field is a pointer, mark trait and derived's
-        // with optimization flag
-        if (nonenode) {
-            FieldDclNode *fld = (FieldDclNode*)nodelistGet(&somenode->fields, 1);
-            INode *fldtype = itypeGetTypeDcl(fld->vtype);
-            if (fldtype->tag == PtrTag || fldtype->tag == RefTag
-                || fldtype->tag == VirtRefTag || fldtype->tag == ArrayRefTag) {
-
-                // Yes, we have a nullable pointer, set flags to say so on trait & derived structs
-                base->flags |= NullablePtr;
-                INode **nodesp;
-                uint32_t cnt;
-                unsigned long long maxsize = 0;
-                base->llvmtype = genlType(gen, fldtype);
-                for (nodesFor(base->derived, cnt, nodesp)) {
-                    (*nodesp)->flags |= NullablePtr;
-                    ((StructNode*)*nodesp)->llvmtype = base->llvmtype;
-                }
-                return;
-            }
+    INode **nodesp;
+    uint32_t cnt;
+    for (nodelistFor(&base->fields, cnt, nodesp)) {
+        if ((*nodesp)->flags & IsTagField) {
+            EnumNode *enumnode = (EnumNode *)itypeGetTypeDcl(((FieldDclNode *)*nodesp)->vtype);
+            if (base->derived->used > 0x1000000)
+                enumnode->bytes = 4;
+            else if (base->derived->used > 0x10000)
+                enumnode->bytes = 3;
+            else if (base->derived->used > 0x100)
+                enumnode->bytes = 2;
+            genlTagInit(gen, base, (FieldDclNode*)*nodesp);
         }
     }
 }
@@ -220,10 +187,15 @@ void genlSameSizeTrait(GenState *gen, StructNode *base) {
         strnode->llvmtype = LLVMStructCreateNamed(gen->context, &strnode->namesym->namestr);
     }
 
+    // A tagged trait's variants may fit their tag somewhere better than a field of its own
+    if ((base->flags & HasTagField) && genlTagLayout(gen, base))
+        return;
+
     // Use throwaway types to determine the sizes of all concrete variants
-    // Remember the largest size
-    StructNode *maxStruct = NULL;
+    // Remember the largest size, and the most strictly aligned variant (the largest of those)
+    StructNode *alignStruct = NULL;
     unsigned long long maxsize = 0;
+    unsigned int maxalign = 1;
     unsigned long long *sizes = (unsigned long long *)memAllocBlk(base->derived->used * sizeof(unsigned long long));
     unsigned long long *sizesp = sizes;
     for (nodesFor(base->derived, cnt, nodesp)) {
@@ -231,12 +203,16 @@ void genlSameSizeTrait(GenState *gen, StructNode *base) {
         LLVMTypeRef structype = LLVMStructCreateNamed(gen->context, "Throwaway");
         genlStructFields(gen, structype, strnode, 0);
         unsigned long long size = LLVMStoreSizeOfType(gen->datalayout, structype);
+        unsigned int align = LLVMABIAlignmentOfType(gen->datalayout, structype);
         *sizesp++ = size;
-        if (size > maxsize) {
-            maxsize = size;
-            maxStruct = strnode;
+        if (alignStruct == NULL || align > maxalign || (align == maxalign && size > maxsize)) {
+            maxalign = align;
+            alignStruct = strnode;
         }
+        if (size > maxsize)
+            maxsize = size;
     }
+    maxsize = (maxsize + maxalign - 1) / maxalign * maxalign;
 
     // Now add fields + padding for all variants, so all end up the same max size
     sizesp = sizes;
@@ -246,8 +222,8 @@ void genlSameSizeTrait(GenState *gen, StructNode *base) {
     }
     
     // basetrait also needs fields
-    if (maxStruct)
-        genlStructFields(gen, base->llvmtype, maxStruct, 0);
+    if (alignStruct)
+        genlSameSizeBase(gen, base, alignStruct->llvmtype);
 }
 
 // Generate a struct with no fields (useful for void, etc.)
@@ -428,6 +404,19 @@ LLVMTypeRef genlType(GenState *gen, INode *typ) {
         genlRefTypeSetup(gen, reftype);
         return reftype->typeinfo->llvmtyperef = _genlType(gen, "", dcltype);
     }
+    else if (dcltype->tag == PtrTag || dcltype->tag == ArrayTag || dcltype->tag == TTupleTag || dcltype->tag == FnSigTag) {
+        // Structurally equivalent types share the LLVM type memoized on their canonical node.
+        // Each node keeps it too, so only a node's first use hashes and compares its structure.
+        LLVMTypeRef *memo = dcltype->tag == FnSigTag ? &((FnSigNode*)dcltype)->llvmtype : &((ITypeNode*)dcltype)->llvmtype;
+        if (*memo == NULL) {
+            INode *canon = typetblCanon(dcltype);
+            LLVMTypeRef *canonmemo = canon->tag == FnSigTag ? &((FnSigNode*)canon)->llvmtype : &((ITypeNode*)canon)->llvmtype;
+            if (*canonmemo == NULL)
+                *canonmemo = _genlType(gen, "", canon);
+            *memo = *canonmemo;
+        }
+        return *memo;
+    }
     else
         return _genlType(gen, "", dcltype);
 }
@@ -442,3 +431,146 @@ LLVMValueRef genlSizeof(GenState *gen, INode *vtype) {
 LLVMTypeRef genlUsize(GenState *gen) {
     return (LLVMPointerSize(gen->datalayout) == 4) ? LLVMInt32TypeInContext(gen->context) : LLVMInt64TypeInContext(gen->context);
 }
+
+// ************************ TBAA *******************************
+
+// LLVM's type-based alias analysis (TBAA) may assume that loads and stores
+// of unrelated types never touch the same memory. Its type tree has a node
+// for each scalar type, under the byte node, whose accesses may alias anything.
+// As in C, signed and unsigned numbers of the same size share a node.
+// A plain struct also has a node, listing its fields' types and offsets.
+// Its fields are accessed as part of it, so fields of different structs never alias,
+// even when they have the same type. Structs of a trait's family are not plain,
+// as their values are also accessed as the trait or another variant.
+// Other scalar accesses (e.g., array elements or derefs) only name their type.
+// Aggregate values get no metadata, so LLVM assumes they may alias anything.
+// Reinterpreting a reference as one to a different type defeats all this (use --notbaa).
+
+// Build the TBAA type tree's root and scalar type nodes
+static void genlTbaaSetup(GenState *gen) {
+    static char *names[TbaaScalars] = { "byte", "int16", "int32", "int64", "float32", "float64", "pointer" };
+    LLVMMetadataRef rootname = LLVMMDStringInContext2(gen->context, "Cone TBAA", 9);
+    gen->tbaaroot = LLVMMDNodeInContext2(gen->context, &rootname, 1);
+    LLVMMetadataRef node[3];
+    node[2] = LLVMValueAsMetadata(LLVMConstInt(LLVMInt64TypeInContext(gen->context), 0, 0));
+    int i;
+    for (i = 0; i < TbaaScalars; ++i) {
+        node[0] = LLVMMDStringInContext2(gen->context, names[i], strlen(names[i]));
+        node[1] = i == TbaaByte ? gen->tbaaroot : gen->tbaascalar[TbaaByte];
+        gen->tbaascalar[i] = LLVMMDNodeInContext2(gen->context, node, 3);
+    }
+}
+
+// Return the TBAA type node for a scalar type, or NULL if not a scalar
+static LLVMMetadataRef genlTbaaScalar(GenState *gen, INode *type) {
+    switch (type->tag) {
+    case IntNbrTag: case UintNbrTag:
+        switch (((NbrNode*)type)->bits) {
+        case 1: case 8: return gen->tbaascalar[TbaaByte];
+        case 16: return gen->tbaascalar[TbaaInt16];
+        case 32: return gen->tbaascalar[TbaaInt32];
+        case 64: return gen->tbaascalar[TbaaInt64];
+        }
+        return NULL;
+    case FloatNbrTag:
+        return ((NbrNode*)type)->bits == 32 ? gen->tbaascalar[TbaaFloat32] : gen->tbaascalar[TbaaFloat64];
+    case EnumTag:
+        switch (((EnumNode*)type)->bytes) {
+        case 1: return gen->tbaascalar[TbaaByte];
+        case 2: return gen->tbaascalar[TbaaInt16];
+        case 4: return gen->tbaascalar[TbaaInt32];
+        case 8: return gen->tbaascalar[TbaaInt64];
+        }
+        return NULL;
+    case PtrTag: case RefTag:
+        return gen->tbaascalar[TbaaPointer];
+    default:
+        return NULL;
+    }
+}
+
+// Is this a plain struct, whose fields may be accessed as part of it?
+static int genlTbaaIsPlain(INode *type) {
+    StructNode *strnode = (StructNode *)type;
+    return strnode->tag == StructTag && strnode->fields.used > 0
+        && !(strnode->flags & OpaqueType) && structGetBaseTrait(strnode) == NULL;
+}
+
+// Return the TBAA type node for a plain struct
+static LLVMMetadataRef genlTbaaStruct(GenState *gen, StructNode *strnode) {
+    if (strnode->tbaatype)
+        return strnode->tbaatype;
+
+    // Each field's type node and offset follow the struct's name.
+    // A field that is neither a scalar nor a plain struct is described as bytes.
+    LLVMTypeRef structype = genlType(gen, (INode*)strnode);
+    LLVMTypeRef i64type = LLVMInt64TypeInContext(gen->context);
+    LLVMMetadataRef *node = (LLVMMetadataRef *)memAllocBlk((1 + 2 * strnode->fields.used) * sizeof(LLVMMetadataRef));
+    LLVMMetadataRef *nodep = node;
+    char *name = &strnode->namesym->namestr;
+    *nodep++ = LLVMMDStringInContext2(gen->context, name, strlen(name));
+    INode **nodesp;
+    uint32_t cnt;
+    for (nodelistFor(&strnode->fields, cnt, nodesp)) {
+        FieldDclNode *fld = (FieldDclNode *)*nodesp;
+        INode *fldtype = itypeGetTypeDcl(fld->vtype);
+        LLVMMetadataRef fldnode = genlTbaaScalar(gen, fldtype);
+        if (fldnode == NULL)
+            fldnode = genlTbaaIsPlain(fldtype) ? genlTbaaStruct(gen, (StructNode*)fldtype) : gen->tbaascalar[TbaaByte];
+        *nodep++ = fldnode;
+        *nodep++ = LLVMValueAsMetadata(LLVMConstInt(i64type, LLVMOffsetOfElement(gen->datalayout, structype, fld->index), 0));
+    }
+    return strnode->tbaatype = LLVMMDNodeInContext2(gen->context, node, (size_t)(nodep - node));
+}
+
+// Attach TBAA metadata to a load or store of lval's value
+void genlTbaa(GenState *gen, LLVMValueRef inst, INode *lval) {
+    if (gen->opt->no_tbaa)
+        return;
+    if (gen->tbaaroot == NULL)
+        genlTbaaSetup(gen);
+
+    // Deref of an immutable variable that borrowed an lval accesses that lval.
+    // This is how `x += 1` is lowered: {imm tmp = &mut x; *tmp = *tmp + 1}
+    while (lval->tag == DerefTag && ((StarNode*)lval)->vtexp->tag == VarNameUseTag) {
+        VarDclNode *var = (VarDclNode*)((NameUseNode*)((StarNode*)lval)->vtexp)->dclnode;
+        if (var->tag != VarDclTag || var->value == NULL || var->value->tag != BorrowTag
+            || (permGetFlags(var->perm) & MayWrite))
+            break;
+        lval = ((RefNode*)var->value)->vtexp;
+    }
+
+    LLVMMetadataRef access = genlTbaaScalar(gen, iexpGetTypeDcl(lval));
+    if (access == NULL)
+        return;
+
+    // The access tag names the accessed type, and the type (and offset) it is part of
+    LLVMMetadataRef base = access;
+    unsigned long long offset = 0;
+    if (lval->tag == FldAccessTag) {
+        FnCallNode *fncall = (FnCallNode *)lval;
+        INode *objtype = iexpGetTypeDcl(fncall->objfn);
+        if (genlTbaaIsPlain(objtype)) {
+            FieldDclNode *flddcl = (FieldDclNode*)((NameUseNode*)fncall->methfld)->dclnode;
+            base = genlTbaaStruct(gen, (StructNode*)objtype);
+            offset = LLVMOffsetOfElement(gen->datalayout, genlType(gen, objtype), flddcl->index);
+        }
+    }
+    LLVMMetadataRef tag[3] = {
+        base,
+        access,
+        LLVMValueAsMetadata(LLVMConstInt(LLVMInt64TypeInContext(gen->context), offset, 0))
+    };
+    LLVMSetMetadata(inst, LLVMGetMDKindIDInContext(gen->context, "tbaa", 4),
+        LLVMMetadataAsValue(gen->context, LLVMMDNodeInContext2(gen->context, tag, 3)));
+}
+
+// Attach TBAA metadata to the loads and stores through ptr (to lval) that follow instruction after
+void genlTbaaAfter(GenState *gen, LLVMValueRef after, LLVMValueRef ptr, INode *lval) {
+    LLVMValueRef inst = after ? LLVMGetNextInstruction(after) : LLVMGetFirstInstruction(LLVMGetInsertBlock(gen->builder));
+    for (; inst; inst = LLVMGetNextInstruction(inst)) {
+        if ((LLVMIsALoadInst(inst) && LLVMGetOperand(inst, 0) == ptr)
+            || (LLVMIsAStoreInst(inst) && LLVMGetOperand(inst, 1) == ptr))
+            genlTbaa(gen, inst, lval);
+    }
+}
@@ -0,0 +1,92 @@
+/** Escape analysis
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "ir.h"
+
+#include <stdio.h>
+
+// Statistics on unique allocations
+static uint32_t escapeStack = 0;    // Allocations that cannot escape their function
+static uint32_t escapeCount = 0;    // All unique allocations
+
+typedef struct {
+    VarDclNode *var;
+    uint32_t uses;      // Every use of the variable
+    uint32_t derefs;    // Uses that only dereference it
+} EscapeUses;
+
+// Is node a use of the variable?
+static int escapeIsVar(INode *node, VarDclNode *var) {
+    return node->tag == VarNameUseTag && ((NameUseNode*)node)->dclnode == (INode*)var;
+}
+
+// Count the variable's uses, and how many of them only dereference it
+static int escapeUsesVisit(INode *node, void *ctx) {
+    EscapeUses *uses = (EscapeUses*)ctx;
+    if (node->tag == DerefTag && escapeIsVar(((StarNode*)node)->vtexp, uses->var)) {
+        ++uses->uses;
+        ++uses->derefs;
+    }
+    else if (escapeIsVar(node, uses->var))
+        ++uses->uses;
+    else if (inodeEachChild(node, escapeUsesVisit, ctx) < 0)
+        ++uses->uses;   // A node this pass does not know might do anything with it
+    return 0;
+}
+
+// Is the unique reference a new, fixed-size allocation?
+static int escapeIsUniAlloc(INode *node) {
+    if (node->tag != AllocateTag || (node->flags & FlagQues))
+        return 0;
+    RefNode *reftype = (RefNode*)itypeGetTypeDcl(((RefNode*)node)->vtype);
+    return reftype->tag == RefTag && isRegion(reftype->region, soName);
+}
+
+// Mark a variable's allocation for the stack, if its function only ever dereferences the variable.
+// Anything else (moving, copying, assigning or casting it) might let the allocation escape.
+static void escapeVar(BlockNode *fnbody, VarDclNode *var) {
+    if (!var->value || !escapeIsUniAlloc(var->value))
+        return;
+    EscapeUses uses;
+    uses.var = var;
+    uses.uses = 0;
+    uses.derefs = 0;
+    escapeUsesVisit((INode*)fnbody, &uses);
+    if (uses.uses != uses.derefs)
+        return;
+    var->flags |= FlagStackAlloc;
+    var->value->flags |= FlagStackAlloc;
+    ++escapeStack;
+}
+
+static int escapeVisit(INode *node, void *fnbody) {
+    if (escapeIsUniAlloc(node))
+        ++escapeCount;
+    else if (node->tag == BlockTag) {
+        INode **nodesp;
+        uint32_t cnt;
+        for (nodesFor(((BlockNode*)node)->stmts, cnt, nodesp)) {
+            if ((*nodesp)->tag == VarDclTag)
+                escapeVar((BlockNode*)fnbody, (VarDclNode*)*nodesp);
+        }
+    }
+    inodeEachChild(node, escapeVisit, fnbody);
+    return 0;
+}
+
+// Mark the unique allocations in a function's body that cannot escape it
+void escapeFn(BlockNode *fnbody) {
+    escapeVisit((INode*)fnbody, fnbody);
+}
+
+// Print how many unique allocations may go on the stack
+void escapePrintStats() {
+    if (escapeCount == 0)
+        return;
+    printf("Unique allocations: %u can go on the stack, %u on the heap (%.1f%% on the stack)\n\n",
+        escapeStack, escapeCount - escapeStack, 100.0 * escapeStack / escapeCount);
+}
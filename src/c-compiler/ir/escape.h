@@ -0,0 +1,28 @@
+/** Escape analysis, which finds unique allocations that can live on the stack
+ *
+ * A `so` allocation is freed when the variable that owns it goes out of scope,
+ * unless its reference was moved elsewhere first. When a local variable is
+ * initialized with a new allocation, and its function only ever dereferences it
+ * (to read or change the value, or borrow from it), the allocation cannot outlive
+ * the function's frame. Such an allocation is marked (FlagStackAlloc) to be
+ * generated in stack storage, if it is small enough, saving a malloc and free.
+ * Its variable is then dealiased without being freed.
+ *
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#ifndef escape_h
+#define escape_h
+
+typedef struct BlockNode BlockNode;
+
+// Mark the unique allocations in a function's body that cannot escape it
+void escapeFn(BlockNode *fnbody);
+
+// Print how many unique allocations may go on the stack
+void escapePrintStats();
+
+#endif
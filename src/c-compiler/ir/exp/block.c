@@ -234,6 +234,7 @@ void blockNoBreak(BlockNode *blk) {
 void blockFlow(FlowState *fstate, BlockNode **blknode) {
     BlockNode *blk = *blknode;
     size_t svpos = flowScopePush();
+    uint16_t *loopstart = blk->flags & FlagLoop? flowMovedSave() : NULL;
 
     // If this is function's main block, include parameters in flow analysis
     if (++fstate->scope == 2) {
@@ -297,6 +298,7 @@ void blockFlow(FlowState *fstate, BlockNode **blknode) {
         int doalias = flowScopeDealias(0, &((BreakRetNode *)*nodesp)->dealias, *retexp);
         if (*retexp != unknownType && doalias) {
             flowLoadValue(fstate, retexp);
+            flowScopeDropMoved(((BreakRetNode *)*nodesp)->dealias);
         }
         break;
     }
@@ -304,15 +306,19 @@ void blockFlow(FlowState *fstate, BlockNode **blknode) {
     {
         INode **retexp = &((BreakRetNode *)*nodesp)->exp;
         int doalias = flowScopeDealias(svpos, &((BreakRetNode *)*nodesp)->dealias, *retexp);
-        if ((*retexp)->tag != NilLitTag && doalias)
+        if ((*retexp)->tag != NilLitTag && doalias) {
             flowLoadValue(fstate, retexp);
+            flowScopeDropMoved(((BreakRetNode *)*nodesp)->dealias);
+        }
         break;
     }
     case BreakTag: {
         INode **brkexp = &((BreakRetNode *)*nodesp)->exp;
         int doalias = flowScopeDealias(svpos, &((BreakRetNode *)*nodesp)->dealias, *brkexp);
-        if ((*brkexp)->tag != NilLitTag && doalias)
+        if ((*brkexp)->tag != NilLitTag && doalias) {
             flowLoadValue(fstate, brkexp);
+            flowScopeDropMoved(((BreakRetNode *)*nodesp)->dealias);
+        }
         break;
     }
     case ContinueTag:
@@ -320,6 +326,10 @@ void blockFlow(FlowState *fstate, BlockNode **blknode) {
         break;
     }
 
+    // Unless it exits, the end of a loop's body goes round to its start again
+    if (loopstart && (*nodesp)->tag != BreakTag && (*nodesp)->tag != ReturnTag)
+        flowMovedJoin((INode*)blk, loopstart);
+
     --fstate->scope;
     flowScopePop(svpos);
 }
@@ -204,14 +204,35 @@ void ifTypeCheck(TypeCheckState *pstate, IfNode *ifnode, INode *expectType) {
 }
 
 // Perform data flow analysis on an if expression
+// Each branch starts with what was moved by the time its condition is checked.
+// Branches that return do not come back; the others join after the if.
 void ifFlow(FlowState *fstate, IfNode **ifnodep) {
     IfNode *ifnode = *ifnodep;
+    uint16_t *joined = NULL;
+    int haselse = 0;
     INode **nodesp;
     uint32_t cnt;
     for (nodesFor(ifnode->condblk, cnt, nodesp)) {
         if (*nodesp != elseCond)
             flowLoadValue(fstate, nodesp);
+        else
+            haselse = 1;
         nodesp++; cnt--;
+        uint16_t *aftercond = flowMovedSave();
         blockFlow(fstate, (BlockNode**)nodesp);
+        if (nodesLast(((BlockNode*)*nodesp)->stmts)->tag != ReturnTag) {
+            if (joined)
+                flowMovedJoin((INode*)ifnode, joined);
+            joined = flowMovedSave();
+        }
+        flowMovedRestore(aftercond);
+    }
+
+    // Without an else, not taking any branch is another path that joins
+    if (!haselse) {
+        if (joined)
+            flowMovedJoin((INode*)ifnode, joined);
     }
+    else if (joined)
+        flowMovedRestore(joined);
 }
@@ -176,6 +176,12 @@ void nameUseNameRes(NameResState *pstate, NameUseNode **namep) {
 void nameUseTypeCheck(TypeCheckState *pstate, NameUseNode **namep) {
     NameUseNode *name = *namep;
     name->vtype = ((IExpNode*)name->dclnode)->vtype;
+
+    // A use of a deferred function makes it reachable: its body needs checking
+    if (name->dclnode->tag == FnDclTag && (name->dclnode->flags & FlagDeferred)) {
+        name->dclnode->flags &= ~FlagDeferred;
+        nodesAdd(&pstate->pending, name->dclnode);
+    }
 }
 
 // Handle type check for type name use references
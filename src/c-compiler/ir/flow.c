@@ -124,9 +124,12 @@ void flowLoadValue(FlowState *fstate, INode **nodep) {
         break;
     case OrLogicTag: case AndLogicTag:
     {
+        // The right side is not always evaluated
         LogicNode *lnode = (LogicNode*)*nodep;
         flowLoadValue(fstate, &lnode->lexp);
+        uint16_t *skipped = flowMovedSave();
         flowLoadValue(fstate, &lnode->rexp);
+        flowMovedJoin(*nodep, skipped);
         break;
     }
 
@@ -193,15 +196,22 @@ size_t flowScopePush() {
     return gVarFlowStackPos;
 }
 
-// Create de-alias list of all own/rc reference variables (except single retexp name)
+// Is variable an own/rc reference, which must be freed or de-aliased at the end of its scope?
+static int flowIsDealiased(VarDclNode *var) {
+    RefNode *reftype = (RefNode*)var->vtype;
+    return reftype->tag == RefTag && (regionIsOwner(reftype->region) || isRegion(reftype->region, rcName));
+}
+
+// Create de-alias list of all own/rc reference variables (except single retexp name, or moved out)
 // As a simple optimization: returns 0 if retexp name was not de-aliased
 int flowScopeDealias(size_t startpos, Nodes **varlist, INode *retexp) {
     int doalias = 1;
     size_t pos = gVarFlowStackPos;
     while (pos > startpos) {
         VarFlowInfo *avar = &gVarFlowStackp[--pos];
-        RefNode *reftype = (RefNode*)avar->node->vtype;
-        if (reftype->tag == RefTag && (isRegion(reftype->region, soName) || isRegion(reftype->region, rcName))) {
+        if (avar->node->flowtempflags & VarMoved)
+            continue;
+        if (flowIsDealiased(avar->node)) {
             if (retexp && (retexp->tag != VarNameUseTag || ((NameUseNode *)retexp)->namesym != avar->node->namesym)) {
                 if (*varlist == NULL)
                     *varlist = newNodes(4);
@@ -214,7 +224,54 @@ int flowScopeDealias(size_t startpos, Nodes **varlist, INode *retexp) {
     return doalias;
 }
 
+// Remove variables from a de-alias list once the exit's own expression has moved them out
+void flowScopeDropMoved(Nodes *varlist) {
+    if (varlist == NULL)
+        return;
+    uint32_t index = varlist->used;
+    while (index-- > 0) {
+        if (((VarDclNode*)nodesGet(varlist, index))->flowtempflags & VarMoved)
+            nodesMakeSpace(&varlist, index, -1);
+    }
+}
+
 // Back out of current scope
 void flowScopePop(size_t startpos) {
     gVarFlowStackPos = startpos;
 }
+
+// Save whether each variable in scope has been moved, before flow takes one of several paths.
+// The first entry is the count of variables saved.
+uint16_t *flowMovedSave() {
+    uint16_t *saved = (uint16_t*)memAllocBlk((gVarFlowStackPos + 1) * sizeof(uint16_t));
+    saved[0] = (uint16_t)gVarFlowStackPos;
+    size_t pos;
+    for (pos = 0; pos < gVarFlowStackPos; ++pos)
+        saved[pos + 1] = gVarFlowStackp[pos].node->flowtempflags & VarMoved;
+    return saved;
+}
+
+// Go back to what was saved as moved, e.g., to follow another path from the same place
+void flowMovedRestore(uint16_t *saved) {
+    size_t pos;
+    for (pos = 0; pos < saved[0]; ++pos) {
+        VarDclNode *var = gVarFlowStackp[pos].node;
+        var->flowtempflags = (var->flowtempflags & (0xFFFF - VarMoved)) | saved[pos + 1];
+    }
+}
+
+// Join the current path with another (as saved) where they meet again, e.g., after an 'if'.
+// A variable moved on either path counts as moved. Own/rc references may not be moved on
+// only one, as nothing tracks at run time whether the end of their scope should free them.
+void flowMovedJoin(INode *node, uint16_t *other) {
+    size_t pos;
+    for (pos = 0; pos < other[0]; ++pos) {
+        VarDclNode *var = gVarFlowStackp[pos].node;
+        if ((var->flowtempflags & VarMoved) == other[pos + 1])
+            continue;
+        if (flowIsDealiased(var))
+            errorMsgNode(node, ErrorMove, "`%s` is moved out on only some paths through here. Move it on every path, or none.",
+                &var->namesym->namestr);
+        var->flowtempflags |= VarMoved;
+    }
+}
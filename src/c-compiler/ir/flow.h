@@ -43,9 +43,18 @@ size_t flowScopePush();
 // Create de-alias list of all own/rc reference variables, except var found in retexp 
 // As a simple optimization: returns 1 if retexp name was not de-aliased
 int flowScopeDealias(size_t pos, Nodes **varlist, INode *retexp);
+void flowScopeDropMoved(Nodes *varlist);
 // Back out of current scope
 void flowScopePop(size_t pos);
 
+// Save whether each variable in scope has been moved, before flow takes one of several paths
+uint16_t *flowMovedSave();
+// Go back to what was saved as moved, e.g., to follow another path from the same place
+void flowMovedRestore(uint16_t *saved);
+// Join the current path with another (as saved) where they meet again, e.g., after an 'if'.
+// Own/rc references may not be moved on only one of them.
+void flowMovedJoin(INode *node, uint16_t *other);
+
 // Alias Node structure
 typedef struct {
     IExpNodeHdr;
@@ -100,6 +100,13 @@ int iexpCoerce(INode **from, INode *totype) {
         return 1;
     }
     case ConvSubtype: {
+        INode *fromtypedcl = iexpGetTypeDcl(*from);
+        if (totypedcl->tag == VirtRefTag && fromtypedcl->tag == RefTag) {
+            StructNode *trait = (StructNode*)itypeGetTypeDcl(((RefNode*)totypedcl)->vtexp);
+            StructNode *strnode = (StructNode*)itypeGetTypeDcl(((RefNode*)fromtypedcl)->vtexp);
+            if (trait != strnode)
+                structVirtRefCoerced(trait, strnode);
+        }
         INode *newfrom = (INode*)newConvCastNode(*from, totypedcl);
         inodeLexCopy(newfrom, *from);
         *from = newfrom;
@@ -437,6 +437,99 @@ void inodeTypeCheckAny(TypeCheckState *pstate, INode **pgm) {
     inodeTypeCheck(pstate, pgm, unknownType);
 }
 
+// Call visit on each of node's expressions and statements, until it returns nonzero (which is returned).
+// Return -1 for a node it does not know, so that callers can assume the worst.
+int inodeEachChild(INode *node, int (*visit)(INode *node, void *ctx), void *ctx) {
+    INode **nodesp;
+    uint32_t cnt;
+    int ret;
+    switch (node->tag) {
+    case BlockTag:
+        for (nodesFor(((BlockNode*)node)->stmts, cnt, nodesp)) {
+            if ((ret = visit(*nodesp, ctx)))
+                return ret;
+        }
+        return 0;
+    case IfTag:
+        for (nodesFor(((IfNode*)node)->condblk, cnt, nodesp)) {
+            if (*nodesp != elseCond && (ret = visit(*nodesp, ctx)))
+                return ret;
+        }
+        return 0;
+    case VarDclTag:
+        return ((VarDclNode*)node)->value? visit(((VarDclNode*)node)->value, ctx) : 0;
+    case AssignTag:
+        if ((ret = visit(((AssignNode*)node)->lval, ctx)))
+            return ret;
+        return visit(((AssignNode*)node)->rval, ctx);
+    case SwapTag:
+        if ((ret = visit(((SwapNode*)node)->lval, ctx)))
+            return ret;
+        return visit(((SwapNode*)node)->rval, ctx);
+    case FnCallTag:
+    case ArrIndexTag:
+    case FldAccessTag:
+    case TypeLitTag:
+        // A type literal's objfn is its type
+        if (node->tag != TypeLitTag && (ret = visit(((FnCallNode*)node)->objfn, ctx)))
+            return ret;
+        if (((FnCallNode*)node)->args) {
+            for (nodesFor(((FnCallNode*)node)->args, cnt, nodesp)) {
+                if ((ret = visit(*nodesp, ctx)))
+                    return ret;
+            }
+        }
+        return 0;
+    case BorrowTag:
+    case ArrayBorrowTag:
+    case AllocateTag:
+    case ArrayAllocTag:
+        return visit(((RefNode*)node)->vtexp, ctx);
+    case DerefTag:
+        return visit(((StarNode*)node)->vtexp, ctx);
+    case CastTag:
+    case IsTag:
+        return visit(((CastNode*)node)->exp, ctx);
+    case NotLogicTag:
+    case OrLogicTag:
+    case AndLogicTag:
+        if ((ret = visit(((LogicNode*)node)->lexp, ctx)))
+            return ret;
+        return ((LogicNode*)node)->rexp? visit(((LogicNode*)node)->rexp, ctx) : 0;
+    case ReturnTag:
+    case BreakTag:
+    case BlockRetTag:
+        return ((BreakRetNode*)node)->exp? visit(((BreakRetNode*)node)->exp, ctx) : 0;
+    case AliasTag:
+        return visit(((AliasNode*)node)->exp, ctx);
+    case VTupleTag:
+        for (nodesFor(((TupleNode*)node)->elems, cnt, nodesp)) {
+            if ((ret = visit(*nodesp, ctx)))
+                return ret;
+        }
+        return 0;
+    case ArrayLitTag:
+        for (nodesFor(((ArrayNode*)node)->elems, cnt, nodesp)) {
+            if ((ret = visit(*nodesp, ctx)))
+                return ret;
+        }
+        return 0;
+    case NamedValTag:
+        return visit(((NamedValNode*)node)->val, ctx);
+    case ContinueTag:
+    case VarNameUseTag:
+    case TypeNameUseTag:
+    case NilLitTag:
+    case ULitTag:
+    case FLitTag:
+    case StringLitTag:
+    case SizeofTag:
+        return 0;
+    default:
+        return -1;
+    }
+}
+
 // Obtain name from a named node
 Name *inodeGetName(INode *node) {
     if (!isNamedNode(node))
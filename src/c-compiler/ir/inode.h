@@ -172,6 +172,9 @@ enum NodeTags {
 #define FlagExtern    0x0002        // FnDcl, VarDcl: C ABI extern (no value, no mangle)
 #define FlagSystem    0x0004        // FnDcl: imported system call (+stdcall on Winx86)
 #define FlagInline    0x0008        // FnDcl: "inline" fn/method
+#define FlagDeferred  0x0040        // FnDcl: body unchecked until the fn is used (--reachable)
+#define FlagMultiversion 0x0080     // FnDcl: "@multiversion" fn, with a clone per CPU level
+#define FlagNonNull   0x0200        // FnDcl: "@nonnull" region _alloc, which never returns null
 
 #define IsTagField    0x0010        // FieldNode: This field is the trait's discriminant tag
 #define IsMixin       0x0020        // FieldNode: Is a trait mixin, vs. an instantiated field
@@ -181,12 +184,14 @@ enum NodeTags {
 #define FlagVDisp     0x0004        // FnCall: a virtual dispatch function call
 #define FlagLvalOp    0x0008        // FnCall: op requires an lval as object (a mutable ref)
 #define FlagOpAssgn   0x0010        // FnCall: method is an operator assignment (e.g., +=)
+#define FlagInBounds  0x0020        // ArrIndex: index proven in bounds, so no runtime check (see range.h)
 
 #define FlagLoop      0x0001        // Block: is a Loop block
 
 #define FlagSuffix    0x0001        // Borrow: part of a borrow chain
 
 #define FlagQues      0x0001        // Alloc:  Does it return Option[T]?
+#define FlagStackAlloc 0x0100       // Alloc, VarDcl: allocation cannot escape its function (see escape.h)
 
 #define FlagUnkType   0x0001        // ULit: type is unspecified and may be converted to other number
 
@@ -199,7 +204,6 @@ enum NodeTags {
 #define TraitType          0x0010  // Is a trait (vs. struct)
 #define SameSize           0x0020  // An enumtrait, where all implementations are padded to same size
 #define HasTagField        0x0040  // A trait/struct has an enumerated field identifying the variant type
-#define NullablePtr        0x0080  // trait/struct has nullable pointer, generating optimized data
 
 #define TypeChecked        0x8000  // Type has been type-checked
 #define TypeChecking       0x4000  // Type is in process of being type-checked
@@ -239,6 +243,10 @@ void inodePrintDecr();
 // Obtain name from a named node
 Name *inodeGetName(INode *node);
 
+// Call visit on each of a (type checked) node's expressions and statements, until it returns nonzero,
+// which is returned. Return -1 for a node it does not know, so that callers can assume the worst.
+int inodeEachChild(INode *node, int (*visit)(INode *node, void *ctx), void *ctx);
+
 // Dispatch a node walk for the name resolution pass
 // - pstate is helpful state info for node traversal
 // - node is a pointer to pointer so that a node can be replaced
@@ -46,6 +46,9 @@ typedef struct GenericInfo GenericInfo;
 #include "instype.h"
 #include "clone.h"
 #include "flow.h"
+#include "range.h"
+#include "rcopt.h"
+#include "escape.h"
 
 // These includes are needed by all node handling
 #include "../parser/lexer.h"
@@ -123,6 +126,7 @@ typedef struct TypeCheckState {
     INode *typenode;          // Current type (e.g., struct)
     FnDclNode *fn;            // The function and its signature/block (for returned processing)
     uint16_t scope;           // Current block scope level
+    Nodes *pending;           // --reachable: used functions whose bodies await checking (else NULL)
 } TypeCheckState;
 
 #endif
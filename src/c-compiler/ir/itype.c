@@ -100,6 +100,7 @@ int itypeIsSame(INode *node1, INode *node2) {
 }
 
 // Calculate the hash for a type to use in type table indexing
+// Unnamed types are hashed structurally, so that all structurally equal types hash the same
 size_t itypeHash(INode *node) {
     INode *type = itypeGetTypeDcl(node);
     switch (type->tag) {
@@ -108,6 +109,16 @@ size_t itypeHash(INode *node) {
         return refHash((RefNode*)type);
     case ArrayRefTag:
         return arrayRefHash((RefNode*)type);
+    case PtrTag:
+        return ptrHash((StarNode*)type);
+    case ArrayTag:
+        return arrayHash((ArrayNode*)type);
+    case TTupleTag:
+        return ttupleHash((TupleNode*)type);
+    case FnSigTag:
+        return fnSigHash((FnSigNode*)type);
+    case VoidTag:
+        return 5381 + VoidTag;
     case PermTag:
         return ((size_t)immPerm) >> 3;  // Hash for all static permissions is the same
     default:
@@ -6,18 +6,129 @@
 */
 
 #include "../ir.h"
+#include "../../shared/timetrace.h"
 
+#include <stdio.h>
 #include <string.h>
 #include <assert.h>
 
+// Statistics on generic instantiations
+static uint32_t genericCount = 0;       // Generics instantiated at least once
+static uint32_t genericInstances = 0;   // Instantiations
+static uint32_t genericLookups = 0;     // Memo lookups
+static uint32_t genericHits = 0;        // Memo lookups that found an instantiation
+static uint32_t genericMostInstances = 0;   // Instantiations of the most instantiated generic
+static Name *genericMostName = NULL;        // Name of the most instantiated generic
+
 // Create a new generic info block
 GenericInfo *newGenericInfo() {
     GenericInfo *geninfo = (GenericInfo*)memAllocBlk(sizeof(GenericInfo));
     geninfo->parms = NULL;
-    geninfo->memonodes = NULL;
+    geninfo->memonodes = newNodes(2);  // Even an unused generic has an (empty) list to generate
+    geninfo->memoindex = NULL;
+    geninfo->memoavail = 0;
     return geninfo;
 }
 
+// Print statistics on generic instantiations and memo lookups
+void genericPrintStats() {
+    if (genericLookups == 0)
+        return;
+    printf("Generics: %u instantiations of %u generics, %u lookups, %u hits (%.1f%%)\n",
+        genericInstances, genericCount, genericLookups, genericHits, 100.0 * genericHits / genericLookups);
+    if (genericMostName)
+        printf("  Most instantiated: %s (%u)\n", &genericMostName->namestr, genericMostInstances);
+    puts("");
+}
+
+// Hash a generic's type arguments, consistent with itypeIsSame
+static size_t genericArgsHash(Nodes *args) {
+    size_t hash = 5381;
+    INode **nodesp;
+    uint32_t cnt;
+    for (nodesFor(args, cnt, nodesp))
+        hash = ((hash << 5) + hash) ^ itypeHash(*nodesp);
+    return hash;
+}
+
+// Do the type arguments of two generic calls match?
+static int genericArgsSame(Nodes *args1, Nodes *args2) {
+    INode **nodes1p, **nodes2p;
+    uint32_t cnt;
+    nodes2p = &nodesGet(args2, 0);
+    for (nodesFor(args1, cnt, nodes1p)) {
+        if (!itypeIsSame(*nodes1p, *nodes2p++))
+            return 0;
+    }
+    return 1;
+}
+
+// Find the memo index slot for these type arguments: either their instantiation's or an empty one
+static GenericMemoSlot *genericMemoSlot(GenericInfo *genericinfo, Nodes *args, size_t hash) {
+    uint32_t mask = genericinfo->memoavail - 1;
+    uint32_t slot;
+    for (slot = hash & mask;; slot = (slot + 1) & mask) {
+        GenericMemoSlot *slotp = &genericinfo->memoindex[slot];
+        if (slotp->memo == 0)
+            return slotp;
+        if (slotp->hash == hash 
+            && genericArgsSame(((FnCallNode*)nodesGet(genericinfo->memonodes, (slotp->memo - 1) << 1))->args, args))
+            return slotp;
+    }
+}
+
+// Find the instance already instantiated for these type arguments, or NULL if none
+static INode *genericMemoFind(GenericInfo *genericinfo, Nodes *args) {
+    ++genericLookups;
+    if (genericinfo->memoavail == 0)
+        return NULL;
+    GenericMemoSlot *slotp = genericMemoSlot(genericinfo, args, genericArgsHash(args));
+    if (slotp->memo == 0)
+        return NULL;
+    ++genericHits;
+    return nodesGet(genericinfo->memonodes, ((slotp->memo - 1) << 1) + 1);
+}
+
+// Remember a generic's new instance and the call that instantiated it
+static void genericMemoAdd(GenericInfo *genericinfo, FnCallNode *srcgencall, INode *instance, Name *name) {
+    nodesAdd(&genericinfo->memonodes, (INode*)srcgencall);
+    nodesAdd(&genericinfo->memonodes, instance);
+    uint32_t memos = genericinfo->memonodes->used >> 1;
+
+    // Keep the index at most half full, re-indexing every memo when it grows
+    if (memos << 1 > genericinfo->memoavail) {
+        genericinfo->memoavail = genericinfo->memoavail ? genericinfo->memoavail << 1 : 8;
+        size_t size = genericinfo->memoavail * sizeof(GenericMemoSlot);
+        genericinfo->memoindex = (GenericMemoSlot*)memAllocBlk(size);
+        memset(genericinfo->memoindex, 0, size);
+        uint32_t memo;
+        for (memo = 1; memo < memos; ++memo) {
+            Nodes *args = ((FnCallNode*)nodesGet(genericinfo->memonodes, (memo - 1) << 1))->args;
+            size_t hash = genericArgsHash(args);
+            GenericMemoSlot *slotp = genericMemoSlot(genericinfo, args, hash);
+            if (slotp->memo == 0) {
+                slotp->hash = hash;
+                slotp->memo = memo;
+            }
+        }
+    }
+    size_t hash = genericArgsHash(srcgencall->args);
+    GenericMemoSlot *slotp = genericMemoSlot(genericinfo, srcgencall->args, hash);
+    if (slotp->memo == 0) {
+        slotp->hash = hash;
+        slotp->memo = memos;
+    }
+
+    // Update statistics
+    ++genericInstances;
+    if (memos == 1)
+        ++genericCount;
+    if (memos > genericMostInstances) {
+        genericMostInstances = memos;
+        genericMostName = name;
+    }
+}
+
 // Serialize
 void genericInfoPrint(GenericInfo *info) {
     INode **nodesp;
@@ -110,16 +221,14 @@ int genericInferFnParms(TypeCheckState *pstate, Nodes *genparms, FnSigNode *genf
 // Instantiate the generic based on parms and return
 INode *genericInstantiate(TypeCheckState *pstate, FnCallNode *srcgencall, INode *nodetoclone,
         GenericInfo *genericinfo, Name *name) {
+    timeTraceBegin("Instantiate generic", name? &name->namestr : NULL);
     CloneState cstate;
     clonePushState(&cstate, (INode*)srcgencall, NULL, pstate->scope, genericinfo->parms, srcgencall->args);
     INode *instance = cloneNode(&cstate, nodetoclone);
     clonePopState();
 
     // Remember instantiation for the future
-    if (!genericinfo->memonodes)
-        genericinfo->memonodes = newNodes(2);
-    nodesAdd(&genericinfo->memonodes, (INode*)srcgencall);
-    nodesAdd(&genericinfo->memonodes, instance);
+    genericMemoAdd(genericinfo, srcgencall, instance, name);
 
     // Type check the instanced declaration
     inodeTypeCheckAny(pstate, &instance);
@@ -129,6 +238,7 @@ INode *genericInstantiate(TypeCheckState *pstate, FnCallNode *srcgencall, INode
     inodeLexCopy((INode*)fnuse, (INode*)srcgencall);
     fnuse->tag = isTypeNode(instance) ? TypeNameUseTag : VarNameUseTag;
     fnuse->dclnode = instance;
+    timeTraceEnd();
     return (INode *)fnuse;
 }
 
@@ -156,33 +266,15 @@ INode *genericMemoize(TypeCheckState *pstate, FnCallNode *srcgencall, INode *nod
     if (badargs)
         return NULL;
 
-    if (!genericinfo->memonodes)
-        genericinfo->memonodes = newNodes(2);
-
-    // Check whether these types have already been instantiated for this generic
-    // memonodes holds pairs of nodes: an FnCallNode and what it instantiated
-    // A match is the first FnCallNode whose types match what we want
-    for (nodesFor(genericinfo->memonodes, cnt, nodesp)) {
-        FnCallNode *fncallprior = (FnCallNode *)*nodesp;
-        nodesp++; cnt--; // skip to instance srcgencallp
-        int match = 1;
-        INode **priornodesp;
-        uint32_t priorcnt;
-        INode **nownodesp = &nodesGet(srcgencall->args, 0);
-        for (nodesFor(fncallprior->args, priorcnt, priornodesp)) {
-            if (!itypeIsSame(*priornodesp, *nownodesp)) {
-                match = 0;
-                break;
-            }
-            nownodesp++;
-        }
-        if (match) {
-            // Return a namenode pointing to dcl instance
-            NameUseNode *fnuse = newNameUseNode(name);
-            fnuse->tag = isTypeNode(*nodesp) ? TypeNameUseTag : VarNameUseTag;
-            fnuse->dclnode = *nodesp;
-            return (INode *)fnuse;
-        }
+    // Check whether these types have already been instantiated for this generic,
+    // using the hashed index of its memonodes (pairs of an FnCallNode and what it instantiated)
+    INode *instance = genericMemoFind(genericinfo, srcgencall->args);
+    if (instance) {
+        // Return a namenode pointing to dcl instance
+        NameUseNode *fnuse = newNameUseNode(name);
+        fnuse->tag = isTypeNode(instance) ? TypeNameUseTag : VarNameUseTag;
+        fnuse->dclnode = instance;
+        return (INode *)fnuse;
     }
 
     // No match found, instantiate the dcl generic
@@ -7,14 +7,25 @@
 #ifndef generic_h
 #define generic_h
 
+// A slot in a generic's hashed index of its instantiations
+typedef struct {
+    size_t hash;             // Hash of the instantiation's type arguments
+    uint32_t memo;           // Index of the call/instance pair in memonodes, plus 1 (0 if empty)
+} GenericMemoSlot;
+
 typedef struct GenericInfo {
     Nodes *parms;            // Declared parameter nodes w/ defaults (GenVarTag)
     Nodes *memonodes;        // Pairs of memoized generic calls and cloned bodies
+    GenericMemoSlot *memoindex;  // Hashed index into memonodes, by type arguments
+    uint32_t memoavail;      // Number of slots in memoindex (power of 2)
 } GenericInfo;
 
 // Create a new generic info block
 GenericInfo *newGenericInfo();
 
+// Print statistics on generic instantiations and memo lookups
+void genericPrintStats();
+
 // Serialize
 void genericInfoPrint(GenericInfo *info);
 
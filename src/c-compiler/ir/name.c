@@ -59,6 +59,7 @@ Name *optionName;
 Name *rcName;
 Name *soName;
 Name *allocMethodName;
+Name *freeMethodName;
 Name *initMethodName;
 
 void nameNewPrefix(char **prefix, char *name) {
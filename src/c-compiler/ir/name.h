@@ -76,6 +76,7 @@ extern Name *optionName;   // "Option"
 extern Name *rcName;       // "rc"
 extern Name *soName;       // "so"
 extern Name *allocMethodName;  // "_alloc"
+extern Name *freeMethodName;   // "_free"
 extern Name *initMethodName;   // "init"
 
 typedef struct VarDclNode VarDclNode;
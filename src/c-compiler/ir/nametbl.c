@@ -17,6 +17,7 @@
 
 #include "nametbl.h"
 #include "memory.h"
+#include "../shared/thread.h"
 
 #include <stdio.h>
 #include <assert.h>
@@ -105,13 +106,15 @@ void nametblGrow() {
 }
 
 /** Get pointer to interned Name in Global Name Table matching string. 
- * For unknown name, this allocates memory for the string and adds it to name table. */
+ * For unknown name, this allocates memory for the string and adds it to name table.
+ * When worker threads share the name table, lookup and insertion are locked. */
 Name *nametblFind(char *strp, size_t strl) {
     size_t hash;
     Name **slotp;
 
     // Hash provide string into table
     nameHashFn(hash, strp, strl);
+    threadSharedLock();
     nametblFindSlot(slotp, hash, strp, strl);
 
     // If not already a name, allocate memory for string and add to table
@@ -131,7 +134,9 @@ Name *nametblFind(char *strp, size_t strl) {
         newname->namesz = (unsigned char)strl;
         newname->node = NULL;        // Node not yet known
     }
-    return *slotp;
+    Name *name = *slotp;
+    threadSharedUnlock();
+    return name;
 }
 
 // Return size of unused space for name table
@@ -198,6 +203,7 @@ void nametblInit() {
     rcName = nametblFind("rc", 2);
     soName = nametblFind("so", 2);
     allocMethodName = nametblFind("_alloc", 6);
+    freeMethodName = nametblFind("_free", 5);
     initMethodName = nametblFind("init", 4);
 }
 
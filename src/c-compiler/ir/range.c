@@ -0,0 +1,365 @@
+/** The range analysis pass
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "ir.h"
+
+#include <stdio.h>
+#include <assert.h>
+
+// Statistics on bounds checks
+static uint32_t rangeEliminated = 0;    // Indexing proven in bounds
+static uint32_t rangeKept = 0;          // Indexing that keeps its bounds check
+
+// What is known about a variable in part of a loop's body
+typedef struct {
+    VarDclNode *var;        // Unsigned local variable that is below the limit
+    uint64_t limit;         // Constant the variable is below (if no slice)
+    VarDclNode *slice;      // Slice variable whose length the variable is below (or NULL)
+} RangeFact;
+
+#define RangeFactMax 64
+typedef struct {
+    BlockNode *fnbody;
+    RangeFact facts[RangeFactMax];
+    int factcnt;
+} RangeState;
+
+// Is node a use of the variable?
+static int rangeIsVar(INode *node, VarDclNode *var) {
+    return node->tag == VarNameUseTag && ((NameUseNode*)node)->dclnode == (INode*)var;
+}
+
+// Does the node use the variable anywhere (or might it)?
+static int rangeUsesVisit(INode *node, void *var) {
+    if (rangeIsVar(node, (VarDclNode*)var))
+        return 1;
+    return inodeEachChild(node, rangeUsesVisit, var) != 0;
+}
+
+// Might the node change the variable's value?
+static int rangeWritesVisit(INode *node, void *var) {
+    switch (node->tag) {
+    case AssignTag: {
+        INode *lval = ((AssignNode*)node)->lval;
+        if (lval->tag == VTupleTag) {
+            INode **nodesp;
+            uint32_t cnt;
+            for (nodesFor(((TupleNode*)lval)->elems, cnt, nodesp)) {
+                if (rangeIsVar(*nodesp, (VarDclNode*)var))
+                    return 1;
+            }
+        }
+        else if (rangeIsVar(lval, (VarDclNode*)var))
+            return 1;
+        break;
+    }
+    case SwapTag:
+        if (rangeIsVar(((SwapNode*)node)->lval, (VarDclNode*)var) || rangeIsVar(((SwapNode*)node)->rval, (VarDclNode*)var))
+            return 1;
+        break;
+    case BorrowTag:
+    case ArrayBorrowTag:
+        if (rangeIsVar(((RefNode*)node)->vtexp, (VarDclNode*)var))
+            return 1;
+        break;
+    case FnCallTag:
+        if ((node->flags & FlagLvalOp) && rangeIsVar(((FnCallNode*)node)->objfn, (VarDclNode*)var))
+            return 1;
+        break;
+    }
+    return inodeEachChild(node, rangeWritesVisit, var) != 0;
+}
+
+// Is the function call an intrinsic that updates the value its first argument borrows (e.g., ++)?
+static int rangeIsUpdate(FnCallNode *fncall) {
+    if (fncall->objfn->tag != VarNameUseTag || !fncall->args || fncall->args->used == 0)
+        return 0;
+    FnDclNode *fndcl = (FnDclNode*)((NameUseNode*)fncall->objfn)->dclnode;
+    if (fndcl->tag != FnDclTag || !fndcl->value || fndcl->value->tag != IntrinsicTag)
+        return 0;
+    switch (((IntrinsicNode*)fndcl->value)->intrinsicFn) {
+    case IncrIntrinsic: case DecrIntrinsic: case IncrPostIntrinsic: case DecrPostIntrinsic:
+    case AddEqIntrinsic: case SubEqIntrinsic:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// Visit all but the first argument of a function call
+static int rangeOtherArgs(FnCallNode *fncall, int (*visit)(INode *node, void *ctx), void *ctx) {
+    uint32_t i;
+    for (i = 1; i < fncall->args->used; ++i) {
+        if (visit(nodesGet(fncall->args, i), ctx))
+            return 1;
+    }
+    return 0;
+}
+
+// Is the block an operator assignment (e.g., +=) on the variable, as type checking generates it:
+// {imm tmp = &mut var; *tmp = op(*tmp, ...)}? If so, return the call to op.
+static FnCallNode *rangeOpAssign(BlockNode *blk, VarDclNode *var) {
+    if (blk->stmts->used != 2)
+        return NULL;
+    VarDclNode *tmp = (VarDclNode*)nodesGet(blk->stmts, 0);
+    if (tmp->tag != VarDclTag || !tmp->value || tmp->value->tag != BorrowTag
+        || !rangeIsVar(((RefNode*)tmp->value)->vtexp, var))
+        return NULL;
+    AssignNode *assign = (AssignNode*)nodesGet(blk->stmts, 1);
+    if (assign->tag == BlockRetTag)
+        assign = (AssignNode*)((BreakRetNode*)assign)->exp;
+    if (assign->tag != AssignTag || assign->lval->tag != DerefTag
+        || !rangeIsVar(((StarNode*)assign->lval)->vtexp, tmp))
+        return NULL;
+    FnCallNode *opcall = (FnCallNode*)assign->rval;
+    if (opcall->tag != FnCallTag || !opcall->args || opcall->args->used == 0)
+        return NULL;
+    INode *self = nodesGet(opcall->args, 0);
+    if (self->tag != DerefTag || !rangeIsVar(((StarNode*)self)->vtexp, tmp)
+        || rangeOtherArgs(opcall, rangeUsesVisit, tmp))
+        return NULL;
+    return opcall;
+}
+
+// Might the node borrow the variable, other than to update it with an operator (e.g., ++ or +=)?
+// Such a borrow could be used to change the variable where this pass does not see it.
+static int rangeBorrowsVisit(INode *node, void *var) {
+    switch (node->tag) {
+    case BorrowTag:
+    case ArrayBorrowTag:
+        if (rangeIsVar(((RefNode*)node)->vtexp, (VarDclNode*)var))
+            return 1;
+        break;
+    case BlockTag: {
+        FnCallNode *opcall = rangeOpAssign((BlockNode*)node, (VarDclNode*)var);
+        if (opcall)
+            return rangeOtherArgs(opcall, rangeBorrowsVisit, var);
+        break;
+    }
+    case FnCallTag: {
+        FnCallNode *fncall = (FnCallNode*)node;
+        INode *self = fncall->args && fncall->args->used > 0? nodesGet(fncall->args, 0) : NULL;
+        if (self && self->tag == BorrowTag && rangeIsVar(((RefNode*)self)->vtexp, (VarDclNode*)var)
+            && rangeIsUpdate(fncall))
+            return rangeOtherArgs(fncall, rangeBorrowsVisit, var);
+        break;
+    }
+    }
+    return inodeEachChild(node, rangeBorrowsVisit, var) != 0;
+}
+
+// Can this pass track every change to the variable? It must be a local that is never borrowed.
+static int rangeIsTracked(RangeState *rstate, VarDclNode *var) {
+    return var->tag == VarDclTag && var->scope > 0
+        && !rangeBorrowsVisit((INode*)rstate->fnbody, var);
+}
+
+// Find the value of a constant, non-negative integer expression. Return 0 if it is not one.
+static int rangeConst(INode *node, uint64_t *value) {
+    while (node->tag == VarNameUseTag && ((NameUseNode*)node)->dclnode->tag == ConstDclTag)
+        node = ((ConstDclNode*)((NameUseNode*)node)->dclnode)->value;
+
+    NbrNode *type = (NbrNode*)iexpGetTypeDcl(node);
+    if (type->tag != UintNbrTag && type->tag != IntNbrTag)
+        return 0;
+    if (node->tag == ULitTag)
+        *value = ((ULitNode*)node)->uintlit;
+    else if (node->tag == CastTag && !(node->flags & FlagRecast))
+        return rangeConst(((CastNode*)node)->exp, value) && (type->bits >= 64 || *value < (1ull << (type->bits - 1)));
+    else
+        return 0;
+    // A negative signed value would not convert to the same unsigned one
+    return type->tag == UintNbrTag || type->bits >= 64 || *value < (1ull << (type->bits - 1));
+}
+
+// Does the loop begin by breaking out unless a variable is below a bound: if !(var < bound) {break}?
+// If so, fill in what is known about the variable after that test.
+static int rangeLoopTest(RangeState *rstate, BlockNode *blk, RangeFact *fact) {
+    if (blk->stmts->used < 2)
+        return 0;
+    IfNode *ifnode = (IfNode*)nodesGet(blk->stmts, 0);
+    if (ifnode->tag != IfTag || ifnode->condblk->used != 2)
+        return 0;
+    BlockNode *thenblk = (BlockNode*)nodesGet(ifnode->condblk, 1);
+    if (thenblk->tag != BlockTag || thenblk->stmts->used != 1 || nodesGet(thenblk->stmts, 0)->tag != BreakTag)
+        return 0;
+    LogicNode *notnode = (LogicNode*)nodesGet(ifnode->condblk, 0);
+    if (notnode->tag != NotLogicTag)
+        return 0;
+
+    // The test: an unsigned comparison of a local variable with a bound
+    FnCallNode *cmp = (FnCallNode*)notnode->lexp;
+    if (cmp->tag != FnCallTag || cmp->methfld || cmp->objfn->tag != VarNameUseTag
+        || !cmp->args || cmp->args->used != 2)
+        return 0;
+    FnDclNode *cmpdcl = (FnDclNode*)((NameUseNode*)cmp->objfn)->dclnode;
+    if (cmpdcl->tag != FnDclTag || !cmpdcl->value || cmpdcl->value->tag != IntrinsicTag)
+        return 0;
+    int16_t op = ((IntrinsicNode*)cmpdcl->value)->intrinsicFn;
+    if (op != LtIntrinsic && op != LeIntrinsic)
+        return 0;
+    INode *varuse = nodesGet(cmp->args, 0);
+    if (varuse->tag != VarNameUseTag || iexpGetTypeDcl(varuse)->tag != UintNbrTag)
+        return 0;
+    fact->var = (VarDclNode*)((NameUseNode*)varuse)->dclnode;
+    fact->slice = NULL;
+
+    // A constant bound, or the length of a slice variable
+    INode *bound = nodesGet(cmp->args, 1);
+    if (rangeConst(bound, &fact->limit)) {
+        if (op == LeIntrinsic && ++fact->limit == 0)
+            return 0;
+    }
+    else {
+        FnCallNode *count = (FnCallNode*)bound;
+        if (op != LtIntrinsic || count->tag != FnCallTag || count->objfn->tag != VarNameUseTag
+            || !count->args || count->args->used != 1 || nodesGet(count->args, 0)->tag != VarNameUseTag)
+            return 0;
+        FnDclNode *countdcl = (FnDclNode*)((NameUseNode*)count->objfn)->dclnode;
+        if (countdcl->tag != FnDclTag || !countdcl->value || countdcl->value->tag != IntrinsicTag
+            || ((IntrinsicNode*)countdcl->value)->intrinsicFn != CountIntrinsic)
+            return 0;
+        fact->slice = (VarDclNode*)((NameUseNode*)nodesGet(count->args, 0))->dclnode;
+        if (iexpGetTypeDcl((INode*)fact->slice)->tag != ArrayRefTag || !rangeIsTracked(rstate, fact->slice))
+            return 0;
+    }
+    return rangeIsTracked(rstate, fact->var);
+}
+
+static void rangeNode(RangeState *rstate, INode *node);
+
+static int rangeNodeVisit(INode *node, void *rstate) {
+    rangeNode((RangeState*)rstate, node);
+    return 0;
+}
+
+// Analyze a loop: what its test tells us holds until a statement may change the tested variable
+static void rangeLoop(RangeState *rstate, BlockNode *blk) {
+    RangeFact fact;
+    uint32_t known = 0;    // The fact holds in the statements after the test, up to this one
+    if (rstate->factcnt < RangeFactMax && rangeLoopTest(rstate, blk, &fact)) {
+        known = 1;
+        while (known < blk->stmts->used) {
+            INode *stmt = nodesGet(blk->stmts, known);
+            if (rangeWritesVisit(stmt, fact.var) || (fact.slice && rangeWritesVisit(stmt, fact.slice)))
+                break;
+            ++known;
+        }
+    }
+
+    uint32_t index;
+    for (index = 0; index < blk->stmts->used; ++index) {
+        int knows = index >= 1 && index < known;
+        if (knows)
+            rstate->facts[rstate->factcnt++] = fact;
+        rangeNode(rstate, nodesGet(blk->stmts, index));
+        if (knows)
+            --rstate->factcnt;
+    }
+}
+
+// Look through conversions that widen an unsigned value to a bigger unsigned type (e.g., u32 to usize),
+// as indexing with a u32 loop variable does, since they do not change its value
+static INode *rangeUnwiden(INode *node) {
+    while (node->tag == CastTag && !(node->flags & FlagRecast)) {
+        INode *exp = ((CastNode*)node)->exp;
+        NbrNode *totype = (NbrNode*)iexpGetTypeDcl(node);
+        NbrNode *fromtype = (NbrNode*)iexpGetTypeDcl(exp);
+        if (totype->tag != UintNbrTag || fromtype->tag != UintNbrTag || totype->bits < fromtype->bits)
+            break;
+        node = exp;
+    }
+    return node;
+}
+
+// Is the index known to be below the array's (or slice's) size?
+static int rangeInBounds(RangeState *rstate, INode *index, INode *array, INode *dimen) {
+    uint64_t size;
+    uint64_t value;
+    if (dimen && rangeConst(index, &value))
+        return rangeConst(dimen, &size) && value < size;
+    index = rangeUnwiden(index);
+    if (index->tag != VarNameUseTag)
+        return 0;
+    VarDclNode *var = (VarDclNode*)((NameUseNode*)index)->dclnode;
+    int i;
+    for (i = rstate->factcnt - 1; i >= 0; --i) {
+        RangeFact *fact = &rstate->facts[i];
+        if (fact->var != var)
+            continue;
+        if (fact->slice) {
+            if (!dimen && rangeIsVar(array, fact->slice))
+                return 1;
+        }
+        else if (dimen && rangeConst(dimen, &size) && fact->limit <= size)
+            return 1;
+    }
+    return 0;
+}
+
+// Mark indexing whose bounds check is unneeded
+static void rangeIndex(RangeState *rstate, FnCallNode *fncall) {
+    INode *objtype = iexpGetTypeDcl(fncall->objfn);
+    int inbounds = 1;
+    switch (objtype->tag) {
+    case ArrayTag: {
+        Nodes *dimens = ((ArrayNode*)objtype)->dimens;
+        uint32_t i;
+        for (i = 0; i < dimens->used && inbounds; ++i)
+            inbounds = rangeInBounds(rstate, nodesGet(fncall->args, i), fncall->objfn, nodesGet(dimens, i));
+        break;
+    }
+    case ArrayRefTag:
+        inbounds = rangeInBounds(rstate, nodesGet(fncall->args, 0), fncall->objfn, NULL);
+        break;
+    case ArrayDerefTag:
+        inbounds = 0;
+        break;
+    default:
+        return;     // Pointers are not bounds checked
+    }
+
+    if (inbounds) {
+        fncall->flags |= FlagInBounds;
+        ++rangeEliminated;
+    }
+    else
+        ++rangeKept;
+}
+
+// Analyze a node and all it holds
+static void rangeNode(RangeState *rstate, INode *node) {
+    switch (node->tag) {
+    case BlockTag:
+        if (node->flags & FlagLoop) {
+            rangeLoop(rstate, (BlockNode*)node);
+            return;
+        }
+        break;
+    case ArrIndexTag:
+        rangeIndex(rstate, (FnCallNode*)node);
+        break;
+    }
+    inodeEachChild(node, rangeNodeVisit, rstate);
+}
+
+// Mark the array and slice indexing in a function's body whose bounds check is provably unneeded
+void rangeFn(BlockNode *fnbody) {
+    RangeState rstate;
+    rstate.fnbody = fnbody;
+    rstate.factcnt = 0;
+    rangeNode(&rstate, (INode*)fnbody);
+}
+
+// Print how many bounds checks were eliminated or kept
+void rangePrintStats() {
+    uint32_t total = rangeEliminated + rangeKept;
+    if (total == 0)
+        return;
+    printf("Bounds checks: %u eliminated, %u kept (%.1f%% eliminated)\n\n",
+        rangeEliminated, rangeKept, 100.0 * rangeEliminated / total);
+}
@@ -0,0 +1,32 @@
+/** The range analysis pass, which eliminates provably unneeded bounds checks
+ *
+ * Array and slice indexing is bounds checked at runtime, unless this pass
+ * proves the index is in bounds. It looks for loops that begin by testing
+ * an unsigned local variable against a bound, as every 'while' and range 'each'
+ * loop does (e.g., `while i < 64` or `each i in 0usize < s.len`).
+ * Up to the loop's first statement that may change the variable (typically its increment),
+ * the variable is below the bound. Indexing with it an array no smaller than a constant bound,
+ * or the slice whose length is the bound, then needs no check.
+ *
+ * This only holds when nothing else can change the variable (or slice) behind the loop's back:
+ * it must be a local that is never borrowed, except by the compiler's own += and ++.
+ *
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#ifndef range_h
+#define range_h
+
+typedef struct BlockNode BlockNode;
+
+// Mark the array and slice indexing in a function's (type checked) body
+// whose bounds check is provably unneeded
+void rangeFn(BlockNode *fnbody);
+
+// Print how many bounds checks were eliminated or kept
+void rangePrintStats();
+
+#endif
@@ -0,0 +1,451 @@
+/** The rc optimization pass
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "ir.h"
+
+#include <stdio.h>
+
+// Statistics on rc count updates (each alias increment or scope-end decrement)
+static uint32_t rcoptRemoved = 0;
+static uint32_t rcoptKept = 0;
+
+#define RcoptLentMax 64
+typedef struct {
+    BlockNode *fnbody;
+    VarDclNode *lent[RcoptLentMax];     // Variables whose count copies borrow, so it must last its scope
+    int lentcnt;
+} RcoptState;
+
+// A variable used more than once (or maybe so, by a node the pass does not know)
+#define RcoptManyUses 2
+
+// Is the type an rc reference?
+static int rcoptIsRc(INode *type) {
+    RefNode *reftype = (RefNode *)itypeGetTypeDcl(type);
+    return reftype->tag == RefTag && isRegion(reftype->region, rcName);
+}
+
+// Is node a use of the variable?
+static int rcoptIsVar(INode *node, VarDclNode *var) {
+    return node->tag == VarNameUseTag && ((NameUseNode*)node)->dclnode == (INode*)var;
+}
+
+// Is the variable in a dealias list? Return its index + 1, or 0 if not.
+static uint32_t rcoptInList(Nodes *dealias, VarDclNode *var) {
+    if (dealias == NULL)
+        return 0;
+    INode **nodesp;
+    uint32_t cnt;
+    for (nodesFor(dealias, cnt, nodesp)) {
+        if (*nodesp == (INode*)var)
+            return dealias->used - cnt + 1;
+    }
+    return 0;
+}
+
+typedef struct {
+    VarDclNode *var;
+    uint32_t uses;
+} RcoptUses;
+
+static int rcoptUsesVisit(INode *node, void *ctx) {
+    RcoptUses *uses = (RcoptUses*)ctx;
+    if (rcoptIsVar(node, uses->var))
+        ++uses->uses;
+    else if (inodeEachChild(node, rcoptUsesVisit, ctx) < 0)
+        uses->uses += RcoptManyUses;
+    return 0;
+}
+
+// How many times does the node use the variable?
+static uint32_t rcoptUses(INode *node, VarDclNode *var) {
+    RcoptUses uses;
+    uses.var = var;
+    uses.uses = 0;
+    rcoptUsesVisit(node, &uses);
+    return uses.uses;
+}
+
+// Might the node change the variable's value (and so decrement its old value's count)?
+static int rcoptWritesVisit(INode *node, void *var) {
+    switch (node->tag) {
+    case AssignTag: {
+        INode *lval = ((AssignNode*)node)->lval;
+        if (lval->tag == VTupleTag) {
+            INode **nodesp;
+            uint32_t cnt;
+            for (nodesFor(((TupleNode*)lval)->elems, cnt, nodesp)) {
+                if (rcoptIsVar(*nodesp, (VarDclNode*)var))
+                    return 1;
+            }
+        }
+        else if (rcoptIsVar(lval, (VarDclNode*)var))
+            return 1;
+        break;
+    }
+    case SwapTag:
+        if (rcoptIsVar(((SwapNode*)node)->lval, (VarDclNode*)var) || rcoptIsVar(((SwapNode*)node)->rval, (VarDclNode*)var))
+            return 1;
+        break;
+    }
+    return inodeEachChild(node, rcoptWritesVisit, var) != 0;
+}
+
+// Might the node borrow the variable, or the object it refers to?
+// The borrowed reference could outlive the count an optimization removes.
+static int rcoptBorrowsVisit(INode *node, void *var) {
+    if ((node->tag == BorrowTag || node->tag == ArrayBorrowTag)
+        && rcoptUses(((RefNode*)node)->vtexp, (VarDclNode*)var) > 0)
+        return 1;
+    return inodeEachChild(node, rcoptBorrowsVisit, var) != 0;
+}
+
+// Is the node the variable, perhaps cast (e.g., to a pointer)?
+static int rcoptIsVarValue(INode *node, VarDclNode *var) {
+    while (node->tag == CastTag)
+        node = ((CastNode*)node)->exp;
+    return rcoptIsVar(node, var);
+}
+
+// Might the node share the object the variable refers to without counting it?
+// It might borrow it, cast it to a pointer, or hold it in a struct, tuple or array literal
+// or block value, all of which the flow pass does not count. Such sharing relies on
+// the variable keeping its count until its scope ends.
+static int rcoptSharesVisit(INode *node, void *var) {
+    INode **nodesp;
+    uint32_t cnt;
+    switch (node->tag) {
+    case BorrowTag:
+    case ArrayBorrowTag:
+        if (rcoptUses(((RefNode*)node)->vtexp, (VarDclNode*)var) > 0)
+            return 1;
+        break;
+    case CastTag:
+        if (rcoptIsVarValue(node, (VarDclNode*)var))
+            return 1;
+        break;
+    case TypeLitTag:
+        if (((FnCallNode*)node)->args) {
+            for (nodesFor(((FnCallNode*)node)->args, cnt, nodesp)) {
+                INode *arg = (*nodesp)->tag == NamedValTag? ((NamedValNode*)*nodesp)->val : *nodesp;
+                if (rcoptIsVarValue(arg, (VarDclNode*)var))
+                    return 1;
+            }
+        }
+        break;
+    case VTupleTag:
+        for (nodesFor(((TupleNode*)node)->elems, cnt, nodesp)) {
+            if (rcoptIsVarValue(*nodesp, (VarDclNode*)var))
+                return 1;
+        }
+        break;
+    case ArrayLitTag:
+        for (nodesFor(((ArrayNode*)node)->elems, cnt, nodesp)) {
+            if (rcoptIsVarValue(*nodesp, (VarDclNode*)var))
+                return 1;
+        }
+        break;
+    case ReturnTag:
+    case BreakTag:
+    case BlockRetTag:
+        if (rcoptIsVarValue(((BreakRetNode*)node)->exp, (VarDclNode*)var))
+            return 1;
+        break;
+    }
+    return inodeEachChild(node, rcoptSharesVisit, var) != 0;
+}
+
+// Might an exit move the variable out (e.g., return var), so that it is not dealiased?
+static int rcoptMovesVisit(INode *node, void *var) {
+    switch (node->tag) {
+    case ReturnTag:
+    case BreakTag:
+    case BlockRetTag:
+        if (rcoptIsVar(((BreakRetNode*)node)->exp, (VarDclNode*)var))
+            return 1;
+        break;
+    }
+    return inodeEachChild(node, rcoptMovesVisit, var) != 0;
+}
+
+// Might the node hold an exit (return, break, continue) that dealiases the variable?
+static int rcoptExitsVisit(INode *node, void *var) {
+    switch (node->tag) {
+    case ReturnTag:
+    case BreakTag:
+    case BlockRetTag:
+    case ContinueTag:
+        if (rcoptInList(((BreakRetNode*)node)->dealias, (VarDclNode*)var))
+            return 1;
+        break;
+    }
+    return inodeEachChild(node, rcoptExitsVisit, var) != 0;
+}
+
+// Remove the variable from every dealias list, counting how many held it
+static int rcoptUndealiasVisit(INode *node, void *ctx) {
+    RcoptUses *removed = (RcoptUses*)ctx;
+    switch (node->tag) {
+    case ReturnTag:
+    case BreakTag:
+    case BlockRetTag:
+    case ContinueTag: {
+        BreakRetNode *exit = (BreakRetNode*)node;
+        uint32_t index = rcoptInList(exit->dealias, removed->var);
+        if (index) {
+            nodesMakeSpace(&exit->dealias, index - 1, -1);
+            ++removed->uses;
+        }
+        break;
+    }
+    }
+    inodeEachChild(node, rcoptUndealiasVisit, ctx);
+    return 0;
+}
+
+// Find the copy (alias) of the variable that evaluating the node always makes,
+// i.e., not only in some branch or some iterations of a loop
+static AliasNode *rcoptAlwaysAlias(INode *node, VarDclNode *var) {
+    INode **nodesp;
+    uint32_t cnt;
+    AliasNode *alias;
+    switch (node->tag) {
+    case AliasTag: {
+        AliasNode *anode = (AliasNode*)node;
+        if (anode->counts == NULL && anode->aliasamt == 1 && rcoptIsVar(anode->exp, var))
+            return anode;
+        return rcoptAlwaysAlias(anode->exp, var);
+    }
+    case VarDclTag:
+        return ((VarDclNode*)node)->value? rcoptAlwaysAlias(((VarDclNode*)node)->value, var) : NULL;
+    case AssignTag:
+        if ((alias = rcoptAlwaysAlias(((AssignNode*)node)->lval, var)))
+            return alias;
+        return rcoptAlwaysAlias(((AssignNode*)node)->rval, var);
+    case FnCallTag:
+    case ArrIndexTag:
+    case FldAccessTag:
+    case TypeLitTag:
+        if (node->tag != TypeLitTag && (alias = rcoptAlwaysAlias(((FnCallNode*)node)->objfn, var)))
+            return alias;
+        if (((FnCallNode*)node)->args) {
+            for (nodesFor(((FnCallNode*)node)->args, cnt, nodesp)) {
+                if ((alias = rcoptAlwaysAlias(*nodesp, var)))
+                    return alias;
+            }
+        }
+        return NULL;
+    case AllocateTag:
+    case ArrayAllocTag:
+        return rcoptAlwaysAlias(((RefNode*)node)->vtexp, var);
+    case DerefTag:
+        return rcoptAlwaysAlias(((StarNode*)node)->vtexp, var);
+    case CastTag:
+    case IsTag:
+        return rcoptAlwaysAlias(((CastNode*)node)->exp, var);
+    case NotLogicTag:
+    case OrLogicTag:
+    case AndLogicTag:
+        // Only the left side is always evaluated
+        return rcoptAlwaysAlias(((LogicNode*)node)->lexp, var);
+    case ReturnTag:
+    case BreakTag:
+    case BlockRetTag:
+        return rcoptAlwaysAlias(((BreakRetNode*)node)->exp, var);
+    case VTupleTag:
+        for (nodesFor(((TupleNode*)node)->elems, cnt, nodesp)) {
+            if ((alias = rcoptAlwaysAlias(*nodesp, var)))
+                return alias;
+        }
+        return NULL;
+    case ArrayLitTag:
+        for (nodesFor(((ArrayNode*)node)->elems, cnt, nodesp)) {
+            if ((alias = rcoptAlwaysAlias(*nodesp, var)))
+                return alias;
+        }
+        return NULL;
+    case NamedValTag:
+        return rcoptAlwaysAlias(((NamedValNode*)node)->val, var);
+    default:
+        return NULL;
+    }
+}
+
+// Has a copy borrowed the variable's count?
+static int rcoptIsLent(RcoptState *rstate, VarDclNode *var) {
+    int i;
+    for (i = 0; i < rstate->lentcnt; ++i) {
+        if (rstate->lent[i] == var)
+            return 1;
+    }
+    return 0;
+}
+
+// A new allocation already holds the count its first holder needs,
+// so copying it into a variable, argument or field needs no increment
+static int rcoptAllocVisit(INode *node, void *rstate) {
+    if (node->tag == AliasTag) {
+        AliasNode *anode = (AliasNode*)node;
+        if (anode->counts == NULL && anode->aliasamt == 1 && anode->exp->tag == AllocateTag) {
+            anode->aliasamt = 0;
+            ++rcoptRemoved;
+        }
+    }
+    inodeEachChild(node, rcoptAllocVisit, rstate);
+    return 0;
+}
+
+// Let a copy declared as `imm copy = var` borrow var's count, when var keeps the object alive
+// for all of the copy's scope: var is a local that is never changed or borrowed
+// (which rules out moving it early), and the copy is never changed, borrowed or moved out.
+static void rcoptLend(RcoptState *rstate, VarDclNode *copy) {
+    if (copy->tag != VarDclTag || !copy->value || copy->value->tag != AliasTag)
+        return;
+    AliasNode *anode = (AliasNode*)copy->value;
+    if (anode->counts != NULL || anode->aliasamt != 1 || anode->exp->tag != VarNameUseTag)
+        return;
+    VarDclNode *var = (VarDclNode*)((NameUseNode*)anode->exp)->dclnode;
+    INode *fnbody = (INode*)rstate->fnbody;
+    if (var->tag != VarDclTag || var->scope == 0 || var == copy
+        || rstate->lentcnt >= RcoptLentMax
+        || rcoptWritesVisit(fnbody, var) || rcoptBorrowsVisit(fnbody, var)
+        || rcoptWritesVisit(fnbody, copy) || rcoptBorrowsVisit(fnbody, copy) || rcoptMovesVisit(fnbody, copy))
+        return;
+
+    RcoptUses removed;
+    removed.var = copy;
+    removed.uses = 0;
+    rcoptUndealiasVisit(fnbody, &removed);
+    anode->aliasamt = 0;
+    rcoptRemoved += 1 + removed.uses;
+    if (!rcoptIsLent(rstate, var))
+        rstate->lent[rstate->lentcnt++] = var;
+}
+
+// When the last use of a variable the block dealiases copies it, the copy can take over
+// the variable's count instead, as long as nothing can leave the variable's scope in between
+// and nothing shares the object without counting it.
+static void rcoptMoveLastUse(RcoptState *rstate, BlockNode *blk, VarDclNode *var) {
+    if (!rcoptIsRc(var->vtype) || rcoptIsLent(rstate, var))
+        return;
+
+    // Find the statement that last uses the variable
+    BreakRetNode *exit = (BreakRetNode*)nodesLast(blk->stmts);
+    uint32_t laststmt = blk->stmts->used - 1;
+    uint32_t index = blk->stmts->used;
+    uint32_t uses = 0;
+    while (index > 0 && uses == 0)
+        uses = rcoptUses(nodesGet(blk->stmts, --index), var);
+    if (uses != 1)
+        return;
+    AliasNode *anode = rcoptAlwaysAlias(nodesGet(blk->stmts, index), var);
+    if (anode == NULL)
+        return;
+
+    // Check that no other exit dealiases it after that copy
+    uint32_t later;
+    for (later = index; later < laststmt; ++later) {
+        if (rcoptExitsVisit(nodesGet(blk->stmts, later), var))
+            return;
+    }
+    if (inodeEachChild((INode*)exit, rcoptExitsVisit, var) != 0
+        || rcoptSharesVisit((INode*)rstate->fnbody, var))
+        return;
+
+    anode->aliasamt = 0;
+    nodesMakeSpace(&exit->dealias, rcoptInList(exit->dealias, var) - 1, -1);
+    rcoptRemoved += 2;
+}
+
+// Apply the optimizations to each block
+static int rcoptBlockVisit(INode *node, void *ctx) {
+    RcoptState *rstate = (RcoptState*)ctx;
+    if (node->tag == BlockTag) {
+        BlockNode *blk = (BlockNode*)node;
+        INode **nodesp;
+        uint32_t cnt;
+        for (nodesFor(blk->stmts, cnt, nodesp)) {
+            if ((*nodesp)->tag == VarDclTag && rcoptIsRc(((VarDclNode*)*nodesp)->vtype))
+                rcoptLend(rstate, (VarDclNode*)*nodesp);
+        }
+    }
+    inodeEachChild(node, rcoptBlockVisit, ctx);
+    return 0;
+}
+
+// Moving on last use is done after lending, which must not have a lent count moved early
+static int rcoptLastUseVisit(INode *node, void *ctx) {
+    RcoptState *rstate = (RcoptState*)ctx;
+    if (node->tag == BlockTag && ((BlockNode*)node)->stmts->used > 0) {
+        BlockNode *blk = (BlockNode*)node;
+        BreakRetNode *exit = (BreakRetNode*)nodesLast(blk->stmts);
+        switch (exit->tag) {
+        case ReturnTag:
+        case BreakTag:
+        case BlockRetTag:
+        case ContinueTag:
+            if (exit->dealias) {
+                uint32_t index = exit->dealias->used;
+                while (index > 0) {
+                    --index;
+                    if (index < exit->dealias->used)
+                        rcoptMoveLastUse(rstate, blk, (VarDclNode*)nodesGet(exit->dealias, index));
+                }
+            }
+            break;
+        }
+    }
+    inodeEachChild(node, rcoptLastUseVisit, ctx);
+    return 0;
+}
+
+// Count the rc count updates that are left
+static int rcoptKeptVisit(INode *node, void *ctx) {
+    switch (node->tag) {
+    case AliasTag:
+        if (((AliasNode*)node)->counts == NULL && ((AliasNode*)node)->aliasamt != 0)
+            ++rcoptKept;
+        break;
+    case ReturnTag:
+    case BreakTag:
+    case BlockRetTag:
+    case ContinueTag: {
+        Nodes *dealias = ((BreakRetNode*)node)->dealias;
+        if (dealias) {
+            INode **nodesp;
+            uint32_t cnt;
+            for (nodesFor(dealias, cnt, nodesp)) {
+                if (rcoptIsRc(((VarDclNode*)*nodesp)->vtype))
+                    ++rcoptKept;
+            }
+        }
+        break;
+    }
+    }
+    inodeEachChild(node, rcoptKeptVisit, ctx);
+    return 0;
+}
+
+// Remove redundant rc count updates from a function's body, after its data flow pass
+void rcoptFn(BlockNode *fnbody) {
+    RcoptState rstate;
+    rstate.fnbody = fnbody;
+    rstate.lentcnt = 0;
+    rcoptAllocVisit((INode*)fnbody, &rstate);
+    rcoptBlockVisit((INode*)fnbody, &rstate);
+    rcoptLastUseVisit((INode*)fnbody, &rstate);
+    rcoptKeptVisit((INode*)fnbody, &rstate);
+}
+
+// Print how many rc count updates were removed or kept
+void rcoptPrintStats() {
+    uint32_t total = rcoptRemoved + rcoptKept;
+    if (total == 0)
+        return;
+    printf("Rc count updates: %u removed, %u kept (%.1f%% removed)\n\n",
+        rcoptRemoved, rcoptKept, 100.0 * rcoptRemoved / total);
+}
@@ -0,0 +1,34 @@
+/** The rc optimization pass, which removes provably redundant reference count updates
+ *
+ * The data flow pass increments an rc reference's count whenever it is copied (an alias node),
+ * and decrements it when each variable holding one goes out of scope (a block's dealias list).
+ * After that pass, this one removes increments and decrements that cancel out:
+ *
+ * - Moving a fresh allocation: a new rc reference already has the count its first holder needs.
+ * - Moving on last use: when a variable's last use copies it, and nothing can leave
+ *   its scope before it is dealiased, the copy takes over the variable's count.
+ *   This also covers passing a variable to a function as its last use.
+ * - Borrowing a count: `imm copy = var` needs no count of its own while var
+ *   keeps the object alive, i.e., var is a local that is never changed, borrowed
+ *   or moved early, and the copy is never changed or moved out.
+ *
+ * A removed increment is left as an alias node with a count of 0, which generates nothing.
+ *
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#ifndef rcopt_h
+#define rcopt_h
+
+typedef struct BlockNode BlockNode;
+
+// Remove redundant rc count updates from a function's body, after its data flow pass
+void rcoptFn(BlockNode *fnbody);
+
+// Print how many rc count updates were removed or kept
+void rcoptPrintStats();
+
+#endif
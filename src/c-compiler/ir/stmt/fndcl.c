@@ -6,6 +6,7 @@
 */
 
 #include "../ir.h"
+#include "../../shared/timetrace.h"
 
 #include <string.h>
 #include <assert.h>
@@ -113,6 +114,16 @@ void fnImplicitReturn(INode *rettype, BlockNode *blk) {
     }
 }
 
+// With --reachable, can checking this module-level node's body wait until it is used?
+// 'main' is always checked, as the program starts there.
+int fnDclDeferrable(INode *node) {
+    if (node->tag != FnDclTag)
+        return 0;
+    FnDclNode *fnnode = (FnDclNode *)node;
+    return !fnnode->genericinfo && fnnode->value
+        && !(fnnode->namesym && strcmp(&fnnode->namesym->namestr, "main") == 0);
+}
+
 // Type checking a function's logic does more than you might think:
 // - Turn implicit returns into explicit returns
 // - Perform type checking for all statements
@@ -135,6 +146,8 @@ void fnDclTypeCheck(TypeCheckState *pstate, FnDclNode *fnnode) {
             errorMsgNode((INode*)fnnode, ErrorInvType, "self parameter for a method must match, or be a reference to, its type");
     }
 
+    timeTraceBegin("Type check fn", fnnode->namesym? &fnnode->namesym->namestr : NULL);
+
     // Syntactic sugar: Turn implicit returns into explicit returns
     fnImplicitReturn(((FnSigNode*)fnnode->vtype)->rettype, (BlockNode *)fnnode->value);
 
@@ -143,13 +156,25 @@ void fnDclTypeCheck(TypeCheckState *pstate, FnDclNode *fnnode) {
     pstate->fn = fnnode;
     inodeTypeCheck(pstate, &fnnode->value, noCareType);
     pstate->fn = svFn;
+    timeTraceEnd();
 
     // Immediately perform the data flow pass for this function
     // We run data flow separately as it requires type info which is inferred bottoms-up
     if (errors)
         return;
+    timeTraceBegin("Flow analysis", fnnode->namesym? &fnnode->namesym->namestr : NULL);
     FlowState fstate;
     fstate.fnsig = (FnSigNode *)fnnode->vtype;
     fstate.scope = 1;
     blockFlow(&fstate, (BlockNode **)&fnnode->value);
+    timeTraceEnd();
+
+    // Then find which bounds checks are unneeded
+    rangeFn((BlockNode *)fnnode->value);
+
+    // And which rc count updates cancel out
+    rcoptFn((BlockNode *)fnnode->value);
+
+    // And which allocations can go on the stack
+    escapeFn((BlockNode *)fnnode->value);
 }
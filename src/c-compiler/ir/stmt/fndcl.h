@@ -36,4 +36,7 @@ void fnDclNameRes(NameResState *pstate, FnDclNode *name);
 // - Perform data flow analysis on variables and references
 void fnDclTypeCheck(TypeCheckState *pstate, FnDclNode *fnnode);
 
+// With --reachable, can checking this module-level node's body wait until it is used?
+int fnDclDeferrable(INode *node);
+
 #endif
@@ -6,6 +6,8 @@
 */
 
 #include "../ir.h"
+#include "../../shared/thread.h"
+#include "../../shared/timetrace.h"
 
 #include <string.h>
 #include <assert.h>
@@ -38,6 +40,22 @@ void modAddNamedNode(ModuleNode *mod, Name *name, INode *node) {
     }
 }
 
+// Add a named node to the module, without hooking it into the global name table.
+// This is used when modules are parsed concurrently, as worker threads cannot share hooks.
+// Duplicates are found in the module's namespace, or among the always-hooked built-in names,
+// which is equivalent to what hooking the module's names would find.
+void modAddNamedNodeUnhooked(ModuleNode *mod, Name *name, INode *node) {
+    INode *dupnode = namespaceFind(&mod->namespace, name);
+    if (!dupnode)
+        dupnode = name->node;
+    if (!dupnode)
+        namespaceSet(&mod->namespace, name, node);
+    else {
+        errorMsgNode((INode *)node, ErrorDupName, "Global name is already defined. Duplicates not allowed.");
+        errorMsgNode(dupnode, ErrorDupName, "This is the conflicting definition for that name.");
+    }
+}
+
 // Add a newly parsed named node to the module:
 // - We preserve all nodes for later semantic pass and serialization iteration
 //     Name resolution will iterate over these even to pick up folder names/aliases
@@ -55,8 +73,12 @@ void modAddNode(ModuleNode *mod, Name *name, INode *node) {
 
     // Add to regular ordered node list
     nodesAdd(&mod->nodes, node);
-    if (name)
-        modAddNamedNode(mod, name, node);
+    if (name) {
+        if (threadShared)
+            modAddNamedNodeUnhooked(mod, name, node);
+        else
+            modAddNamedNode(mod, name, node);
+    }
 }
 
 // Serialize a module node
@@ -79,7 +101,10 @@ void modPrint(ModuleNode *mod) {
 
 // Unhook old module's names, hook new module's names
 // (works equally well from parent to child or child to parent
+// Hooking is skipped while modules are being parsed concurrently.
 void modHook(ModuleNode *oldmod, ModuleNode *newmod) {
+    if (threadShared)
+        return;
     if (oldmod)
         nametblHookPop();
     if (newmod) {
@@ -90,6 +115,7 @@ void modHook(ModuleNode *oldmod, ModuleNode *newmod) {
 
 // Name resolution of the module node
 void modNameRes(NameResState *pstate, ModuleNode *mod) {
+    timeTraceBegin("Name resolution", mod->namesym? &mod->namesym->namestr : NULL);
     ModuleNode *owningmod = pstate->mod;
     pstate->mod = mod;
 
@@ -110,6 +136,7 @@ void modNameRes(NameResState *pstate, ModuleNode *mod) {
     // Switch name table back to owner module
     modHook(mod, NULL);
     pstate->mod = owningmod;
+    timeTraceEnd();
 }
 
 // Type check the module node
@@ -121,6 +148,16 @@ void modTypeCheck(TypeCheckState *pstate, ModuleNode *mod) {
     for (nodesFor(mod->imports, cnt, nodesp)) {
         inodeTypeCheckAny(pstate, nodesp);
     }
+    timeTraceBegin("Type check module", mod->namesym? &mod->namesym->namestr : NULL);
+
+    // With --reachable, mark every function whose body can wait deferred, before checking
+    // any code, so that a use of a function declared further on also makes it reachable
+    if (pstate->pending) {
+        for (nodesFor(mod->nodes, cnt, nodesp)) {
+            if (fnDclDeferrable(*nodesp))
+                (*nodesp)->flags |= FlagDeferred;
+        }
+    }
 
     // Next, process only types for all global functions/variables
     // This ensures we can handle forward references to type info
@@ -146,9 +183,13 @@ void modTypeCheck(TypeCheckState *pstate, ModuleNode *mod) {
     }
 
     // Now we can process the full node info
+    // (With --reachable, a function's body waits to be checked until it is used)
     if (errors == 0) {
         for (nodesFor(mod->nodes, cnt, nodesp)) {
+            if (pstate->pending && fnDclDeferrable(*nodesp))
+                continue;
             inodeTypeCheckAny(pstate, nodesp);
         }
     }
+    timeTraceEnd();
 }
@@ -30,6 +30,7 @@ ModuleNode *newModuleNode();
 void modPrint(ModuleNode *mod);
 void modAddNode(ModuleNode *mod, Name *name, INode *node);
 void modAddNamedNode(ModuleNode *mod, Name *name, INode *node);
+void modAddNamedNodeUnhooked(ModuleNode *mod, Name *name, INode *node);
 void modHook(ModuleNode *oldmod, ModuleNode *newmod);
 void modNameRes(NameResState *pstate, ModuleNode *mod);
 void modTypeCheck(TypeCheckState *pstate, ModuleNode *mod);
@@ -67,4 +67,14 @@ void pgmTypeCheck(TypeCheckState *pstate, ProgramNode *pgm) {
     for (nodesFor(pgm->modules, cnt, nodesp)) {
         inodeTypeCheckAny(pstate, nodesp);
     }
+
+    // With --reachable, check the bodies of used functions,
+    // which may find more used functions to check
+    if (pstate->pending) {
+        uint32_t i;
+        for (i = 0; i < pstate->pending->used; ++i) {
+            INode *fnnode = nodesGet(pstate->pending, i);
+            inodeTypeCheckAny(pstate, &fnnode);
+        }
+    }
 }
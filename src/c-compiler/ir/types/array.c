@@ -42,6 +42,7 @@ uint64_t arrayDim1(INode *array) {
 INode *cloneArrayNode(CloneState *cstate, ArrayNode *node) {
     ArrayNode *newnode = memAllocBlk(sizeof(ArrayNode));
     memcpy(newnode, node, sizeof(ArrayNode));
+    newnode->llvmtype = NULL;
     newnode->elems = cloneNodes(cstate, node->elems);
     return (INode *)newnode;
 }
@@ -111,6 +112,17 @@ void arrayTypeCheck(TypeCheckState *pstate, ArrayNode *node) {
     node->flags |= elemtype->flags & (ThreadBound | MoveType);
 }
 
+// Calculate hash for a structural array type
+size_t arrayHash(ArrayNode *node) {
+    size_t hash = 5381 + node->tag;
+    hash = ((hash << 5) + hash) ^ itypeHash(arrayElemType((INode*)node));
+    INode **nodesp;
+    uint32_t cnt;
+    for (nodesFor(node->dimens, cnt, nodesp))
+        hash = ((hash << 5) + hash) ^ (size_t)((ULitNode *)*nodesp)->uintlit;
+    return hash;
+}
+
 // Compare two array types to see if they are equivalent
 int arrayEqual(ArrayNode *node1, ArrayNode *node2) {
     // Are element type and number of dimensions equivalent?
@@ -15,6 +15,7 @@ FnSigNode *newFnSigNode() {
     sig->flags |= OpaqueType;
     sig->parms = newNodes(8);
     sig->rettype = unknownType;
+    sig->llvmtype = NULL;
     return sig;
 }
 
@@ -22,6 +23,7 @@ FnSigNode *newFnSigNode() {
 INode *cloneFnSigNode(CloneState *cstate, FnSigNode *node) {
     FnSigNode *newnode = memAllocBlk(sizeof(FnSigNode));
     memcpy(newnode, node, sizeof(FnSigNode));
+    newnode->llvmtype = NULL;
     newnode->parms = cloneNodes(cstate, node->parms);
     newnode->rettype = cloneNode(cstate, node->rettype);
     INode **origp = &nodesGet(node->parms, 0);
@@ -68,6 +70,17 @@ void fnSigTypeCheck(TypeCheckState *pstate, FnSigNode *sig) {
     itypeTypeCheck(pstate, &sig->rettype);
 }
 
+// Calculate hash for a structural function signature: its return and parameter types
+size_t fnSigHash(FnSigNode *node) {
+    size_t hash = 5381 + node->tag;
+    hash = ((hash << 5) + hash) ^ itypeHash(node->rettype);
+    INode **nodesp;
+    uint32_t cnt;
+    for (nodesFor(node->parms, cnt, nodesp))
+        hash = ((hash << 5) + hash) ^ itypeHash(((IExpNode *)*nodesp)->vtype);
+    return hash;
+}
+
 // Compare two function signatures to see if they are equivalent
 int fnSigEqual(FnSigNode *node1, FnSigNode *node2) {
     INode **nodes1p, **nodes2p;
@@ -81,7 +94,7 @@ int fnSigEqual(FnSigNode *node1, FnSigNode *node2) {
     // Every parameter's type must also match
     nodes2p = &nodesGet(node2->parms, 0);
     for (nodesFor(node1->parms, cnt, nodes1p)) {
-        if (!itypeIsSame(*nodes1p, *nodes2p))
+        if (!itypeIsSame(((IExpNode *)*nodes1p)->vtype, ((IExpNode *)*nodes2p)->vtype))
             return 0;
         nodes2p++;
     }
@@ -103,7 +116,7 @@ int fnSigVrefEqual(FnSigNode *node1, FnSigNode *node2) {
     // Every parameter's type must also match
     nodes2p = &nodesGet(node2->parms, 0);
     for (nodesFor(node1->parms, cnt, nodes1p)) {
-        if (cnt < node1->parms->used && !itypeIsSame(*nodes1p, *nodes2p))
+        if (cnt < node1->parms->used && !itypeIsSame(((IExpNode *)*nodes1p)->vtype, ((IExpNode *)*nodes2p)->vtype))
             return 0;
         nodes2p++;
     }
@@ -17,6 +17,7 @@ typedef struct FnSigNode {
     INodeHdr;
     Nodes *parms;            // Declared parameter nodes w/ defaults (VarDclTag)
     INode *rettype;        // void, a single type or a type tuple
+    LLVMTypeRef llvmtype;  // LLVM function type, memoized by genlType
 } FnSigNode;
 
 FnSigNode *newFnSigNode();
@@ -28,6 +29,9 @@ void fnSigPrint(FnSigNode *node);
 // Name resolution of the function signature
 void fnSigNameRes(NameResState *pstate, FnSigNode *sig);
 void fnSigTypeCheck(TypeCheckState *pstate, FnSigNode *name);
+// Calculate hash for a structural function signature: its return and parameter types
+size_t fnSigHash(FnSigNode *node);
+
 int fnSigEqual(FnSigNode *node1, FnSigNode *node2);
 
 // For virtual reference structural matches on two methods,
@@ -13,6 +13,7 @@ StarNode *newStarNode(uint16_t tag) {
     StarNode *node;
     newNode(node, StarNode, tag);
     node->vtype = unknownType;
+    node->llvmtype = NULL;
     return node;
 }
 
@@ -20,6 +21,7 @@ StarNode *newStarNode(uint16_t tag) {
 INode *cloneStarNode(CloneState *cstate, StarNode *node) {
     StarNode *newnode = memAllocBlk(sizeof(StarNode));
     memcpy(newnode, node, sizeof(StarNode));
+    newnode->llvmtype = NULL;
     newnode->vtexp = cloneNode(cstate, node->vtexp);
     return (INode *)newnode;
 }
@@ -42,6 +44,12 @@ void ptrTypeCheck(TypeCheckState *pstate, StarNode *node) {
         return;
 }
 
+// Calculate hash for a structural pointer type
+size_t ptrHash(StarNode *node) {
+    size_t hash = 5381 + node->tag;
+    return ((hash << 5) + hash) ^ itypeHash(node->vtexp);
+}
+
 // Compare two pointer signatures to see if they are equivalent
 int ptrEqual(StarNode *node1, StarNode *node2) {
     return itypeIsSame(node1->vtexp, node2->vtexp);
@@ -29,6 +29,9 @@ void ptrNameRes(NameResState *pstate, StarNode *node);
 // Type check a pointer type
 void ptrTypeCheck(TypeCheckState *pstate, StarNode *name);
 
+// Calculate hash for a structural pointer type
+size_t ptrHash(StarNode *node);
+
 // Compare two pointer signatures to see if they are equivalent
 int ptrEqual(StarNode *node1, StarNode *node2);
 
@@ -155,7 +155,7 @@ size_t refHash(RefNode *node) {
     size_t hash = 5381 + node->tag;
     hash = ((hash << 5) + hash) ^ itypeHash(node->region);
     hash = ((hash << 5) + hash) ^ itypeHash(node->perm);
-    return ((hash << 5) + hash) ^ itypeHash(node->vtype);
+    return ((hash << 5) + hash) ^ itypeHash(node->vtexp);
 }
 
 // Compare two reference signatures to see if they are equivalent at runtime
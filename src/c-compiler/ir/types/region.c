@@ -16,6 +16,17 @@ int isRegion(INode *region, Name *namesym) {
     return 0;
 }
 
+// Does a single owning reference free the region's allocation when it dies?
+// That is so, and any move-only region that supplies a _free method.
+int regionIsOwner(INode *region) {
+    region = itypeGetTypeDcl(region);
+    if (region->tag != StructTag)
+        return 0;
+    if (((StructNode*)region)->namesym == soName)
+        return 1;
+    return itypeIsMove(region) && iTypeFindFnField(region, freeMethodName) != NULL;
+}
+
 int regionIsPtrU8(RefNode *ptrnode) {
     if (ptrnode->tag != PtrTag)
         return 0;
@@ -52,6 +63,22 @@ void regionAllocTypeCheck(INode *region) {
         return;
     }
 
+    // An optional _free method takes back the allocated memory and its size
+    FnDclNode *freemeth = (FnDclNode*)iTypeFindFnField(region, freeMethodName);
+    if (freemeth) {
+        FnSigNode *freesig = (FnSigNode*)itypeGetTypeDcl(freemeth->vtype);
+        if (freemeth->tag != FnDclTag || freesig->parms->used != 2
+            || !regionIsPtrU8((RefNode*)itypeGetTypeDcl(iexpGetTypeDcl(nodesGet(freesig->parms, 0))))
+            || itypeGetTypeDcl(iexpGetTypeDcl(nodesGet(freesig->parms, 1))) != (INode*)usizeType) {
+            errorMsgNode((INode*)freemeth, ErrorInvType, "Region _free method needs *u8 and usize parms.");
+            return;
+        }
+        if (!itypeIsMove(region) && ((StructNode*)region)->namesym != rcName) {
+            errorMsgNode((INode*)freemeth, ErrorInvType, "Only rc and @move regions may have a _free method.");
+            return;
+        }
+    }
+
     FnDclNode *initmeth = (FnDclNode*)iTypeFindFnField(region, initMethodName);
     if (initmeth == NULL) {
         return;
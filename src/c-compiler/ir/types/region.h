@@ -9,6 +9,7 @@
 #define region_h
 
 int isRegion(INode *region, Name *namesym);
+int regionIsOwner(INode *region);
 
 void regionAllocTypeCheck(INode *region);
 
@@ -23,6 +23,8 @@ StructNode *newStructNode(Name *namesym) {
     snode->vtable = NULL;
     snode->genericinfo = NULL;
     snode->tagnbr = 0;
+    snode->tbaatype = NULL;
+    snode->taglayout = NULL;
     return snode;
 }
 
@@ -318,6 +320,7 @@ int structAddVtableImpl(StructNode *basenode, StructNode *strnode) {
     // Create Vtable impl data structure and populate
     VtableImpl *impl = memAllocBlk(sizeof(VtableImpl));
     impl->llvmvtablep = NULL;
+    impl->coercions = 0;
     impl->structdcl = (INode*)strnode;
 
     // Construct a global name for this vtable implementation
@@ -428,6 +431,20 @@ TypeCompare structVirtRefMatches(StructNode *trait, StructNode *strnode) {
     return structAddVtableImpl(trait, strnode)? ConvSubtype : NoMatch;
 }
 
+// Count a place where a struct ref is coerced to some trait's virtual ref
+// Code generation uses these counts to guess which implementation is most used
+void structVirtRefCoerced(StructNode *trait, StructNode *strnode) {
+    INode **nodesp;
+    uint32_t cnt;
+    for (nodesFor(trait->vtable->impl, cnt, nodesp)) {
+        VtableImpl *impl = (VtableImpl*)*nodesp;
+        if (impl->structdcl == (INode*)strnode) {
+            ++impl->coercions;
+            return;
+        }
+    }
+}
+
 // Is from-type a subtype of to-struct (we know they are not the same)
 // Subtyping is complex on structs for coercions, because we want to avoid the memory management
 // messiness of converting struct values from one type to another due to depth/width polymorphism.
@@ -16,6 +16,7 @@ typedef struct {
     Nodes *methfld;            // specific methods and fields in same order as vtable
     char *name;                // generated name for the implemented vtable
     LLVMValueRef llvmvtablep;  // generates a pointer to the implemented vtable
+    uint32_t coercions;        // number of places a ref to structdcl is coerced to a virtual ref
 } VtableImpl;
 
 // Describes the virtual interface supported by some trait/struct
@@ -41,6 +42,8 @@ typedef struct StructNode {
     Vtable *vtable;         // Pointer to vtable info (may be NULL)
     GenericInfo *genericinfo;     // Link to generic parms, etc (or NULL if not generic)
     uint32_t tagnbr;        // If a tagged struct, this is the number in the tag field
+    LLVMMetadataRef tbaatype;     // TBAA type descriptor, memoized by genlTbaa
+    struct GenTagLayout *taglayout;   // For a tagged base trait, where its variants keep their tag
 } StructNode;
 
 typedef struct FieldDclNode FieldDclNode;
@@ -70,6 +73,9 @@ void structMakeVtable(StructNode *node);
 // Populate the vtable implementation info for a struct ref being coerced to some trait
 TypeCompare structVirtRefMatches(StructNode *trait, StructNode *strnode);
 
+// Count a place where a struct ref is coerced to some trait's virtual ref
+void structVirtRefCoerced(StructNode *trait, StructNode *strnode);
+
 // Will from-type coerce to to-struct (we know they are not the same)
 // We can only do this for a same-sized trait supertype
 TypeCompare structMatches(StructNode *to, INode *fromdcl, SubtypeConstraint constraint);
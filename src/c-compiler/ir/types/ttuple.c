@@ -11,6 +11,7 @@
 TupleNode *newTupleNode(int cnt) {
     TupleNode *tuple;
     newNode(tuple, TupleNode, TupleTag);
+    tuple->llvmtype = NULL;
     tuple->elems = newNodes(cnt);
     return tuple;
 }
@@ -20,6 +21,7 @@ INode *cloneTupleNode(CloneState *cstate, TupleNode *node) {
     TupleNode *newnode;
     newnode = memAllocBlk(sizeof(TupleNode));
     memcpy(newnode, node, sizeof(TupleNode));
+    newnode->llvmtype = NULL;
     newnode->elems = cloneNodes(cstate, node->elems);
     return (INode *)newnode;
 }
@@ -65,6 +67,16 @@ void ttupleTypeCheck(TypeCheckState *pstate, TupleNode *tuple) {
         itypeTypeCheck(pstate, nodesp);
 }
 
+// Calculate hash for a structural tuple type
+size_t ttupleHash(TupleNode *node) {
+    size_t hash = 5381 + node->tag;
+    INode **nodesp;
+    uint32_t cnt;
+    for (nodesFor(node->elems, cnt, nodesp))
+        hash = ((hash << 5) + hash) ^ itypeHash(*nodesp);
+    return hash;
+}
+
 // Compare that two tuples are equivalent
 int ttupleEqual(TupleNode *totype, TupleNode *fromtype) {
     if (fromtype->tag != TTupleTag)
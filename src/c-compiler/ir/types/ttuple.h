@@ -30,6 +30,9 @@ void ttupleNameRes(NameResState *pstate, TupleNode *node);
 // Type check type tuple node
 void ttupleTypeCheck(TypeCheckState *pstate, TupleNode *node);
 
+// Calculate hash for a structural tuple type
+size_t ttupleHash(TupleNode *node);
+
 // Compare that two tuples are equivalent
 int ttupleEqual(TupleNode *totype, TupleNode *fromtype);
 
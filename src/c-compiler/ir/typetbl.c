@@ -74,31 +74,43 @@ void typetblGrow() {
     // memFreeBlk(oldTable);
 }
 
-/** Get pointer to type's normalized metadata in Global Type Table matching type. 
- * For unknown type, this allocates memory for the metadata and adds it to type table. */
-void *typetblFind(INode *type, void *(*allocfn)()) {
+/** Get the type table entry for a type, adding the type to the table if not already there */
+static TypeTblEntry *typetblEntry(INode *type) {
     TypeTblEntry *slotp;
 
     // Hash provide string into table
     size_t hash = itypeHash(type);
     typetblFindSlot(slotp, hash, type);
 
-    // If not already a name, allocate memory for string and add to table
+    // If not already a type, add it to table
     if (slotp->type == NULL) {
         // Double table if it has gotten too full
         if (++gTypeTblUsed >= gTypeTblCeil) {
             typetblGrow();
             typetblFindSlot(slotp, hash, type);
         }
-
-        // Allocate and populate type info
         slotp->type = type;
         slotp->hash = hash;
-        slotp->normal = allocfn();
+        slotp->normal = NULL;
     }
+    return slotp;
+}
+
+/** Get pointer to type's normalized metadata in Global Type Table matching type. 
+ * For unknown type, this allocates memory for the metadata and adds it to type table. */
+void *typetblFind(INode *type, void *(*allocfn)()) {
+    TypeTblEntry *slotp = typetblEntry(type);
+    if (slotp->normal == NULL)
+        slotp->normal = allocfn();
     return slotp->normal;
 }
 
+/** Get the canonical definition for a structural type: the first structurally
+ * equivalent type added to the Global Type Table. */
+INode *typetblCanon(INode *type) {
+    return typetblEntry(type)->type;
+}
+
 // Return size of unused space for name table
 size_t typetblUnused() {
     return (gTypeTblAvail-gTypeTblUsed)*sizeof(TypeTblEntry);
@@ -40,6 +40,10 @@ void typetblInit();
 // For an unknown type, it allocates memory for the metadata and adds it to type table.
 void *typetblFind(INode *type, void *(*allocfn)());
 
+// Get the canonical definition for a structural type (the first equivalent type seen),
+// so that all equivalent types can share what is built for it (e.g., its LLVM type)
+INode *typetblCanon(INode *type);
+
 // Return how many bytes have been allocated for global type table but not yet used
 size_t typetblUnused();
 
@@ -9,12 +9,14 @@
 */
 
 #include "lexer.h"
+#include "lexscan.h"
 #include "../ir/ir.h"
 #include "../ir/nametbl.h"
 #include "../shared/error.h"
 #include "../shared/fileio.h"
 #include "../shared/memory.h"
 #include "../shared/timer.h"
+#include "../shared/timetrace.h"
 #include "../shared/utf8.h"
 
 #include <string.h>
@@ -23,7 +25,7 @@
 #include <stdio.h>
 
 // Global lexer state
-Lexer *lex = NULL;        // Current lexer
+threadlocal Lexer *lex = NULL;        // Current lexer
 
 // Inject a new source stream into the lexer
 void lexInject(char *src, char *url) {
@@ -93,6 +95,8 @@ void keywordInit() {
     keyAdd("union", UnionToken);
     keyAdd("@move", MoveToken);
     keyAdd("@opaque", OpaqueToken);
+    keyAdd("@multiversion", MultiversionToken);
+    keyAdd("@nonnull", NonNullToken);
     keyAdd("extends", ExtendsToken);
     keyAdd("mixin", MixinToken);
     keyAdd("enum", EnumToken);
@@ -133,15 +137,22 @@ void lexInit(ConeOptions *opt) {
     keywordInit();
 }
 
-// Inject a new source stream into the lexer
+// Inject a new source stream into the lexer, relative to current source
 void lexInjectFile(char *url) {
+    lexInjectFileFrom(lex? lex->url : NULL, url);
+}
+
+// Inject a new source stream into the lexer, whose url is relative to fromurl
+void lexInjectFileFrom(char *fromurl, char *url) {
     char *src;
     char *fn;
     timerBegin(LoadTimer);
+    timeTraceBegin("Load", url);
     // Load specified source file
-    src = fileLoadSrc(lex? lex->url : NULL, url, &fn);
+    src = fileLoadSrc(fromurl, url, &fn);
     if (!src)
         errorExit(ExitNF, "Cannot find or read source file %s", url);
+    timeTraceEnd();
 
     timerBegin(ParseTimer);
     lexInject(src, fn);
@@ -232,6 +243,12 @@ char *lexNewLine(char *srcp) {
     // Count line's indentation
     lex->curindent = 0;
     while (1) {
+        // Fast path: a run of the indentation character already in use
+        if ((*srcp == ' ' || *srcp == '\t') && *srcp == lex->indentch) {
+            char *runendp = lexScanRun(srcp, lex->indentch);
+            lex->curindent += runendp - srcp;
+            srcp = runendp;
+        }
         if (*srcp == '\r')
             srcp++;
         else if (*srcp == ' ' || *srcp == '\t') {
@@ -368,16 +385,17 @@ void lexScanString(char *srcp) {
     uint64_t uchar;
     lex->tokp = srcp++;
 
-    // Conservatively count the size of the string
-    uint32_t srclen = 0;
-    while (*srcp && *srcp != '"') {
-        srclen++;
-        srcp++;
-        if (*srcp == '\\' && *(srcp + 1) == '"') {
-            srclen++;
-            srcp += 2;
-        }
+    // Conservatively count the size of the string: its bytes up to the closing quote
+    while (1) {
+        srcp = lexScanStringChars(srcp);
+        if (*srcp == '\\')
+            srcp += *(srcp + 1) ? 2 : 1;   // Escaped character
+        else if (*srcp && *srcp != '"')
+            srcp++;     // Control character
+        else
+            break;
     }
+    uint32_t srclen = (uint32_t)(srcp - lex->tokp - 1);
 
     // Build string literal
     char *newp = memAllocStr(NULL, srclen);
@@ -394,10 +412,13 @@ void lexScanString(char *srcp) {
             continue;
         }
 
-        // Copy over next byte or an escaped character
+        // Copy over a run of plain bytes or an escaped character
         if (*srcp != '\\') {
-            *newp++ = *srcp++; // Works for utf8-encoded characters as well
-            srclen++;
+            char *runendp = lexScanStringChars(srcp);   // Works for utf8-encoded characters as well
+            memcpy(newp, srcp, runendp - srcp);
+            newp += runendp - srcp;
+            srclen += (uint32_t)(runendp - srcp);
+            srcp = runendp;
         }
         else {
             // Handle escaped character(s), including unicode
@@ -570,49 +591,31 @@ void lexScanIdent(char *srcp) {
     lex->tokp = srcbeg;
     srcp += utf8ByteSkip(srcp);  // Skip past already accepted first character
     while (1) {
-        switch (*srcp) {
-
         // Allow digit, letter or underscore in token
-        case '0': case '1': case '2': case '3': case '4':
-        case '5': case '6': case '7': case '8': case '9':
-        case 'a': case 'b': case 'c': case 'd': case 'e':
-        case 'f': case 'g': case 'h': case 'i': case 'j':
-        case 'k': case 'l': case 'm': case 'n': case 'o':
-        case 'p': case 'q': case 'r': case 's': case 't':
-        case 'u': case 'v': case 'w': case 'x': case 'y': case 'z':
-        case 'A': case 'B': case 'C': case 'D': case 'E':
-        case 'F': case 'G': case 'H': case 'I': case 'J':
-        case 'K': case 'L': case 'M': case 'N': case 'O':
-        case 'P': case 'Q': case 'R': case 'S': case 'T':
-        case 'U': case 'V': case 'W': case 'X': case 'Y': case 'Z':
-        case '_':
-            srcp++;
-            break;
+        srcp = lexScanIdentChars(srcp);
 
-        default:
-            // Allow unicode letters in identifier name
-            if (utf8IsLetter(srcp)) {
-                srcp += utf8ByteSkip(srcp);
-            }
-            else {
-                INode *identNode;
-                // Find identifier token in name table and preserve info about it
-                // Substitute token type when identifier is a keyword
-                lex->val.ident = nametblFind(srcbeg, srcp-srcbeg);
-                identNode = (INode*)lex->val.ident->node;
-                if (identNode && identNode->tag == KeywordTag)
-                    lex->toktype = identNode->flags;
-                else if (identNode && identNode->tag == PermTag)
-                    lex->toktype = PermToken;
-                else if (*srcbeg == '@')
-                    lex->toktype = AttrIdentToken;
-                else if (*srcbeg == '#')
-                    lex->toktype = MetaIdentToken;
-                else
-                    lex->toktype = IdentToken;
-                lex->srcp = srcp;
-                return;
-            }
+        // Allow unicode letters in identifier name
+        if (utf8IsLetter(srcp)) {
+            srcp += utf8ByteSkip(srcp);
+        }
+        else {
+            INode *identNode;
+            // Find identifier token in name table and preserve info about it
+            // Substitute token type when identifier is a keyword
+            lex->val.ident = nametblFind(srcbeg, srcp-srcbeg);
+            identNode = (INode*)lex->val.ident->node;
+            if (identNode && identNode->tag == KeywordTag)
+                lex->toktype = identNode->flags;
+            else if (identNode && identNode->tag == PermTag)
+                lex->toktype = PermToken;
+            else if (*srcbeg == '@')
+                lex->toktype = AttrIdentToken;
+            else if (*srcbeg == '#')
+                lex->toktype = MetaIdentToken;
+            else
+                lex->toktype = IdentToken;
+            lex->srcp = srcp;
+            return;
         }
     }
 }
@@ -639,7 +642,7 @@ void lexScanTickedIdent(char *srcp) {
 // Skip over nested block comment
 char *lexBlockComment(char *srcp) {
     int nest = 1;
-    while (*srcp) {
+    while (*(srcp = lexScanBlockComment(srcp))) {
         if (*srcp == '*' && *(srcp + 1) == '/') {
             if (--nest == 0)
                 return srcp+2;
@@ -651,8 +654,9 @@ char *lexBlockComment(char *srcp) {
         }
         // ignore tokens inside line comment
         else if (*srcp == '/' && *(srcp + 1) == '/') {
-            srcp += 2;
-            while (*srcp && *srcp++ != '\n');
+            srcp = lexScanLineComment(srcp + 2);
+            if (*srcp == '\n')
+                ++srcp;
         }
         // ignore tokens inside string literal
         else if (*srcp == '"') {
@@ -898,9 +902,7 @@ void lexNextTokenx() {
         case '/':
             // Line comment: '//'
             if (*(srcp+1)=='/') {
-                srcp += 2;
-                while (*srcp && *srcp!='\n' && *srcp!='\x1a')
-                    srcp++;
+                srcp = lexScanLineComment(srcp + 2);
             }
             // Block comment, nested: '/*'
             else if (*(srcp + 1) == '*') {
@@ -916,7 +918,7 @@ void lexNextTokenx() {
 
         // Ignore white space
         case ' ': case '\t':
-            srcp++;
+            srcp = lexScanRun(srcp, *srcp);
             break;
 
         // Ignore carriage return
@@ -12,6 +12,7 @@ typedef struct INode INode;    // ../ast/ast.h
 typedef struct Name Name;    // ../ast/nametbl.h
 
 #include "../coneopts.h"
+#include "../shared/thread.h"
 #include <stdint.h>
 
 #define LEX_MAX_BLOCKS 1024
@@ -151,6 +152,8 @@ enum TokenTypes {
     UnionToken,    // 'union'
     MoveToken,     // '@move'
     OpaqueToken,   // '@opaque'
+    MultiversionToken, // '@multiversion'
+    NonNullToken,  // '@nonnull'
     ExtendsToken,  // 'extends'
     MixinToken,    // 'mixin'
     EnumToken,     // 'enum'
@@ -181,14 +184,15 @@ enum TokenTypes {
     NbrTokens
 };
 
-// Current lexer
-extern Lexer *lex;
+// Current lexer (each parsing thread has its own)
+extern threadlocal Lexer *lex;
 
 #define lexIsToken(tok) (lex->toktype == (tok))
 
 // Lexer functions
 void lexInit(ConeOptions *opt);
 void lexInjectFile(char *url);
+void lexInjectFileFrom(char *fromurl, char *url);
 void lexInject(char *src, char *url);
 void lexPop();
 void lexNextToken();
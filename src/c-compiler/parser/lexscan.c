@@ -0,0 +1,157 @@
+/** Fast scanning of character runs in source text
+ * @file
+ *
+ * Most of the lexer's time goes into walking over runs of similar characters:
+ * identifiers, indentation, string literals and comments. When SSE2 is available,
+ * these runs are scanned 16 bytes at a time. Otherwise, a byte at a time.
+ *
+ * Every vector load is of an aligned 16 byte block. Such a block never crosses
+ * a page boundary, so a load of the block holding a source's final '\0' is safe,
+ * even when it reads some bytes after the '\0'. Every scan stops at '\0'.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "lexscan.h"
+
+#include <stdint.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LEXSCAN_SSE2
+#include <emmintrin.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+static int lexScanCtz(unsigned mask) {
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+}
+#else
+#define lexScanCtz(mask) __builtin_ctz(mask)
+#endif
+
+// Reading the rest of an aligned block past the '\0' is safe, but address sanitizers object
+#if defined(__clang__) || defined(__GNUC__)
+#define lexScanNoSanitize __attribute__((no_sanitize_address))
+#else
+#define lexScanNoSanitize
+#endif
+
+// Scan aligned blocks from srcp, until one has a byte whose bit is set in stopmask(block).
+// Bits for the bytes before srcp in the first block are ignored.
+#define lexScanBlocks(srcp, stopmask) { \
+    uintptr_t offset = (uintptr_t)(srcp) & 15; \
+    const __m128i *blockp = (const __m128i *)((srcp) - offset); \
+    unsigned mask = stopmask(_mm_load_si128(blockp)) & (0xffffu << offset); \
+    while (mask == 0) \
+        mask = stopmask(_mm_load_si128(++blockp)); \
+    return (char *)blockp + lexScanCtz(mask); \
+}
+
+// Mark bytes that are not ASCII letters, digits or underscores
+static inline unsigned lexScanNotIdentMask(__m128i block) {
+    __m128i lower = _mm_or_si128(block, _mm_set1_epi8(0x20));
+    __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(block, _mm_set1_epi8('9' + 1)));
+    __m128i under = _mm_cmpeq_epi8(block, _mm_set1_epi8('_'));
+    return ~(unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(letter, digit), under)) & 0xffff;
+}
+
+// Mark bytes that end a string literal's plain bytes: '"', '\', or a control character
+static inline unsigned lexScanStringStopMask(__m128i block) {
+    __m128i ctrl = _mm_cmpeq_epi8(_mm_min_epu8(block, _mm_set1_epi8(0x1f)), block);
+    __m128i quote = _mm_cmpeq_epi8(block, _mm_set1_epi8('"'));
+    __m128i bslash = _mm_cmpeq_epi8(block, _mm_set1_epi8('\\'));
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(ctrl, _mm_or_si128(quote, bslash)));
+}
+
+// Mark bytes that end a line comment: '\n', '\0' or '\x1a'
+static inline unsigned lexScanLineStopMask(__m128i block) {
+    __m128i nl = _mm_cmpeq_epi8(block, _mm_set1_epi8('\n'));
+    __m128i nul = _mm_cmpeq_epi8(block, _mm_setzero_si128());
+    __m128i eof = _mm_cmpeq_epi8(block, _mm_set1_epi8('\x1a'));
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(nl, _mm_or_si128(nul, eof)));
+}
+
+// Mark bytes a block comment must look at: '*', '/', '"' or '\0'
+static inline unsigned lexScanBlockStopMask(__m128i block) {
+    __m128i star = _mm_cmpeq_epi8(block, _mm_set1_epi8('*'));
+    __m128i slash = _mm_cmpeq_epi8(block, _mm_set1_epi8('/'));
+    __m128i quote = _mm_cmpeq_epi8(block, _mm_set1_epi8('"'));
+    __m128i nul = _mm_cmpeq_epi8(block, _mm_setzero_si128());
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(star, slash), _mm_or_si128(quote, nul)));
+}
+
+// Skip over ASCII letters, digits and underscores
+lexScanNoSanitize char *lexScanIdentChars(char *srcp) {
+    lexScanBlocks(srcp, lexScanNotIdentMask);
+}
+
+// Skip over a run of the character ch (e.g., spaces)
+lexScanNoSanitize char *lexScanRun(char *srcp, char ch) {
+    if (ch == '\0')
+        return srcp;
+    __m128i chs = _mm_set1_epi8(ch);
+#define lexScanNotChMask(block) (~(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(block, chs)) & 0xffff)
+    lexScanBlocks(srcp, lexScanNotChMask);
+#undef lexScanNotChMask
+}
+
+// Skip over a string literal's plain bytes, stopping at '"', '\', or any control character (including '\0')
+lexScanNoSanitize char *lexScanStringChars(char *srcp) {
+    lexScanBlocks(srcp, lexScanStringStopMask);
+}
+
+// Skip over a line comment's text, stopping at '\n', '\0' or '\x1a'
+lexScanNoSanitize char *lexScanLineComment(char *srcp) {
+    lexScanBlocks(srcp, lexScanLineStopMask);
+}
+
+// Skip over a block comment's text, stopping at '*', '/', '"' or '\0'
+lexScanNoSanitize char *lexScanBlockComment(char *srcp) {
+    lexScanBlocks(srcp, lexScanBlockStopMask);
+}
+
+#else
+
+// Skip over ASCII letters, digits and underscores
+char *lexScanIdentChars(char *srcp) {
+    while ((*srcp >= 'a' && *srcp <= 'z') || (*srcp >= 'A' && *srcp <= 'Z')
+        || (*srcp >= '0' && *srcp <= '9') || *srcp == '_')
+        ++srcp;
+    return srcp;
+}
+
+// Skip over a run of the character ch (e.g., spaces)
+char *lexScanRun(char *srcp, char ch) {
+    if (ch == '\0')
+        return srcp;
+    while (*srcp == ch)
+        ++srcp;
+    return srcp;
+}
+
+// Skip over a string literal's plain bytes, stopping at '"', '\', or any control character (including '\0')
+char *lexScanStringChars(char *srcp) {
+    while ((unsigned char)*srcp >= ' ' && *srcp != '"' && *srcp != '\\')
+        ++srcp;
+    return srcp;
+}
+
+// Skip over a line comment's text, stopping at '\n', '\0' or '\x1a'
+char *lexScanLineComment(char *srcp) {
+    while (*srcp && *srcp != '\n' && *srcp != '\x1a')
+        ++srcp;
+    return srcp;
+}
+
+// Skip over a block comment's text, stopping at '*', '/', '"' or '\0'
+char *lexScanBlockComment(char *srcp) {
+    while (*srcp && *srcp != '*' && *srcp != '/' && *srcp != '"')
+        ++srcp;
+    return srcp;
+}
+
+#endif
@@ -0,0 +1,26 @@
+/** Fast scanning of character runs in source text
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#ifndef lexscan_h
+#define lexscan_h
+
+// Skip over ASCII letters, digits and underscores
+char *lexScanIdentChars(char *srcp);
+
+// Skip over a run of the character ch (e.g., spaces)
+char *lexScanRun(char *srcp, char ch);
+
+// Skip over a string literal's plain bytes, stopping at '"', '\', or any control character (including '\0')
+char *lexScanStringChars(char *srcp);
+
+// Skip over a line comment's text, stopping at '\n', '\0' or '\x1a'
+char *lexScanLineComment(char *srcp);
+
+// Skip over a block comment's text, stopping at '*', '/', '"' or '\0'
+char *lexScanBlockComment(char *srcp);
+
+#endif
@@ -0,0 +1,235 @@
+/** Concurrent parsing of modules
+ * @file
+ *
+ * Every imported module is parsed as a separate job, so that worker threads can
+ * parse independent modules at the same time. While that happens, imports are only
+ * recorded. Once all jobs are done, imported modules are added to the program and
+ * bound to their import nodes in the same order that a serial parse would use,
+ * so the resulting program is identical, no matter how the threads were scheduled.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "parser.h"
+#include "../ir/ir.h"
+#include "../shared/memory.h"
+#include "../shared/fileio.h"
+#include "../shared/timer.h"
+#include "../shared/thread.h"
+#include "lexer.h"
+
+#include <string.h>
+
+// An import statement found while parsing some module
+typedef struct ParseJobImport {
+    struct ParseJobImport *next;
+    ImportNode *importnode;     // The import node, whose module is bound later
+    Name *modname;              // Name of the imported module
+    char *fromurl;              // Url of the importing source file
+    char *filename;             // Imported filename, as specified
+} ParseJobImport;
+
+// A module to be parsed by some thread
+struct ParseJob {
+    ParseJob *next;             // Next job in queue
+    ParseJob *allnext;          // Next job in list of all jobs
+    Name *modname;              // Name of the module
+    char *fromurl;              // Url of the source file that first asked for the module
+    char *filename;             // Filename of the module, as specified by the import
+    ModuleNode *mod;            // The parsed module (not yet added to the program)
+    ParseJobImport *imports;    // Imports found in the module, in source order
+    ParseJobImport *importlast;
+};
+
+// The job queue shared by all parsing threads
+struct ParseJobs {
+    ProgramNode *pgm;           // Program node
+    ModuleNode *pgmmod;         // Root module for program
+    ParseJob *all;              // All jobs ever created
+    ParseJob *head;             // Queue of jobs waiting to be parsed
+    ParseJob *tail;
+    int pending;                // Jobs queued or still being parsed
+    Mutex mutex;
+    CondVar cond;
+};
+
+// Create a new job for module modname
+static ParseJob *parseJobNew(Name *modname, char *fromurl, char *filename) {
+    ParseJob *job = (ParseJob*)memAllocBlk(sizeof(ParseJob));
+    job->next = job->allnext = NULL;
+    job->modname = modname;
+    job->fromurl = fromurl;
+    job->filename = filename;
+    job->mod = newModuleNode();
+    job->imports = job->importlast = NULL;
+    return job;
+}
+
+// Register an import found while parsing concurrently. Its module is bound after all parsing is done.
+// The first import of a not-yet-known module queues a job to parse it.
+void parseJobImport(ParseState *parse, ImportNode *importnode, char *filename, Name *modname) {
+    ParseJobs *jobs = parse->jobs;
+    ParseJob *job = parse->job;
+
+    // Remember the import, so it can be bound in source order later
+    ParseJobImport *import = (ParseJobImport*)memAllocBlk(sizeof(ParseJobImport));
+    import->next = NULL;
+    import->importnode = importnode;
+    import->modname = modname;
+    import->fromurl = lex->url;
+    import->filename = filename;
+    if (job->importlast)
+        job->importlast->next = import;
+    else
+        job->imports = import;
+    job->importlast = import;
+
+    // Modules parsed before concurrent parsing began (corelib) need no job
+    if (pgmFindMod(parse->pgm, modname))
+        return;
+
+    mutexLock(&jobs->mutex);
+    ParseJob *modjob;
+    for (modjob = jobs->all; modjob; modjob = modjob->allnext) {
+        if (modjob->modname == modname)
+            break;
+    }
+    if (modjob == NULL) {
+        modjob = parseJobNew(modname, import->fromurl, filename);
+        modjob->allnext = jobs->all;
+        jobs->all = modjob;
+        if (jobs->tail)
+            jobs->tail->next = modjob;
+        else
+            jobs->head = modjob;
+        jobs->tail = modjob;
+        ++jobs->pending;
+        condBroadcast(&jobs->cond);
+    }
+    mutexUnlock(&jobs->mutex);
+}
+
+// Parse the module for a job
+static void parseJobRun(ParseJobs *jobs, ParseJob *job) {
+    ParseState parse;
+    parse.pgm = jobs->pgm;
+    parse.pgmmod = jobs->pgmmod;
+    parse.mod = NULL;
+    parse.typenode = NULL;
+    parse.gennamePrefix = "";
+    parse.jobs = jobs;
+    parse.job = job;
+    parseModuleSrc(&parse, job->mod, job->fromurl, job->filename, job->modname);
+}
+
+// Mark a job as done, waking up all threads when no more work can show up
+static void parseJobDone(ParseJobs *jobs) {
+    if (--jobs->pending == 0)
+        condBroadcast(&jobs->cond);
+}
+
+// Parse queued jobs until there is no more work. Called with mutex unlocked.
+static void parseJobsWork(ParseJobs *jobs) {
+    mutexLock(&jobs->mutex);
+    while (1) {
+        while (jobs->head == NULL && jobs->pending > 0)
+            condWait(&jobs->cond, &jobs->mutex);
+        ParseJob *job = jobs->head;
+        if (job == NULL)
+            break;
+        if ((jobs->head = job->next) == NULL)
+            jobs->tail = NULL;
+        mutexUnlock(&jobs->mutex);
+
+        parseJobRun(jobs, job);
+
+        mutexLock(&jobs->mutex);
+        parseJobDone(jobs);
+    }
+    mutexUnlock(&jobs->mutex);
+}
+
+// Entry point for a worker thread
+static void parseJobsWorker(void *arg) {
+    timerWorkerThread();
+    parseJobsWork((ParseJobs*)arg);
+    memThreadEnd();
+}
+
+// Would the import load the same source file that the job did?
+static int parseJobSameSrc(ParseJob *job, ParseJobImport *import) {
+    if (strcmp(job->filename, import->filename) == 0 && strcmp(job->filename, "stdio") == 0)
+        return 1;
+    return strcmp(fileSrcUrl(job->fromurl, job->filename, 0), fileSrcUrl(import->fromurl, import->filename, 0)) == 0;
+}
+
+// Add imported modules to the program and bind them to their importers,
+// walking imports depth-first in source order, just as a serial parse would.
+static void parseJobsMerge(ParseState *parse, ParseJobs *jobs, ParseJob *job) {
+    ParseJobImport *import;
+    for (import = job->imports; import; import = import->next) {
+        ModuleNode *mod = pgmFindMod(parse->pgm, import->modname);
+        if (mod == NULL) {
+            ParseJob *modjob = jobs->all;
+            while (modjob->modname != import->modname)
+                modjob = modjob->allnext;
+            if (parseJobSameSrc(modjob, import)) {
+                mod = modjob->mod;
+                nodesAdd(&parse->pgm->modules, (INode*)mod);
+                parseJobsMerge(parse, jobs, modjob);
+            }
+            else {
+                // A different importer got to this module name first, and it resolves
+                // to another file than a serial parse would have used. Parse that serially.
+                ModuleNode *svmod = parse->mod;
+                parse->mod = NULL;
+                mod = pgmAddMod(parse->pgm);
+                parseModuleSrc(parse, mod, import->fromurl, import->filename, import->modname);
+                parse->mod = svmod;
+            }
+        }
+        modAddNamedNodeUnhooked(job->mod, import->modname, (INode*)mod);
+        import->importnode->module = mod;
+    }
+}
+
+// Parse the main module and all the modules it imports, using several threads
+void parseJobsPgm(ParseState *parse, int nthreads) {
+    ParseJobs jobs;
+    jobs.pgm = parse->pgm;
+    jobs.pgmmod = parse->pgmmod;
+    jobs.all = jobs.head = jobs.tail = NULL;
+    jobs.pending = 1;   // The main module
+    mutexInit(&jobs.mutex);
+    condInit(&jobs.cond);
+
+    // The main module is a job, parsed by this thread, that only imports are recorded for
+    ParseJob mainjob;
+    memset(&mainjob, 0, sizeof(mainjob));
+    mainjob.mod = parse->pgmmod;
+
+    threadShareBegin();
+    parse->jobs = &jobs;
+    parse->job = &mainjob;
+
+    Thread *threads = (Thread*)memAllocBlk(nthreads * sizeof(Thread));
+    int started = 0;
+    while (started < nthreads - 1 && threadStart(&threads[started], parseJobsWorker, &jobs))
+        ++started;
+
+    parseModuleBlk(parse, parse->pgmmod);
+    mutexLock(&jobs.mutex);
+    parseJobDone(&jobs);
+    mutexUnlock(&jobs.mutex);
+
+    // Help with the remaining jobs, then wait for the workers to finish theirs
+    parseJobsWork(&jobs);
+    while (started)
+        threadJoin(threads[--started]);
+    threadShareEnd();
+
+    parse->jobs = NULL;
+    parse->job = NULL;
+    parseJobsMerge(parse, &jobs, &mainjob);
+}
@@ -12,6 +12,8 @@
 #include "../shared/memory.h"
 #include "../shared/error.h"
 #include "../shared/fileio.h"
+#include "../shared/thread.h"
+#include "../shared/timetrace.h"
 #include "../ir/nametbl.h"
 #include "../coneopts.h"
 #include "lexer.h"
@@ -132,6 +134,16 @@ INode *parseFn(ParseState *parse, uint16_t mayflags) {
     // Skip past the 'fn'.
     lexNextToken();
 
+    // Handle attributes
+    if (lex->toktype == MultiversionToken) {
+        fnnode->flags |= FlagMultiversion;
+        lexNextToken();
+    }
+    else if (lex->toktype == NonNullToken) {
+        fnnode->flags |= FlagNonNull;
+        lexNextToken();
+    }
+
     // Process function name, if provided
     if (lexIsToken(IdentToken)) {
         if (!(mayflags&ParseMayName))
@@ -224,14 +236,9 @@ char *stdiolib =
 "mut print = IOStream[0]"
 ;
 
-// Parse imported module
-ModuleNode *parseImportModule(ParseState *parse, char *filename, Name *modname) {
-    // If we already have module, don't re-parse. Just return it.
-    ModuleNode *newmod = pgmFindMod(parse->pgm, modname);
-    if (newmod)
-        return newmod;
-
-    // Let's load and parse the module
+// Load and parse a module's source, relative to fromurl, into newmod
+void parseModuleSrc(ParseState *parse, ModuleNode *newmod, char *fromurl, char *filename, Name *modname) {
+    timeTraceBegin("Parse module", &modname->namestr);
     char *svprefix = parse->gennamePrefix;
     ModuleNode *svmod = parse->mod;
     nameNewPrefix(&parse->gennamePrefix, &modname->namestr);
@@ -241,8 +248,7 @@ ModuleNode *parseImportModule(ParseState *parse, char *filename, Name *modname)
     else if (strcmp(filename, "stdio") == 0)
         lexInject(stdiolib, "stdio");
     else
-        lexInjectFile(filename);
-    newmod = pgmAddMod(parse->pgm);
+        lexInjectFileFrom(fromurl, filename);
     newmod->namesym = modname;
     parse->mod = newmod;
 
@@ -265,6 +271,19 @@ ModuleNode *parseImportModule(ParseState *parse, char *filename, Name *modname)
 
     parse->mod = svmod;
     parse->gennamePrefix = svprefix;
+    timeTraceEnd();
+}
+
+// Parse imported module
+ModuleNode *parseImportModule(ParseState *parse, char *filename, Name *modname) {
+    // If we already have module, don't re-parse. Just return it.
+    ModuleNode *newmod = pgmFindMod(parse->pgm, modname);
+    if (newmod)
+        return newmod;
+
+    // Let's load and parse the module
+    newmod = pgmAddMod(parse->pgm);
+    parseModuleSrc(parse, newmod, lex? lex->url : NULL, filename, modname);
     return newmod;
 }
 
@@ -285,6 +304,12 @@ ImportNode *parseImport(ParseState *parse) {
     }
     parseEndOfStatement();
 
+    // When parsing concurrently, the imported module is parsed and bound later
+    if (parse->jobs) {
+        parseJobImport(parse, importnode, filename, modname);
+        return importnode;
+    }
+
     // Parse the imported modules
     ModuleNode *newmod = parseImportModule(parse, filename, modname);
 
@@ -470,12 +495,13 @@ ModuleNode *parseModuleBlk(ParseState *parse, ModuleNode *mod) {
 }
 
 // Parse a program = the main module
+// With opt->jobs > 1, the main module and its imports are parsed by that many threads
 ProgramNode *parsePgm(ConeOptions *opt) {
     // Initialize name table and lexer
     nametblInit();
     typetblInit();
     lexInit(opt);
-    stdlibInit(opt->ptrsize);
+    stdlibInit(opt->ptrsize, opt->libc_alloc);
 
     ProgramNode *pgm = newProgramNode();
 
@@ -485,6 +511,8 @@ ProgramNode *parsePgm(ConeOptions *opt) {
     parse.mod = NULL;
     parse.typenode = NULL;
     parse.gennamePrefix = "";
+    parse.jobs = NULL;
+    parse.job = NULL;
 
     // Create module node and set up for parsing main source file
     ModuleNode *pgmmod = pgmAddMod(pgm);
@@ -500,7 +528,13 @@ ProgramNode *parsePgm(ConeOptions *opt) {
     modAddNode(pgmmod, NULL, (INode*)importnode);
 
     // Now actually parse main source file
-    parseModuleBlk(&parse, pgmmod);
+    timeTraceBegin("Parse module", opt->srcname);
+    int jobs = opt->jobs > 0 ? opt->jobs : threadCpuCount();
+    if (jobs > 1)
+        parseJobsPgm(&parse, jobs);
+    else
+        parseModuleBlk(&parse, pgmmod);
     modHook(pgmmod, NULL);
+    timeTraceEnd();
     return pgm;
 }
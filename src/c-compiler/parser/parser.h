@@ -10,6 +10,8 @@
 
 #include "../ir/ir.h"
 typedef struct ConeOptions ConeOptions;
+typedef struct ParseJobs ParseJobs;
+typedef struct ParseJob ParseJob;
 
 typedef struct ParseState {
     ProgramNode *pgm;       // Program node
@@ -17,6 +19,8 @@ typedef struct ParseState {
     ModuleNode *mod;        // Current module
     INsTypeNode *typenode;  // Current type
     char *gennamePrefix;    // Module or type prefix for unique linker names
+    ParseJobs *jobs;        // Concurrent module parsing (NULL when parsing serially)
+    ParseJob *job;          // The module job being parsed (when concurrent)
 } ParseState;
 
 // When parsing a variable definition, what syntax is allowed?
@@ -32,6 +36,8 @@ enum ParseFlags {
 // parser.c
 ProgramNode *parsePgm(ConeOptions *opt);
 ModuleNode *parseModuleBlk(ParseState *parse, ModuleNode *mod);
+// Load and parse a module's source, relative to fromurl, into newmod
+void parseModuleSrc(ParseState *parse, ModuleNode *newmod, char *fromurl, char *filename, Name *modname);
 INode *parseFn(ParseState *parse, uint16_t mayflags);
 // Skip to next statement for error recovery
 void parseSkipToNextStmt();
@@ -51,6 +57,12 @@ Nodes *parseGenericParms(ParseState *parse);
 // Expect closing token (e.g., right parenthesis). If not found, search for it or '}' or ';'
 void parseCloseTok(uint16_t closetok);
 
+// parsejob.c
+// Parse the main module and all the modules it imports, using several threads
+void parseJobsPgm(ParseState *parse, int nthreads);
+// Register an import found while parsing concurrently. Its module is bound after all parsing is done.
+void parseJobImport(ParseState *parse, ImportNode *importnode, char *filename, Name *modname);
+
 // parseflow.c
 INode *parseIf(ParseState *parse);
 INode *parseMatch(ParseState *parse);
@@ -0,0 +1,130 @@
+/** On-disk cache of generated files
+ * @file
+ *
+ * Files are named by a key chosen by the caller, such as code generation's
+ * object files, keyed by the LLVM IR they were made from.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "cache.h"
+#include "memory.h"
+#include "fileio.h"
+#include "thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+#include <direct.h>
+#define cacheMkdir(dir) _mkdir(dir)
+#else
+#include <unistd.h>
+#define cacheMkdir(dir) mkdir(dir, 0777)
+#endif
+
+static char *cacheDir = NULL;
+static int cacheHits = 0;
+static int cacheMisses = 0;
+
+// Fold some data into a (64-bit FNV-1a) content hash
+uint64_t cacheHash(uint64_t hash, const void *data, size_t len) {
+    const unsigned char *datap = (const unsigned char *)data;
+    while (len--) {
+        hash ^= *datap++;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// Build the path for a cache file
+static char *cachePath(uint64_t hash, char *ext) {
+    char name[17];
+    sprintf(name, "%016llx", (unsigned long long)hash);
+    return fileMakePath(cacheDir, name, ext);
+}
+
+// Read a whole (binary) file into a malloc'ed buffer. Return NULL if not found.
+static char *cacheReadFile(char *path, size_t *size) {
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    long filesize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *data = (char*)malloc(filesize > 0 ? filesize : 1);
+    if (data == NULL || fread(data, 1, filesize, file) != (size_t)filesize) {
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+    *size = (size_t)filesize;
+    return data;
+}
+
+// Write a whole file, via a temporary file, so no one sees a partial one.
+// Return 0 on failure.
+static int cacheWriteFile(char *path, char *data, size_t size) {
+    char *tmppath = memAllocStr(path, strlen(path) + 4);
+    strcat(tmppath, ".tmp");
+    FILE *file = fopen(tmppath, "wb");
+    if (!file)
+        return 0;
+    int ok = fwrite(data, 1, size, file) == size;
+    ok = fclose(file) == 0 && ok;
+    remove(path);
+    if (!ok || rename(tmppath, path) != 0) {
+        remove(tmppath);
+        return 0;
+    }
+    return 1;
+}
+
+// Use dir as the cache for this compile
+void cacheInit(char *dir) {
+    cacheDir = dir;
+    cacheMkdir(dir);
+}
+
+// Is the cache in use?
+int cacheEnabled() {
+    return cacheDir != NULL;
+}
+
+// Copy the cached file named by key and ext to path. Return 0 if not cached.
+int cacheFetch(uint64_t key, char *ext, char *path) {
+    size_t size;
+    char *data = cacheReadFile(cachePath(key, ext), &size);
+    int ok = data && cacheWriteFile(path, data, size);
+    free(data);
+    return ok;
+}
+
+// Copy the file at path into the cache, named by key and ext
+void cacheKeep(uint64_t key, char *ext, char *path) {
+    size_t size;
+    char *data = cacheReadFile(path, &size);
+    if (data)
+        cacheWriteFile(cachePath(key, ext), data, size);
+    free(data);
+}
+
+// Count a lookup of cached files, which either found them all or not
+void cacheCount(int hit) {
+    threadSharedLock();
+    if (hit)
+        ++cacheHits;
+    else
+        ++cacheMisses;
+    threadSharedUnlock();
+}
+
+// Print how often cached files were found
+void cachePrint() {
+    printf("Code cache: %d hits, %d misses\n\n", cacheHits, cacheMisses);
+}
@@ -0,0 +1,38 @@
+/** On-disk cache of generated files
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#ifndef cache_h
+#define cache_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Starting value for a content hash
+#define CacheHashInit 0xcbf29ce484222325ull
+
+// Fold some data into a (64-bit FNV-1a) content hash
+uint64_t cacheHash(uint64_t hash, const void *data, size_t len);
+
+// Use dir as the cache for this compile
+void cacheInit(char *dir);
+
+// Is the cache in use?
+int cacheEnabled();
+
+// Copy the cached file named by key and ext to path. Return 0 if not cached.
+int cacheFetch(uint64_t key, char *ext, char *path);
+
+// Copy the file at path into the cache, named by key and ext
+void cacheKeep(uint64_t key, char *ext, char *path);
+
+// Count a lookup of cached files, which either found them all or not
+void cacheCount(int hit);
+
+// Print how often cached files were found
+void cachePrint();
+
+#endif
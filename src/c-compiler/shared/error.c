@@ -7,6 +7,7 @@
 
 #include "error.h"
 #include "timer.h"
+#include "thread.h"
 #include "../parser/lexer.h"
 #include "../ir/ir.h"
 
@@ -55,7 +56,8 @@ void errorOutCode(char *tokp, uint32_t linenbr, char *linep, char *url, int code
     char *srcp;
     int pos, spaces;
 
-    // Send out the error message and count
+    // Send out the error message and count (kept whole if threads are sharing stderr)
+    threadSharedLock();
     errorOut(code, msg, args);
 
     // Reflect the source code line
@@ -73,6 +75,7 @@ void errorOutCode(char *tokp, uint32_t linenbr, char *linep, char *url, int code
         fputc(*srcp++ == '\t'? '\t' : ' ', stderr);
     }
     fprintf(stderr, "^--- %s:%d:%d\n", url, linenbr, pos);
+    threadSharedUnlock();
 }
 
 // Send an error message to stderr
@@ -97,7 +100,9 @@ void errorMsgLex(int code, const char *msg, ...) {
 void errorMsg(int code, const char *msg, ...) {
     va_list argptr;
     va_start(argptr, msg);
+    threadSharedLock();
     errorOut(code, msg, argptr);
+    threadSharedUnlock();
     va_end(argptr);
 }
 
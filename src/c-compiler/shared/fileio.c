@@ -14,7 +14,38 @@
 
 char **fileSearchPaths = NULL;
 
-/** Load a file into an allocated string, return pointer or NULL if not found */
+// Files at least this large are mapped into memory rather than copied
+#define FileMapMin 0x10000
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+#define fileMap(file, filesize) NULL
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Map an open file's contents (privately) into memory, followed by at least one '\0'.
+// The map is never unmapped, as the source it holds is used until the compiler ends.
+// Return NULL if the file cannot be mapped.
+static char *fileMap(FILE *file, size_t filesize) {
+    size_t pagesize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t mapsize = (filesize + pagesize) & ~(pagesize - 1);
+
+    // Reserve zeroed pages for the contents and the sentinel, then map the file over them
+    char *reserve = (char*)mmap(NULL, mapsize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserve == MAP_FAILED)
+        return NULL;
+    char *filestr = (char*)mmap(reserve, filesize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fileno(file), 0);
+    if (filestr == MAP_FAILED) {
+        munmap(reserve, mapsize);
+        return NULL;
+    }
+    return filestr;
+}
+#endif
+
+/** Load a file into an allocated string, return pointer or NULL if not found.
+ * Large files are mapped rather than copied, avoiding a second copy of their contents.
+ * Either way, the string ends with '\0', and may be written to (but not freed). */
 char *fileLoad(char *fn) {
     FILE *file;
     size_t filesize;
@@ -29,6 +60,12 @@ char *fileLoad(char *fn) {
     filesize=ftell(file);
     fseek(file, 0, SEEK_SET);
 
+    // Map large files straight into memory
+    if (filesize >= FileMapMin && (filestr = fileMap(file, filesize))) {
+        fclose(file);
+        return filestr;
+    }
+
     // Load the data into an allocated string buffer and close file
     filestr = memAllocStr(NULL, filesize);
     fread(filestr, 1, filesize, file);
@@ -8,14 +8,20 @@
 #ifndef fileio_h
 #define fileio_h
 
+#include <stddef.h>
+
 extern char **fileSearchPaths;
 
-// Load a file into an allocated string, return pointer or NULL if not found
+// Load a file into an allocated string, return pointer or NULL if not found.
+// Large files are mapped into memory rather than copied.
 char *fileLoad(char *fn);
 
 // Extract a filename only (no extension) from a path
 char *fileName(char *fn);
 
+// Get number of characters in string up to file name
+size_t fileFolder(char *fn);
+
 // Concatenate folder, filename and extension into a path
 char *fileMakePath(char *dir, char *srcfn, char *ext);
 
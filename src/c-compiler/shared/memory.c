@@ -4,6 +4,7 @@
  * The compiler's memory management is deliberately leaky for high performance.
  * Allocation is done via bump pointer within very large arenas allocated from the heap
  * Nothing is ever freed.
+ * Each thread bump-allocates from its own arenas, so worker threads need no locking.
  *
  * This source file is part of the Cone Programming Language C compiler
  * See Copyright Notice in conec.h
@@ -11,6 +12,7 @@
 
 #include "memory.h"
 #include "error.h"
+#include "thread.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -21,13 +23,14 @@
 size_t gMemBlkArenaSize = 256 * 4096;
 size_t gMemStrArenaSize = 128 * 4096;
 
-// Private globals: memory allocation arena bookkeeping
-static void *gMemBlkArenaPos = NULL;
-static size_t gMemBlkArenaLeft = 0;
-static void *gMemStrArenaPos = NULL;
-static size_t gMemStrArenaLeft = 0;
+// Private per-thread globals: memory allocation arena bookkeeping
+static threadlocal void *gMemBlkArenaPos = NULL;
+static threadlocal size_t gMemBlkArenaLeft = 0;
+static threadlocal void *gMemStrArenaPos = NULL;
+static threadlocal size_t gMemStrArenaLeft = 0;
 
-static size_t memAllocated = 0;
+static threadlocal size_t memAllocated = 0;
+static size_t memRetired = 0;    // Memory used by threads that have finished
 
 /** Allocate memory for a block, aligned to a 16-byte boundary */
 void *memAllocBlk(size_t size) {
@@ -106,8 +109,16 @@ char *memAllocStr(char *str, size_t size) {
     return (char*) strp;
 }
 
+// Fold the calling worker thread's memory use into the total, as the thread finishes.
+// Its arenas remain allocated, as their contents are still in use.
+void memThreadEnd() {
+    threadSharedLock();
+    memRetired += memAllocated - gMemBlkArenaLeft - gMemStrArenaLeft;
+    threadSharedUnlock();
+}
+
 size_t nametblUnused();
 // Return how much memory actually needed for use
 size_t memUsed() {
-    return memAllocated - gMemBlkArenaLeft - gMemStrArenaLeft - nametblUnused();
+    return memAllocated + memRetired - gMemBlkArenaLeft - gMemStrArenaLeft - nametblUnused();
 }
@@ -22,6 +22,9 @@ void *memAllocBlk(size_t size);
 // Allocates extra byte for string-ending 0, appending it to copied string
 char *memAllocStr(char *str, size_t size);
 
+// Fold the calling worker thread's memory use into the total, as the thread finishes
+void memThreadEnd();
+
 // Return memory allocated and used
 size_t memUsed();
 
@@ -0,0 +1,156 @@
+/** Thread handling
+ * @file
+ *
+ * The compiler runs single-threaded, except when a stage explicitly hands
+ * independent work to worker threads (e.g., parsing modules concurrently).
+ * During such a stage, global state that workers must share (such as the
+ * name table) is protected by a single lock, taken only while sharing.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "thread.h"
+
+#include <stdlib.h>
+
+int threadShared = 0;
+static Mutex threadSharedMutex;
+
+// Bundle thread entry function and its argument, for use by the trampoline
+typedef struct {
+    void (*fn)(void *);
+    void *arg;
+} ThreadStart;
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+#include <Windows.h>
+
+static DWORD WINAPI threadTrampoline(LPVOID param) {
+    ThreadStart start = *(ThreadStart *)param;
+    free(param);
+    start.fn(start.arg);
+    return 0;
+}
+
+int threadStart(Thread *thread, void (*fn)(void *), void *arg) {
+    ThreadStart *start = (ThreadStart *)malloc(sizeof(ThreadStart));
+    start->fn = fn;
+    start->arg = arg;
+    *thread = (Thread)CreateThread(NULL, 0, threadTrampoline, start, 0, NULL);
+    if (*thread == NULL) {
+        free(start);
+        return 0;
+    }
+    return 1;
+}
+
+void threadJoin(Thread thread) {
+    WaitForSingleObject((HANDLE)thread, INFINITE);
+    CloseHandle((HANDLE)thread);
+}
+
+int threadCpuCount() {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+}
+
+void mutexInit(Mutex *mutex) {
+    InitializeSRWLock((PSRWLOCK)mutex);
+}
+void mutexLock(Mutex *mutex) {
+    AcquireSRWLockExclusive((PSRWLOCK)mutex);
+}
+void mutexUnlock(Mutex *mutex) {
+    ReleaseSRWLockExclusive((PSRWLOCK)mutex);
+}
+
+void condInit(CondVar *cond) {
+    InitializeConditionVariable((PCONDITION_VARIABLE)cond);
+}
+void condWait(CondVar *cond, Mutex *mutex) {
+    SleepConditionVariableSRW((PCONDITION_VARIABLE)cond, (PSRWLOCK)mutex, INFINITE, 0);
+}
+void condBroadcast(CondVar *cond) {
+    WakeAllConditionVariable((PCONDITION_VARIABLE)cond);
+}
+
+#else
+#include <unistd.h>
+
+static void *threadTrampoline(void *param) {
+    ThreadStart start = *(ThreadStart *)param;
+    free(param);
+    start.fn(start.arg);
+    return NULL;
+}
+
+int threadStart(Thread *thread, void (*fn)(void *), void *arg) {
+    ThreadStart *start = (ThreadStart *)malloc(sizeof(ThreadStart));
+    start->fn = fn;
+    start->arg = arg;
+    if (pthread_create(thread, NULL, threadTrampoline, start) != 0) {
+        free(start);
+        return 0;
+    }
+    return 1;
+}
+
+void threadJoin(Thread thread) {
+    pthread_join(thread, NULL);
+}
+
+int threadCpuCount() {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
+
+void mutexInit(Mutex *mutex) {
+    pthread_mutex_init(mutex, NULL);
+}
+void mutexLock(Mutex *mutex) {
+    pthread_mutex_lock(mutex);
+}
+void mutexUnlock(Mutex *mutex) {
+    pthread_mutex_unlock(mutex);
+}
+
+void condInit(CondVar *cond) {
+    pthread_cond_init(cond, NULL);
+}
+void condWait(CondVar *cond, Mutex *mutex) {
+    pthread_cond_wait(cond, mutex);
+}
+void condBroadcast(CondVar *cond) {
+    pthread_cond_broadcast(cond);
+}
+
+#endif
+
+// Begin a period when worker threads share the compiler's global state
+void threadShareBegin() {
+    static int initialized = 0;
+    if (!initialized) {
+        mutexInit(&threadSharedMutex);
+        initialized = 1;
+    }
+    threadShared = 1;
+}
+
+// End the sharing period (all worker threads must have finished)
+void threadShareEnd() {
+    threadShared = 0;
+}
+
+// Lock the global state (does nothing when threads are not sharing it)
+void threadSharedLock() {
+    if (threadShared)
+        mutexLock(&threadSharedMutex);
+}
+
+// Unlock the global state (does nothing when threads are not sharing it)
+void threadSharedUnlock() {
+    if (threadShared)
+        mutexUnlock(&threadSharedMutex);
+}
@@ -0,0 +1,52 @@
+/** Thread handling
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#ifndef thread_h
+#define thread_h
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+// Same layout as HANDLE, SRWLOCK and CONDITION_VARIABLE, without pulling in Windows.h
+#define threadlocal __declspec(thread)
+typedef void *Thread;
+typedef struct { void *ptr; } Mutex;
+typedef struct { void *ptr; } CondVar;
+#else
+#include <pthread.h>
+#define threadlocal __thread
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t CondVar;
+#endif
+
+// Nonzero while worker threads share the compiler's global state
+extern int threadShared;
+
+// Start a new thread running fn(arg). Return 0 on failure.
+int threadStart(Thread *thread, void (*fn)(void *), void *arg);
+// Wait for a thread to finish
+void threadJoin(Thread thread);
+// Return how many processors are available for worker threads
+int threadCpuCount();
+
+void mutexInit(Mutex *mutex);
+void mutexLock(Mutex *mutex);
+void mutexUnlock(Mutex *mutex);
+
+void condInit(CondVar *cond);
+// Release mutex and wait for cond to be signalled, then re-acquire mutex
+void condWait(CondVar *cond, Mutex *mutex);
+void condBroadcast(CondVar *cond);
+
+// Begin/end a period when worker threads share the compiler's global state
+void threadShareBegin();
+void threadShareEnd();
+
+// Lock/unlock the global state (does nothing when threads are not sharing it)
+void threadSharedLock();
+void threadSharedUnlock();
+
+#endif
@@ -8,7 +8,11 @@
 #include <stdint.h>
 #include <stdio.h>
 #include "timer.h"
+#include "thread.h"
 
+// The main thread's stages are timed. Worker threads do not contribute,
+// as the main thread's stage timer is already running while they work.
+static threadlocal int timerWorker = 0;
 size_t timerCurrent = TimerCount;
 uint64_t timerStamp = 0;
 uint64_t timers[TimerCount];
@@ -21,16 +25,20 @@ uint64_t timerGet() {
     return (uint64_t)captureTime.QuadPart;
 }
 uint64_t timerTick() {
-    LARGE_INTEGER captureFreq;
-    QueryPerformanceFrequency(&captureFreq);
-    return (uint64_t)captureFreq.QuadPart;
+    static uint64_t freq = 0;
+    if (freq == 0) {
+        LARGE_INTEGER captureFreq;
+        QueryPerformanceFrequency(&captureFreq);
+        freq = (uint64_t)captureFreq.QuadPart;
+    }
+    return freq;
 }
 #else
 #include <time.h>
 uint64_t timerGet() {
     struct timespec tp;
-    clock_gettime(CLOCK_REALTIME, &tp);
-    return (uint64_t)tp.tv_nsec;
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return (uint64_t)tp.tv_sec * 1000000000 + (uint64_t)tp.tv_nsec;
 }
 uint64_t timerTick() {
     return 1000000000;
@@ -38,6 +46,8 @@ uint64_t timerTick() {
 #endif
 
 void timerBegin(size_t aTimer) {
+    if (timerWorker)
+        return;
     uint64_t timer = timerGet();
     if (timerCurrent < TimerCount)
         timers[timerCurrent] += timer - timerStamp;
@@ -45,6 +55,11 @@ void timerBegin(size_t aTimer) {
     timerCurrent = aTimer;
 }
 
+// Stop the calling worker thread from affecting stage timers
+void timerWorkerThread() {
+    timerWorker = 1;
+}
+
 uint64_t timerGetTicks(size_t aTimer) {
     return timers[aTimer];
 }
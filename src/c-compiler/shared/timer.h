@@ -24,9 +24,18 @@ enum Timers {
     TimerCount
 };
 
+// Get the current time (in ticks) from a monotonic clock
+uint64_t timerGet();
+
+// Get the number of ticks per second
+uint64_t timerTick();
+
 // Start timing ticks for a specific timer
 void timerBegin(size_t aTimer);
 
+// Stop the calling worker thread from affecting stage timers
+void timerWorkerThread();
+
 // Get the tick count for a timer
 uint64_t timerGetTicks(size_t aTimer);
 
@@ -0,0 +1,166 @@
+/** Hierarchical tracing of compile times
+ * @file
+ *
+ * With --time-trace, every thread records when scopes (stages, modules,
+ * functions, LLVM passes, etc.) begin and end. Scopes nest within the
+ * thread's enclosing scope. At the end, all threads' scopes are written
+ * as "complete" events in Chrome's trace event format, which Chrome's
+ * trace viewer (about:tracing) and Perfetto can show as a flame chart.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include "timetrace.h"
+#include "timer.h"
+#include "memory.h"
+#include "thread.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define TimeTraceDepthMax 256
+
+// A traced scope
+typedef struct {
+    char *name;
+    char *detail;
+    uint64_t begin;
+    uint64_t end;
+} TimeTraceEvent;
+
+// Every thread's events, in the order scopes began
+typedef struct TimeTraceThread {
+    struct TimeTraceThread *next;
+    TimeTraceEvent *events;
+    uint32_t used;
+    uint32_t avail;
+    uint32_t depth;
+    uint32_t open[TimeTraceDepthMax];   // Indexes of events not yet ended
+    int tid;
+} TimeTraceThread;
+
+int timeTraceOn = 0;
+static char *timeTracePath;
+static uint64_t timeTraceStart;
+static TimeTraceThread *timeTraceThreads = NULL;
+static int timeTraceThreadCnt = 0;
+static threadlocal TimeTraceThread *timeTraceThread = NULL;
+
+// Start recording a trace of compile activity, to be written to path
+void timeTraceInit(char *path) {
+    timeTracePath = path;
+    timeTraceStart = timerGet();
+    timeTraceOn = 1;
+}
+
+// Get the calling thread's events, registering the thread on first use
+static TimeTraceThread *timeTraceGetThread() {
+    TimeTraceThread *thread = timeTraceThread;
+    if (thread)
+        return thread;
+    thread = (TimeTraceThread*)memAllocBlk(sizeof(TimeTraceThread));
+    thread->events = NULL;
+    thread->used = thread->avail = thread->depth = 0;
+    threadSharedLock();
+    thread->tid = ++timeTraceThreadCnt;
+    thread->next = timeTraceThreads;
+    timeTraceThreads = thread;
+    threadSharedUnlock();
+    return timeTraceThread = thread;
+}
+
+// Begin a traced scope on the calling thread, e.g., for a compiler stage.
+// detail (may be NULL) names what it works on, e.g., a module or function.
+void timeTraceBegin(char *name, char *detail) {
+    if (!timeTraceOn)
+        return;
+    TimeTraceThread *thread = timeTraceGetThread();
+    if (thread->used >= thread->avail) {
+        uint32_t avail = thread->avail ? thread->avail << 1 : 1024;
+        TimeTraceEvent *events = (TimeTraceEvent*)memAllocBlk(avail * sizeof(TimeTraceEvent));
+        if (thread->used)
+            memcpy(events, thread->events, thread->used * sizeof(TimeTraceEvent));
+        thread->events = events;
+        thread->avail = avail;
+    }
+    TimeTraceEvent *event = &thread->events[thread->used];
+    event->name = name;
+    event->detail = detail;
+    event->end = 0;
+    if (thread->depth < TimeTraceDepthMax)
+        thread->open[thread->depth] = thread->used;
+    ++thread->depth;
+    ++thread->used;
+    event->begin = timerGet();
+}
+
+// End the calling thread's innermost traced scope
+void timeTraceEnd() {
+    if (!timeTraceOn)
+        return;
+    uint64_t end = timerGet();
+    TimeTraceThread *thread = timeTraceThread;
+    if (thread == NULL || thread->depth == 0)
+        return;
+    if (--thread->depth < TimeTraceDepthMax)
+        thread->events[thread->open[thread->depth]].end = end;
+}
+
+// Write a string as a JSON string
+static void timeTraceWriteStr(FILE *file, char *str) {
+    fputc('"', file);
+    for (; *str; ++str) {
+        unsigned char ch = (unsigned char)*str;
+        if (ch == '"' || ch == '\\')
+            fprintf(file, "\\%c", ch);
+        else if (ch < ' ')
+            fprintf(file, "\\u%04x", ch);
+        else
+            fputc(ch, file);
+    }
+    fputc('"', file);
+}
+
+// Convert a timer value to microseconds since tracing began
+static double timeTraceMicrosecs(uint64_t time) {
+    return (double)(time - timeTraceStart) * 1000000.0 / timerTick();
+}
+
+// Write the recorded trace as JSON (Chrome's trace event format)
+void timeTraceWrite() {
+    if (!timeTraceOn)
+        return;
+    FILE *file = fopen(timeTracePath, "wb");
+    if (!file) {
+        fprintf(stderr, "Cannot write time trace to %s\n", timeTracePath);
+        return;
+    }
+    uint64_t now = timerGet();
+    fprintf(file, "{\"traceEvents\":[\n");
+    char *sep = "";
+    TimeTraceThread *thread;
+    for (thread = timeTraceThreads; thread; thread = thread->next) {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            sep, thread->tid, thread->tid == 1 ? "main" : "worker");
+        sep = ",\n";
+        uint32_t i;
+        for (i = 0; i < thread->used; ++i) {
+            TimeTraceEvent *event = &thread->events[i];
+            uint64_t end = event->end ? event->end : now;   // Scope never ended (e.g., on errors)
+            fprintf(file, "%s{\"name\":", sep);
+            timeTraceWriteStr(file, event->name);
+            fprintf(file, ",\"cat\":\"cone\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                thread->tid, timeTraceMicrosecs(event->begin), timeTraceMicrosecs(end) - timeTraceMicrosecs(event->begin));
+            if (event->detail) {
+                fprintf(file, ",\"args\":{\"detail\":");
+                timeTraceWriteStr(file, event->detail);
+                fputc('}', file);
+            }
+            fputc('}', file);
+        }
+    }
+    fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(file);
+}
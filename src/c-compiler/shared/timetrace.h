@@ -0,0 +1,27 @@
+/** Hierarchical tracing of compile times
+ * @file
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#ifndef timetrace_h
+#define timetrace_h
+
+// Is a trace being recorded?
+extern int timeTraceOn;
+
+// Start recording a trace of compile activity, to be written to path
+void timeTraceInit(char *path);
+
+// Begin a traced scope on the calling thread, e.g., for a compiler stage.
+// detail (may be NULL) names what it works on, e.g., a module or function.
+void timeTraceBegin(char *name, char *detail);
+
+// End the calling thread's innermost traced scope
+void timeTraceEnd();
+
+// Write the recorded trace as JSON (Chrome's trace event format)
+void timeTraceWrite();
+
+#endif
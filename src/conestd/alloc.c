@@ -0,0 +1,215 @@
+/** alloc - The runtime's memory allocator, used by the so and rc regions
+ * @file
+ *
+ * Allocations of up to ConeAllocMax bytes are rounded up to a size class
+ * (a multiple of ConeAlign). Each thread caches free blocks per size class,
+ * so most allocations and frees are a few loads and stores, with no lock.
+ * A thread's cache trades blocks with a central pool in batches of ConeBatch:
+ * it takes a batch when it runs dry, and gives one back when it holds too many.
+ * Only the central pool is locked, once per batch. A thread's cached blocks
+ * go back to the pool when it exits. Bigger allocations go to malloc.
+ *
+ * Generated code passes coneFree the allocation's size, so blocks need no header.
+ * Allocation aborts when out of memory, so it never returns null.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <intrin.h>
+#define ConeThreadLocal __declspec(thread)
+#define coneLock(lock) while (_InterlockedExchange(lock, 1)) {}
+#define coneUnlock(lock) _InterlockedExchange(lock, 0)
+#else
+#include <pthread.h>
+#define ConeThreadLocal _Thread_local
+#define coneLock(lock) while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE)) {}
+#define coneUnlock(lock) __atomic_store_n(lock, 0, __ATOMIC_RELEASE)
+#endif
+
+#define ConeAlign 16                // Every block is aligned (and sized) to this
+#define ConeAllocMax 1024           // Largest size served by size classes
+#define ConeClasses (ConeAllocMax / ConeAlign + 1)
+#define ConeBatch 32                // Blocks moved between a thread's cache and the central pool at once
+#define ConeChunkSize (64 * 1024)   // New blocks are carved from chunks this big
+
+// A free block. The first block of a batch in the central pool also links to the next batch.
+typedef struct ConeBlock {
+    struct ConeBlock *next;
+    struct ConeBlock *nextbatch;
+} ConeBlock;
+
+// A thread's cache of free blocks for one size class
+typedef struct {
+    ConeBlock *blocks;
+    size_t count;
+} ConeCache;
+
+static ConeThreadLocal ConeCache coneCaches[ConeClasses];
+
+// The central pool's batches of free blocks, for each size class
+static ConeBlock *conePoolBatches[ConeClasses];
+static long conePoolLock = 0;
+
+static void *coneAllocOrAbort(size_t size) {
+    void *p = malloc(size);
+    if (p == NULL) {
+        fflush(stdout);
+        fprintf(stderr, "Out of memory allocating %zu bytes\n", size);
+        abort();
+    }
+    return p;
+}
+
+static size_t coneSizeClass(size_t size) {
+    return size <= ConeAlign ? 1 : (size + ConeAlign - 1) / ConeAlign;
+}
+
+#ifndef _WIN32
+// Give an exiting thread's cached blocks back to the central pool
+static pthread_key_t coneCacheKey;
+static pthread_once_t coneCacheKeyOnce = PTHREAD_ONCE_INIT;
+static ConeThreadLocal int coneCacheKeySet = 0;
+
+static void coneCacheFlush(void *unused) {
+    (void)unused;
+    size_t sizeclass;
+    for (sizeclass = 1; sizeclass < ConeClasses; ++sizeclass) {
+        ConeCache *cache = &coneCaches[sizeclass];
+        if (cache->blocks == NULL)
+            continue;
+        // Whatever is left becomes one (possibly partial) batch
+        coneLock(&conePoolLock);
+        cache->blocks->nextbatch = conePoolBatches[sizeclass];
+        conePoolBatches[sizeclass] = cache->blocks;
+        coneUnlock(&conePoolLock);
+        cache->blocks = NULL;
+        cache->count = 0;
+    }
+}
+
+static void coneCacheKeyCreate() {
+    pthread_key_create(&coneCacheKey, coneCacheFlush);
+}
+#endif
+
+// Have the thread's cache flushed when it exits, once it first holds blocks
+// (taken from the pool, or freed by this thread after another allocated them)
+static void coneCacheWatch() {
+#ifndef _WIN32
+    if (!coneCacheKeySet) {
+        pthread_once(&coneCacheKeyOnce, coneCacheKeyCreate);
+        pthread_setspecific(coneCacheKey, coneCaches);
+        coneCacheKeySet = 1;
+    }
+#endif
+}
+
+// Link count blocks of blksize bytes, starting at blk, into a batch
+static ConeBlock *coneCarveBatch(char *blk, size_t blksize, size_t count) {
+    char *last = blk + (count - 1) * blksize;
+    char *p;
+    for (p = blk; p < last; p += blksize)
+        ((ConeBlock*)p)->next = (ConeBlock*)(p + blksize);
+    ((ConeBlock*)last)->next = NULL;
+    return (ConeBlock*)blk;
+}
+
+// Refill a thread's empty cache with a batch: from the central pool, or else carved from a new chunk
+static void coneCacheRefill(ConeCache *cache, size_t sizeclass) {
+    coneCacheWatch();
+
+    coneLock(&conePoolLock);
+    ConeBlock *batch = conePoolBatches[sizeclass];
+    if (batch)
+        conePoolBatches[sizeclass] = batch->nextbatch;
+    coneUnlock(&conePoolLock);
+    if (batch) {
+        size_t count = 0;
+        ConeBlock *blk;
+        for (blk = batch; blk; blk = blk->next)
+            ++count;
+        cache->blocks = batch;
+        cache->count = count;
+        return;
+    }
+
+    // Carve a new chunk into batches. This thread keeps the first; the rest go to the pool.
+    size_t blksize = sizeclass * ConeAlign;
+    size_t nblks = ConeChunkSize / blksize;
+    char *chunk = (char*)coneAllocOrAbort(ConeChunkSize);
+    ConeBlock *batches = NULL;
+    ConeBlock *lastbatch = NULL;
+    size_t first;
+    for (first = 0; first < nblks; first += ConeBatch) {
+        size_t count = nblks - first < ConeBatch ? nblks - first : ConeBatch;
+        batch = coneCarveBatch(chunk + first * blksize, blksize, count);
+        if (first == 0) {
+            cache->blocks = batch;
+            cache->count = count;
+            continue;
+        }
+        if (batches == NULL)
+            lastbatch = batch;
+        batch->nextbatch = batches;
+        batches = batch;
+    }
+    if (batches) {
+        coneLock(&conePoolLock);
+        lastbatch->nextbatch = conePoolBatches[sizeclass];
+        conePoolBatches[sizeclass] = batches;
+        coneUnlock(&conePoolLock);
+    }
+}
+
+// Give a batch of blocks from a thread's overfull cache back to the central pool
+static void coneCacheRelease(ConeCache *cache, size_t sizeclass) {
+    ConeBlock *batch = cache->blocks;
+    ConeBlock *last = batch;
+    size_t i;
+    for (i = 1; i < ConeBatch; ++i)
+        last = last->next;
+    cache->blocks = last->next;
+    cache->count -= ConeBatch;
+    last->next = NULL;
+
+    coneLock(&conePoolLock);
+    batch->nextbatch = conePoolBatches[sizeclass];
+    conePoolBatches[sizeclass] = batch;
+    coneUnlock(&conePoolLock);
+}
+
+void *coneAlloc(size_t size) {
+    if (size > ConeAllocMax)
+        return coneAllocOrAbort(size);
+    size_t sizeclass = coneSizeClass(size);
+    ConeCache *cache = &coneCaches[sizeclass];
+    if (cache->blocks == NULL)
+        coneCacheRefill(cache, sizeclass);
+    ConeBlock *blk = cache->blocks;
+    cache->blocks = blk->next;
+    --cache->count;
+    return blk;
+}
+
+void coneFree(void *p, size_t size) {
+    if (size > ConeAllocMax) {
+        free(p);
+        return;
+    }
+    size_t sizeclass = coneSizeClass(size);
+    ConeCache *cache = &coneCaches[sizeclass];
+    if (cache->blocks == NULL)
+        coneCacheWatch();
+    ConeBlock *blk = (ConeBlock*)p;
+    blk->next = cache->blocks;
+    cache->blocks = blk;
+    if (++cache->count >= 2 * ConeBatch)
+        coneCacheRelease(cache, sizeclass);
+}
@@ -0,0 +1,143 @@
+/** region - Memory for the corelib's arena and slab regions
+ * @file
+ *
+ * Each thread has its own arena and slabs, so neither needs a lock.
+ * Both abort when out of memory, which is why their _alloc is @nonnull.
+ *
+ * The arena bumps a pointer through large chunks and never frees a single allocation.
+ * All of a thread's arena memory is released at once by coneArenaReset
+ * (once nothing refers to it anymore), or else when the program ends.
+ *
+ * The slab region keeps a free list of same-sized blocks for each size
+ * (in ConeAlign steps, up to ConeSlabMax bytes), so allocating and freeing values
+ * of one type is a few loads and stores. Larger allocations use malloc and free.
+ * A slab's chunks are kept for reuse, not returned to malloc.
+ *
+ * This source file is part of the Cone Programming Language C compiler
+ * See Copyright Notice in conec.h
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _MSC_VER
+#define ConeThreadLocal __declspec(thread)
+#else
+#define ConeThreadLocal _Thread_local
+#endif
+
+#define ConeAlign 16                // Every block is aligned (and sized) to this
+#define ConeChunkSize (64 * 1024)   // Memory is obtained from malloc in chunks this big
+#define ConeSlabMax 1024            // Largest size served from a slab's free lists
+
+static void *coneChunkAlloc(size_t size) {
+    void *chunk = malloc(size);
+    if (chunk == NULL) {
+        fflush(stdout);
+        fprintf(stderr, "Out of memory allocating %zu bytes\n", size);
+        abort();
+    }
+    return chunk;
+}
+
+// ************************ Arena *******************************
+
+// Every arena chunk starts with this header (padded to ConeAlign)
+typedef struct ConeArenaChunk {
+    struct ConeArenaChunk *next;
+} ConeArenaChunk;
+
+static ConeThreadLocal ConeArenaChunk *coneArenaChunks = NULL;
+static ConeThreadLocal char *coneArenaNext = NULL;
+static ConeThreadLocal char *coneArenaEnd = NULL;
+
+void *coneArenaAlloc(size_t size) {
+    size = (size + ConeAlign - 1) & ~(size_t)(ConeAlign - 1);
+    if ((size_t)(coneArenaEnd - coneArenaNext) >= size) {
+        void *p = coneArenaNext;
+        coneArenaNext += size;
+        return p;
+    }
+
+    // A big allocation gets a chunk of its own, leaving the current chunk in use
+    if (size > ConeChunkSize / 4) {
+        ConeArenaChunk *chunk = (ConeArenaChunk*)coneChunkAlloc(ConeAlign + size);
+        if (coneArenaChunks) {
+            chunk->next = coneArenaChunks->next;
+            coneArenaChunks->next = chunk;
+        }
+        else {
+            chunk->next = NULL;
+            coneArenaChunks = chunk;
+        }
+        return (char*)chunk + ConeAlign;
+    }
+
+    // Otherwise, start bumping through a fresh chunk
+    ConeArenaChunk *chunk = (ConeArenaChunk*)coneChunkAlloc(ConeChunkSize);
+    chunk->next = coneArenaChunks;
+    coneArenaChunks = chunk;
+    coneArenaNext = (char*)chunk + ConeAlign + size;
+    coneArenaEnd = (char*)chunk + ConeChunkSize;
+    return (char*)chunk + ConeAlign;
+}
+
+// Free everything this thread allocated in the arena
+void coneArenaReset() {
+    while (coneArenaChunks) {
+        ConeArenaChunk *next = coneArenaChunks->next;
+        free(coneArenaChunks);
+        coneArenaChunks = next;
+    }
+    coneArenaNext = NULL;
+    coneArenaEnd = NULL;
+}
+
+// ************************ Slab *******************************
+
+typedef struct ConeSlabBlock {
+    struct ConeSlabBlock *next;
+} ConeSlabBlock;
+
+// Free blocks for each size class: index n holds blocks of n * ConeAlign bytes
+static ConeThreadLocal ConeSlabBlock *coneSlabFreeLists[ConeSlabMax / ConeAlign + 1];
+
+static size_t coneSlabClass(size_t size) {
+    return size <= ConeAlign ? 1 : (size + ConeAlign - 1) / ConeAlign;
+}
+
+// Carve a new chunk into free blocks of a size class
+static ConeSlabBlock *coneSlabRefill(size_t sizeclass) {
+    size_t blksize = sizeclass * ConeAlign;
+    char *chunk = (char*)coneChunkAlloc(ConeChunkSize);
+    char *last = chunk + (ConeChunkSize / blksize - 1) * blksize;
+    char *blk;
+    for (blk = chunk; blk < last; blk += blksize)
+        ((ConeSlabBlock*)blk)->next = (ConeSlabBlock*)(blk + blksize);
+    ((ConeSlabBlock*)last)->next = NULL;
+    return (ConeSlabBlock*)chunk;
+}
+
+void *coneSlabAlloc(size_t size) {
+    if (size > ConeSlabMax)
+        return coneChunkAlloc(size);
+    size_t sizeclass = coneSlabClass(size);
+    ConeSlabBlock *blk = coneSlabFreeLists[sizeclass];
+    if (blk == NULL)
+        blk = coneSlabRefill(sizeclass);
+    coneSlabFreeLists[sizeclass] = blk->next;
+    return blk;
+}
+
+void coneSlabFree(void *p, size_t size) {
+    if (size > ConeSlabMax) {
+        free(p);
+        return;
+    }
+    size_t sizeclass = coneSlabClass(size);
+    ConeSlabBlock *blk = (ConeSlabBlock*)p;
+    blk->next = coneSlabFreeLists[sizeclass];
+    coneSlabFreeLists[sizeclass] = blk;
+}
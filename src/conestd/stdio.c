@@ -8,6 +8,7 @@
 #include <stdint.h>
 #include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 void printStr(char *p, size_t len) {
 	fwrite(p, len, 1, stdout);
@@ -29,6 +30,14 @@ void printFloat(double nbr) {
 	printf("%g", nbr);
 }
 
+// Report a panic (such as an out-of-bounds index) and where it happened, then abort.
+// Generated code calls this in place of its own conePanic, which only traps.
+void conePanic(char *file, uint32_t line) {
+	fflush(stdout);
+	fprintf(stderr, "Panic at %s:%" PRIu32 "\n", file, line);
+	abort();
+}
+
 void printChar(uint64_t code) {
 	char result[6];
 	char *p = &result[0];
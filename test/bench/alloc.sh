@@ -0,0 +1,85 @@
+#!/bin/sh
+# Times so and rc allocation churn with the runtime's thread-caching allocator (the default),
+# compared to libc's malloc and free (--malloc).
+# Usage and output are described in compare.sh.
+
+BENCH=alloc
+KERNELS="so rc mixed"
+. "$(dirname "$0")/compare.sh"
+
+$CC -O2 -c "$CONESTD/alloc.c" -o "$DIR/alloc.o" || exit 1
+# Allocated references are handed to C, so LLVM cannot optimize malloc and free away
+echo "int benchSink(int *p) { return p[0]; } int benchSinkBig(int *p) { return p[1]; }" > "$DIR/sink.c"
+$CC -O2 -c "$DIR/sink.c" -o "$DIR/sink.o" || exit 1
+
+# Write the program that runs one kernel
+kernel() {
+    cat <<'EOF'
+import stdio::*
+
+struct Small:
+  a i32
+  b i32
+
+struct Big:
+  a i32
+  b [30; i32]
+
+extern fn benchSink(p &Small) i32
+extern fn benchSinkBig(p &Big) i32
+
+fn useSmall(p +so Small) i32:
+  benchSink(&*p)
+
+fn useBig(p +so Big) i32:
+  benchSinkBig(&*p)
+
+fn share(p &Small) i32:
+  benchSink(p)
+
+EOF
+    case $1 in
+    so) cat <<'EOF'
+fn kernel(reps i32) i32:
+  mut sum = 0
+  mut r = 0
+  while r < reps:
+    sum += useSmall(+so Small[r, 1])
+    r += 1
+  sum
+EOF
+    ;;
+    rc) cat <<'EOF'
+fn kernel(reps i32) i32:
+  mut sum = 0
+  mut r = 0
+  while r < reps:
+    imm p = +rc-imm Small[1, r]
+    imm q = p
+    sum += share(&*q) + share(&*p)
+    r += 1
+  sum
+EOF
+    ;;
+    mixed) cat <<'EOF'
+fn kernel(reps i32) i32:
+  mut sum = 0
+  mut r = 0
+  while r < reps:
+    imm p = +rc-imm Small[1, r]
+    sum += useBig(+so Big[r, [30; 0]])
+    sum += useSmall(+so Small[r, 1])
+    sum += share(&*p)
+    r += 1
+  sum
+EOF
+    ;;
+    esac
+    cat <<'EOF'
+
+fn main():
+  print <- kernel(20000000)
+EOF
+}
+
+benchCompare malloc --malloc conestd "" "$DIR/alloc.o" "$DIR/sink.o"
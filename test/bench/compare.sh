@@ -0,0 +1,80 @@
+# Shared by the benchmarks that time the same kernels compiled two ways,
+# e.g., with an optimization (the default) and without it. Each is run as:
+#
+#   test/bench/<name>.sh [conec] [runs]
+#     conec    Compiler to benchmark (default: conec)
+#     runs     Run each program this many times, keeping the fastest (default: 3)
+#
+# A benchmark sets BENCH (its name) and sources this file, which sets CONEC,
+# RUNS, CC ($CC, default cc), DIR (an empty directory for its files) and
+# CONESTD (the runtime's sources), and compiles the stdio runtime.
+# The benchmark then defines kernel(), which writes the program for a kernel,
+# compiles any C it links with, and calls benchCompare.
+
+CONEC=${1:-conec}
+RUNS=${2:-3}
+CC=${CC:-cc}
+DIR=${TMPDIR:-/tmp}/cone-$BENCH-bench
+CONESTD=$(dirname "$0")/../../src/conestd
+
+rm -rf "$DIR" && mkdir -p "$DIR" || exit 1
+$CC -O2 -c "$CONESTD/stdio.c" -o "$DIR/stdio.o" || exit 1
+
+# Time each of $KERNELS compiled two ways, linked with stdio and the given objects:
+#   benchCompare name1 flags1 name2 flags2 [objects...]
+# Prints a table of milliseconds per kernel, checks that both ways compute
+# the same result, and exits with 1 if not.
+# If the benchmark defines benchColumns, it is run after each compile
+# to print more columns (headed by $BENCH_COLUMNS) from conec's output in
+# $DIR/build.txt. These come before the times. $BENCH_FLAGS go to conec both ways.
+benchCompare() {
+    name1=$1 flags1=$2 name2=$3 flags2=$4
+    shift 4
+    printf "%-9s" "kernel"
+    for col in $BENCH_COLUMNS; do
+        printf "%9s" $col
+    done
+    printf "%9s%9s\n" "$name1" "$name2"
+
+    status=0
+    for k in $KERNELS; do
+        kernel $k > "$DIR/$k.cone"
+        printf "%-9s" $k
+        expect=
+        msecs=
+        for way in 1 2; do
+            if [ $way = 1 ]; then flags=$flags1; else flags=$flags2; fi
+            out="$DIR/out$way"
+            mkdir -p "$out"
+            "$CONEC" "$DIR/$k.cone" -o "$out" $BENCH_FLAGS $flags > "$DIR/build.txt" 2>&1 \
+                && $CC -no-pie "$out/$k.o" "$DIR/stdio.o" "$@" -o "$out/$k" >> "$DIR/build.txt" 2>&1 \
+                || { echo; cat "$DIR/build.txt" >&2; exit 1; }
+            if [ -n "$BENCH_COLUMNS" ]; then
+                benchColumns
+            fi
+
+            # Keep the fastest run
+            best=
+            r=0
+            while [ $r -lt $RUNS ]; do
+                start=$(date +%s%N)
+                result=$("$out/$k")
+                msec=$(( ($(date +%s%N) - start) / 1000000 ))
+                if [ -z "$best" ] || [ $msec -lt $best ]; then
+                    best=$msec
+                fi
+                r=$((r + 1))
+            done
+            msecs="$msecs$(printf "%9s" $best)"
+
+            if [ -z "$expect" ]; then
+                expect=$result
+            elif [ "$result" != "$expect" ]; then
+                msecs="$msecs (got $result, expected $expect)"
+                status=1
+            fi
+        done
+        echo "$msecs"
+    done
+    exit $status
+}
@@ -0,0 +1,119 @@
+#!/bin/sh
+# Times calls and field accesses through virtual references, going directly to the
+# implementing struct's method (the default), compared to always through the vtable (--nodevirt).
+# Usage and output are described in compare.sh.
+
+BENCH=devirt
+KERNELS="single dominant"
+. "$(dirname "$0")/compare.sh"
+
+# The virtual references are kept in memory from C, so LLVM cannot tell which vtable each has
+cat > "$DIR/objs.c" <<'EOF'
+static long benchShelves[64][2];
+static int benchObjs[64][4];
+void *benchShelf(void) { return benchShelves; }
+void *benchSquare(int i) { return benchObjs[i]; }
+void *benchRect(int i) { return benchObjs[i]; }
+int benchKind(int i) { return i % 8 == 7 ? 2 : i % 2; }
+EOF
+$CC -O2 -c "$DIR/objs.c" -o "$DIR/objs.o" || exit 1
+
+# Write the program that runs one kernel
+kernel() {
+    cat <<'EOF'
+import stdio::*
+
+trait Shape:
+  id i32
+  fn area(self &) i32
+
+struct Square extends Shape:
+  side i32
+  fn area(self &) i32:
+    side * side
+
+struct Rect extends Shape:
+  w i32
+  h i32
+  fn area(self &) i32:
+    w * h
+
+extern fn benchSquare(i i32) &mut Square
+extern fn benchRect(i i32) &mut Rect
+extern fn benchKind(i i32) i32
+
+EOF
+    case $1 in
+    single) cat <<'EOF'
+// Only Square implements Gauge: its calls and fields need no vtable
+trait Gauge:
+  id i32
+  fn area(self &) i32
+
+struct Shelf:
+  items [64; &<Gauge]
+
+extern fn benchShelf() &mut Shelf
+
+fn stock(shelf &mut Shelf):
+  mut i = 0u32
+  while i < 64u32:
+    imm sq = benchSquare(i32[i])
+    sq.id = 1
+    sq.side = i32[i]
+    shelf.items[i] = &*sq
+    i += 1
+EOF
+    ;;
+    dominant) cat <<'EOF'
+// Most Shapes are built from Squares: their calls skip the vtable
+struct Shelf:
+  items [64; &<Shape]
+
+extern fn benchShelf() &mut Shelf
+
+fn stock(shelf &mut Shelf):
+  mut i = 0u32
+  while i < 64u32:
+    imm kind = benchKind(i32[i])
+    if kind == 0:
+      imm sq = benchSquare(i32[i])
+      sq.id = 1
+      sq.side = i32[i]
+      shelf.items[i] = &*sq
+    elif kind == 1:
+      imm big = benchSquare(i32[i])
+      big.id = 3
+      big.side = i32[i] * 2
+      shelf.items[i] = &*big
+    else:
+      imm rect = benchRect(i32[i])
+      rect.id = 2
+      rect.w = i32[i]
+      rect.h = 2
+      shelf.items[i] = &*rect
+    i += 1
+EOF
+    ;;
+    esac
+    cat <<'EOF'
+
+fn kernel(reps i32) i32:
+  imm shelf = benchShelf()
+  stock(shelf)
+  mut sum = 0
+  mut r = 0
+  while r < reps:
+    mut i = 0u32
+    while i < 64u32:
+      sum += shelf.items[i].area() + shelf.items[i].id
+      i += 1
+    r += 1
+  sum
+
+fn main():
+  print <- kernel(2000000)
+EOF
+}
+
+benchCompare vtable --nodevirt devirt "" "$DIR/objs.o"
@@ -0,0 +1,52 @@
+#!/bin/sh
+# Micro-benchmark for the lexer: how fast conec scans a generated source file
+# that is heavy on long identifiers, deep indentation, string literals and comments.
+#
+# Usage: test/bench/lexer.sh [conec] [functions] [runs]
+#
+# Prints the fastest run's load, lexer and parse times (from conec -V 1),
+# and the lexer's throughput in MB of source per second.
+
+CONEC=${1:-conec}
+FNS=${2:-2000}
+RUNS=${3:-5}
+DIR=${TMPDIR:-/tmp}/cone-lexer-bench
+
+rm -rf "$DIR" && mkdir -p "$DIR/out" || exit 1
+
+awk -v fns=$FNS 'BEGIN {
+    indent = "                "
+    for (f = 0; f < fns; ++f) {
+        print "/* Block comment for function " f ", which goes on for a while to describe"
+        print "   what the function does, including /* nested */ comments and \"strings\" */"
+        print "// A line comment that also takes up a good part of the line, as they often do"
+        print "fn a_rather_long_function_name_" f "(first_parameter_name i32, second_parameter_name i32) i32:"
+        print indent "imm a_long_local_variable_name = first_parameter_name + second_parameter_name"
+        print indent "imm another_string_literal = \"a string literal with enough text in it to matter, \\t escaped\""
+        print indent "if a_long_local_variable_name > " f ":"
+        print indent indent "return a_long_local_variable_name * second_parameter_name   // trailing comment"
+        print indent "first_parameter_name"
+        print ""
+    }
+    print "fn main():"
+    print "  a_rather_long_function_name_0(1, 2)"
+}' > "$DIR/lex.cone" || exit 1
+BYTES=$(wc -c < "$DIR/lex.cone")
+
+best=
+r=0
+while [ $r -lt $RUNS ]; do
+    "$CONEC" "$DIR/lex.cone" -o "$DIR/out" --debug -V 1 > "$DIR/run.txt" 2>&1 \
+        || { cat "$DIR/run.txt" >&2; echo "conec failed" >&2; exit 1; }
+    t=$(sed -n 's/^  Lexer: *//p' "$DIR/run.txt")
+    if [ -z "$best" ] || awk "BEGIN { exit !($t < $best) }"; then
+        best=$t
+        cp "$DIR/run.txt" "$DIR/best.txt"
+    fi
+    r=$((r + 1))
+done
+
+echo "$FNS functions: $BYTES bytes"
+sed -n 's/^  \(Load\|Lexer\|Parse\): *\(.*\)$/\1 \2/p' "$DIR/best.txt" \
+    | awk '{ printf "  %-6s %9.4f sec\n", $1, $2 }'
+awk "BEGIN { printf \"lexer:  %.1f MB/sec\\n\", $BYTES / $best / 1000000 }"
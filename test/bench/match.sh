@@ -0,0 +1,122 @@
+#!/bin/sh
+# Times a 50-case match on a union's variant, generated as a switch (the default),
+# compared to as a chain of tests (--noswitch).
+# Usage and output are described in compare.sh.
+
+BENCH=match
+KERNELS="tags virt"
+VARIANTS=50
+. "$(dirname "$0")/compare.sh"
+
+# The values matched come from memory that C hands out, so LLVM cannot tell which case each takes
+cat > "$DIR/objs.c" <<'EOF'
+static long benchShelves[64][2];
+static long benchObjs[64];
+void *benchShelf(void) { return benchShelves; }
+void *benchObj(int i) { return &benchObjs[i]; }
+int benchKind(int i) { return i * 37 % 50; }
+EOF
+$CC -O2 -c "$DIR/objs.c" -o "$DIR/objs.o" || exit 1
+
+# Print a line for each variant, with $i replaced by its number and $sq by its square
+variants() {
+    i=0
+    while [ $i -lt $VARIANTS ]; do
+        echo "$1" | sed "s/\\\$i/$i/g; s/\\\$sq/$((i * i))/g; s/\\\$k/$((i + 3))/g"
+        i=$((i + 1))
+    done
+}
+
+# Write the program that runs one kernel
+kernel() {
+    echo "import stdio::*"
+    echo
+    case $1 in
+    tags)
+        echo "// A union's tag picks the case"
+        echo "union Msg:"
+        variants "  struct V\$i:
+    n i32"
+        cat <<'EOF'
+
+struct Shelf:
+  items [64; Msg]
+
+extern fn benchShelf() &mut Shelf
+extern fn benchKind(i i32) i32
+
+fn make(kind i32, n i32) Msg:
+  match kind:
+EOF
+        variants "    case == \$i: V\$i[n]"
+        cat <<'EOF'
+    else: V0[n]
+
+fn stock(shelf &mut Shelf):
+  mut i = 0u32
+  while i < 64u32:
+    shelf.items[i] = make(benchKind(i32[i]), i32[i])
+    i += 1
+
+fn handle(m Msg) i32:
+  match m:
+EOF
+        variants "    case imm v V\$i: v.n * \$k + \$sq"
+        ;;
+    virt)
+        echo "// A virtual reference's vtable picks the case"
+        echo "trait Shape:"
+        echo "  fn area(self &) i32"
+        variants "struct S\$i extends Shape:
+  n i32
+  fn area(self &) i32:
+    n + \$i"
+        cat <<'EOF'
+
+struct Shelf:
+  items [64; &<Shape]
+
+extern fn benchShelf() &mut Shelf
+extern fn benchObj(i i32) &mut S0
+extern fn benchKind(i i32) i32
+
+fn stock(shelf &mut Shelf):
+  mut i = 0u32
+  while i < 64u32:
+    imm obj = benchObj(i32[i])
+    obj.n = i32[i]
+    match benchKind(i32[i]):
+EOF
+        variants "      case == \$i: shelf.items[i] = &*obj as &S\$i"
+        cat <<'EOF'
+      else: shelf.items[i] = &*obj
+    i += 1
+
+fn handle(s &<Shape) i32:
+  match s:
+EOF
+        variants "    case imm v &S\$i: v.n * \$k + \$sq"
+        echo "    else: 0"
+        ;;
+    esac
+    cat <<'EOF'
+
+fn kernel(reps i32) i32:
+  imm shelf = benchShelf()
+  stock(shelf)
+  mut sum = 0
+  mut r = 0
+  while r < reps:
+    mut i = 0u32
+    while i < 64u32:
+      sum += handle(shelf.items[i])
+      i += 1
+    r += 1
+  sum
+
+fn main():
+  print <- kernel(1000000)
+EOF
+}
+
+benchCompare tests --noswitch switch "" "$DIR/objs.o"
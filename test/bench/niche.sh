@@ -0,0 +1,104 @@
+#!/bin/sh
+# Measures unions' size and how fast a large array of them is scanned, with the tag kept
+# in unused values or padding (the default), compared to in a field of its own (--noniche).
+# Usage and output are described in compare.sh.
+
+BENCH=niche
+KERNELS="ref pair"
+BENCH_FLAGS=--layout
+BENCH_COLUMNS="tagbytes bytes"
+. "$(dirname "$0")/compare.sh"
+
+# The array is bigger than the caches, so scanning it takes as long as reading it from memory
+cat > "$DIR/mem.c" <<'EOF'
+static long benchShelves[3 << 20];
+static int benchInts[64];
+void *benchShelf(void) { return benchShelves; }
+int *benchInt(int i) { benchInts[i] = i; return &benchInts[i]; }
+EOF
+$CC -O2 -c "$DIR/mem.c" -o "$DIR/mem.o" || exit 1
+
+# Write the program that runs one kernel
+kernel() {
+    echo "import stdio::*"
+    echo
+    case $1 in
+    ref) cat <<'EOF'
+// A reference is never null, so null can say there is none
+union Item:
+  struct Empty {}
+  struct Full:
+    r &i32
+
+extern fn benchInt(i i32) &i32
+
+fn make(i u32) Item:
+  if i % 3u32 == 0u32:
+    Empty[]
+  else:
+    Full[benchInt(i32[i % 64u32])]
+
+fn handle(item Item) i32:
+  match item:
+    case imm f Full: *f.r
+    else: 1
+EOF
+    ;;
+    pair) cat <<'EOF'
+// The tag fits in the padding after either variant's fields
+union Item:
+  struct Big:
+    a i64
+    b i8
+  struct Small:
+    a i32
+    b i8
+
+fn make(i u32) Item:
+  if i % 3u32 == 0u32:
+    Small[i32[i], 2i8]
+  else:
+    Big[i64[i], 3i8]
+
+fn handle(item Item) i32:
+  match item:
+    case imm b Big: i32[b.b]
+    case imm s Small: i32[s.b] + s.a % 2
+    else: 0
+EOF
+    ;;
+    esac
+    cat <<'EOF'
+
+struct Shelf:
+  items [1048576; Item]
+
+extern fn benchShelf() &mut Shelf
+
+fn kernel(reps i32) i32:
+  imm shelf = benchShelf()
+  mut i = 0u32
+  while i < 1048576u32:
+    shelf.items[i] = make(i)
+    i += 1
+  mut sum = 0
+  mut r = 0
+  while r < reps:
+    i = 0u32
+    while i < 1048576u32:
+      sum += handle(shelf.items[i])
+      i += 1
+    r += 1
+  sum
+
+fn main():
+  print <- kernel(100)
+EOF
+}
+
+# Print the union's size (from --layout)
+benchColumns() {
+    printf "%9s" $(sed -n 's/^Item: \([0-9]*\) bytes.*/\1/p' "$DIR/build.txt")
+}
+
+benchCompare tag --noniche niche "" "$DIR/mem.o"
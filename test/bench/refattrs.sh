@@ -0,0 +1,85 @@
+#!/bin/sh
+# Times loops over borrowed references with noalias, readonly, nonnull and
+# dereferenceable (the default), compared to without them (--norefattrs).
+# Usage and output are described in compare.sh.
+
+BENCH=refattrs
+KERNELS="accum scale"
+. "$(dirname "$0")/compare.sh"
+
+# The references come from C, so LLVM cannot tell where they point except from their attributes
+cat > "$DIR/refs.c" <<'EOF'
+static int benchAccs[2];
+static int benchVals[2][4096];
+int *benchAcc(void) { return benchAccs; }
+int *benchData(int n) { int i; for (i = 0; i < 4096; ++i) benchVals[n][i] = 3; return benchVals[n]; }
+EOF
+$CC -O2 -c "$DIR/refs.c" -o "$DIR/refs.o" || exit 1
+
+# Write the program that runs one kernel
+kernel() {
+    cat <<'EOF'
+import stdio::*
+
+struct Acc:
+  total i32
+  count i32
+
+struct Data:
+  vals [4096; i32]
+
+extern fn benchAcc() &uni Acc
+extern fn benchData(n i32) &uni Data
+
+EOF
+    case $1 in
+    accum) cat <<'EOF'
+// Without noalias, every add must be stored, in case a.total is one of d's values
+fn accumulate(a &uni Acc, d &imm Data):
+  mut i = 0usize
+  while i < 4096:
+    a.total += d.vals[i]
+    a.count += 1
+    i += 1
+
+fn kernel(reps i32) i32:
+  imm acc = benchAcc()
+  imm data = benchData(0)
+  mut r = 0
+  while r < reps:
+    accumulate(&uni *acc, &imm *data)
+    r += 1
+  acc.total + acc.count
+EOF
+    ;;
+    scale) cat <<'EOF'
+// Without noalias, d.count must be reloaded after every store, in case out holds it.
+// The trip count is then unknown, so the loop is not vectorized.
+fn scale(out &uni Data, d &imm Acc, src &imm Data):
+  mut i = 0u32
+  while i < d.count as u32:
+    out.vals[i] += src.vals[i] * d.total
+    i += 1
+
+fn kernel(reps i32) i32:
+  imm acc = benchAcc()
+  acc.total = 2
+  acc.count = 4096
+  imm out = benchData(0)
+  imm src = benchData(1)
+  mut r = 0
+  while r < reps:
+    scale(&uni *out, &imm *acc, &imm *src)
+    r += 1
+  out.vals[0] + out.vals[4095]
+EOF
+    ;;
+    esac
+    cat <<'EOF'
+
+fn main():
+  print <- kernel(100000)
+EOF
+}
+
+benchCompare noattrs --norefattrs attrs "" "$DIR/refs.o"
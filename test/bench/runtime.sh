@@ -0,0 +1,181 @@
+#!/bin/sh
+# Benchmark for generated code: how fast small numeric kernels run
+# when compiled at each optimization level.
+#
+# Usage: test/bench/runtime.sh [conec] [levels] [runs]
+#   conec    Compiler to benchmark (default: conec)
+#   levels   Optimization levels to compare (default: "0 1 2 3 s z")
+#   runs     Run each program this many times, keeping the fastest (default: 3)
+#
+# Each kernel is compiled at each -O level, linked with the stdio runtime
+# (using $CC, default cc) and timed. Prints a table of milliseconds per kernel,
+# and checks that every level computes the same result.
+
+CONEC=${1:-conec}
+LEVELS=${2:-"0 1 2 3 s z"}
+RUNS=${3:-3}
+CC=${CC:-cc}
+DIR=${TMPDIR:-/tmp}/cone-runtime-bench
+STDIO=$(dirname "$0")/../../src/conestd/stdio.c
+KERNELS="saxpy dot matmul sieve"
+
+rm -rf "$DIR" && mkdir -p "$DIR" || exit 1
+$CC -O2 -c "$STDIO" -o "$DIR/stdio.o" || exit 1
+
+# Write the program that runs one kernel
+kernel() {
+    echo "import stdio::*"
+    echo
+    case $1 in
+    saxpy) cat <<'EOF'
+mut xs [4096; f32]
+mut ys [4096; f32]
+
+fn kernel(reps i32) f32:
+  mut i = 0usize
+  while i < 4096:
+    xs[i] = f32[i] * 0.5
+    ys[i] = f32[i]
+    i += 1
+  mut r = 0
+  while r < reps:
+    mut j = 0usize
+    while j < 4096:
+      ys[j] = 1.001 * xs[j] + ys[j]
+      j += 1
+    r += 1
+  ys[100]
+
+fn main():
+  print <- kernel(100000)
+EOF
+    ;;
+    dot) cat <<'EOF'
+mut ai [4096; i32]
+mut bi [4096; i32]
+
+fn kernel(reps i32) i32:
+  mut i = 0usize
+  while i < 4096:
+    ai[i] = i32[i] & 15
+    bi[i] = 3 - (i32[i] & 7)
+    i += 1
+  mut sum = 0
+  mut r = 0
+  while r < reps:
+    mut j = 0usize
+    while j < 4096:
+      sum += ai[j] * bi[j] + r
+      j += 1
+    r += 1
+  sum
+
+fn main():
+  print <- kernel(100000)
+EOF
+    ;;
+    matmul) cat <<'EOF'
+mut ma [16384; f64]
+mut mb [16384; f64]
+mut mc [16384; f64]
+
+fn kernel(reps i32) f64:
+  mut i = 0usize
+  while i < 16384:
+    ma[i] = f64[i & 7]
+    mb[i] = f64[(i >> 7) & 3] * 0.25
+    i += 1
+  mut r = 0
+  while r < reps:
+    mut row = 0usize
+    while row < 128:
+      mut col = 0usize
+      while col < 128:
+        mut s f64 = 0.
+        mut k = 0usize
+        while k < 128:
+          s += ma[row * 128 + k] * mb[k * 128 + col]
+          k += 1
+        mc[row * 128 + col] = s
+        col += 1
+      row += 1
+    r += 1
+  mc[1000]
+
+fn main():
+  print <- kernel(20)
+EOF
+    ;;
+    sieve) cat <<'EOF'
+mut sieve [65536; u8]
+
+fn kernel(reps i32) i32:
+  mut count = 0
+  mut r = 0
+  while r < reps:
+    mut i = 0usize
+    while i < 65536:
+      sieve[i] = 1u8
+      i += 1
+    count = 0
+    mut p = 2usize
+    while p < 65536:
+      if sieve[p] == 1u8:
+        count += 1
+        mut m = p + p
+        while m < 65536:
+          sieve[m] = 0u8
+          m += p
+      p += 1
+    r += 1
+  count
+
+fn main():
+  print <- kernel(2000)
+EOF
+    ;;
+    esac
+}
+
+printf "%-8s" "kernel"
+for level in $LEVELS; do
+    printf "%9s" "-O$level"
+done
+echo " (msec)"
+
+status=0
+for k in $KERNELS; do
+    kernel $k > "$DIR/$k.cone"
+    printf "%-8s" $k
+    expect=
+    for level in $LEVELS; do
+        out="$DIR/O$level"
+        mkdir -p "$out"
+        "$CONEC" "$DIR/$k.cone" -o "$out" -O$level > "$DIR/build.txt" 2>&1 \
+            && $CC -no-pie "$out/$k.o" "$DIR/stdio.o" -lm -o "$out/$k" >> "$DIR/build.txt" 2>&1 \
+            || { echo; cat "$DIR/build.txt" >&2; exit 1; }
+
+        # Keep the fastest run
+        best=
+        r=0
+        while [ $r -lt $RUNS ]; do
+            start=$(date +%s%N)
+            result=$("$out/$k")
+            msec=$(( ($(date +%s%N) - start) / 1000000 ))
+            if [ -z "$best" ] || [ $msec -lt $best ]; then
+                best=$msec
+            fi
+            r=$((r + 1))
+        done
+        printf "%9s" $best
+
+        if [ -z "$expect" ]; then
+            expect=$result
+        elif [ "$result" != "$expect" ]; then
+            printf " (-O%s got %s, expected %s)" $level "$result" "$expect"
+            status=1
+        fi
+    done
+    echo
+done
+exit $status
@@ -0,0 +1,67 @@
+#!/bin/sh
+# Benchmark for split code generation (--split): how release build time scales
+# as more threads optimize and emit the modules of a generated program.
+#
+# Usage: test/bench/split.sh [conec] [modules] [functions-per-module] [max-jobs]
+#
+# Prints wall-clock seconds for a whole-program build, then for --split builds
+# using 1, 2, 4, ... threads (up to max-jobs, default is the number of CPUs),
+# with speedup over 1 thread.
+
+CONEC=${1:-conec}
+MODS=${2:-32}
+FNS=${3:-200}
+DIR=${TMPDIR:-/tmp}/cone-split-bench
+CPUS=$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 4)
+MAXJOBS=${4:-$CPUS}
+
+rm -rf "$DIR" && mkdir -p "$DIR/out" || exit 1
+
+# Each module has many small functions with loops, so LLVM has real work to do
+m=0
+while [ $m -lt $MODS ]; do
+    {
+        f=0
+        while [ $f -lt $FNS ]; do
+            echo "fn calc$f(n i32) i32:"
+            echo "  mut a = n"
+            echo "  mut i = 0"
+            echo "  while i < $((f % 7 + 3)):"
+            echo "    a = a * 3 + i - $f"
+            echo "    i = i + 1"
+            echo "  a"
+            f=$((f + 1))
+        done
+        echo "fn entry(n i32) i32:"
+        echo "  calc0(n) + calc$((FNS - 1))(n)"
+    } > "$DIR/m$m.cone"
+    m=$((m + 1))
+done
+{
+    m=0
+    while [ $m -lt $MODS ]; do echo "import m$m"; m=$((m + 1)); done
+    echo "fn main():"
+    echo "  mut x = 0"
+    m=0
+    while [ $m -lt $MODS ]; do echo "  x = x + m$m::entry(x)"; m=$((m + 1)); done
+} > "$DIR/main.cone"
+
+now() { date +%s.%N; }
+run() {
+    start=$(now)
+    "$CONEC" "$DIR/main.cone" -o "$DIR/out" "$@" > /dev/null 2>&1 || { echo "conec failed: $*" >&2; exit 1; }
+    end=$(now)
+    awk "BEGIN { printf \"%.3f\", $end - $start }"
+}
+
+echo "$MODS modules x $FNS functions, $CPUS CPUs"
+t=$(run) || exit 1
+echo "whole program:    $t sec"
+base=
+j=1
+while [ $j -le $MAXJOBS ]; do
+    t=$(run --split -j $j) || exit 1
+    [ -z "$base" ] && base=$t
+    awk "BEGIN { printf \"split, %3d jobs: %s sec (x%.2f)\\n\", $j, $t, $base / $t }"
+    j=$((j * 2))
+done
@@ -0,0 +1,106 @@
+#!/bin/sh
+# Times loops that store through one type and load another, with type-based alias
+# analysis metadata (the default), compared to without it (--notbaa).
+# Usage and output are described in compare.sh.
+
+BENCH=tbaa
+KERNELS="fields types"
+. "$(dirname "$0")/compare.sh"
+
+# mut references (which may alias) come from C, so only their types tell LLVM
+# which loads and stores cannot overlap
+cat > "$DIR/data.c" <<'EOF'
+static int benchCellData[4096][2];
+static int benchStatsData[2] = { 1, 0 };
+static float benchSampleData[4096];
+static int benchCounterData[2];
+int *benchCells(void) { int i; for (i = 0; i < 4096; ++i) benchCellData[i][1] = i & 3; return &benchCellData[0][0]; }
+int *benchStats(void) { return benchStatsData; }
+float *benchSamples(void) { int i; for (i = 0; i < 4096; ++i) benchSampleData[i] = (float)i; return benchSampleData; }
+int *benchCounter(void) { return benchCounterData; }
+float benchStep(void) { return 0.25f; }
+EOF
+$CC -O2 -c "$DIR/data.c" -o "$DIR/data.o" || exit 1
+
+# Write the program that runs one kernel
+kernel() {
+    cat <<'EOF'
+import stdio::*
+
+EOF
+    case $1 in
+    fields) cat <<'EOF'
+struct Cell:
+  count i32
+  mass i32
+
+struct Cells:
+  c [4096; Cell]
+
+struct Stats:
+  inc i32
+  total i32
+
+extern fn benchCells() &mut Cells
+extern fn benchStats() &mut Stats
+
+// Fields of different structs never overlap, even with the same type.
+// Without TBAA, st.inc is reloaded and st.total stored on every iteration.
+fn tally(cs &mut Cells, st &mut Stats):
+  mut i = 0usize
+  while i < 4096:
+    cs.c[i].count += st.inc
+    st.total += cs.c[i].mass
+    i += 1
+
+fn kernel(reps i32) i32:
+  imm cs = benchCells()
+  imm st = benchStats()
+  mut r = 0
+  while r < reps:
+    tally(cs, st)
+    r += 1
+  st.total + cs.c[7].count
+EOF
+    ;;
+    types) cat <<'EOF'
+struct Samples:
+  v [4096; f32]
+
+struct Counter:
+  n i32
+  scaled i32
+
+extern fn benchSamples() &mut Samples
+extern fn benchCounter() &mut Counter
+extern fn benchStep() f32
+
+// An i32 never overlaps an f32.
+// Without TBAA, c.scaled is stored on every iteration, so the loop is not vectorized.
+fn shift(s &mut Samples, c &mut Counter, k f32):
+  mut i = 0usize
+  while i < 4096:
+    s.v[i] += k
+    c.scaled += 1
+    i += 1
+
+fn kernel(reps i32) i32:
+  imm s = benchSamples()
+  imm c = benchCounter()
+  imm k = benchStep()
+  mut r = 0
+  while r < reps:
+    shift(s, c, k)
+    r += 1
+  c.scaled + i32[s.v[4095]]
+EOF
+    ;;
+    esac
+    cat <<'EOF'
+
+fn main():
+  print <- kernel(100000)
+EOF
+}
+
+benchCompare notbaa --notbaa tbaa "" "$DIR/data.o"
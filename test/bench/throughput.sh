@@ -0,0 +1,162 @@
+#!/bin/sh
+# Benchmark for compiler throughput: how fast conec compiles a generated program,
+# and how much memory it needs, per line of source.
+#
+# Usage: test/bench/throughput.sh [options]
+#   -c conec      Compiler to benchmark (default: conec)
+#   -m modules    Number of modules (default: 16)
+#   -f functions  Functions per module (default: 100)
+#   -s structs    Structs (with methods) per module (default: 20)
+#   -g generics   Generic functions per module, each instantiated twice (default: 10)
+#   -t traits     Traits per module, each with two structs used through vtables (default: 5)
+#   -d depth      Nesting depth of each function's expression (default: 20)
+#   -r runs       Compile this many times, keeping the fastest (default: 3)
+#   -b file       Compare against the baseline in file (see -u)
+#   -u            Save this run's results as the baseline in the -b file
+#   Other arguments (after --) are passed on to conec (e.g., -- --debug -j 4).
+#
+# Prints per-stage times (from conec -V 1), lines per second,
+# memory (the compiler's memUsed()) per line and the size of the generated code.
+
+CONEC=conec
+MODS=16
+FNS=100
+STRUCTS=20
+GENS=10
+TRAITS=5
+DEPTH=20
+RUNS=3
+BASELINE=
+UPDATE=
+while getopts c:m:f:s:g:t:d:r:b:u opt; do
+    case $opt in
+    c) CONEC=$OPTARG ;;
+    m) MODS=$OPTARG ;;
+    f) FNS=$OPTARG ;;
+    s) STRUCTS=$OPTARG ;;
+    g) GENS=$OPTARG ;;
+    t) TRAITS=$OPTARG ;;
+    d) DEPTH=$OPTARG ;;
+    r) RUNS=$OPTARG ;;
+    b) BASELINE=$OPTARG ;;
+    u) UPDATE=1 ;;
+    *) sed -n '2,19p' "$0" >&2; exit 1 ;;
+    esac
+done
+shift $((OPTIND - 1))
+DIR=${TMPDIR:-/tmp}/cone-throughput-bench
+
+rm -rf "$DIR" && mkdir -p "$DIR/out" || exit 1
+
+# Generate the modules and the main module that calls into all of them
+awk -v dir="$DIR" -v mods=$MODS -v fns=$FNS -v structs=$STRUCTS -v gens=$GENS \
+    -v traits=$TRAITS -v depth=$DEPTH 'BEGIN {
+    for (m = 0; m < mods; ++m) {
+        f = dir "/m" m ".cone"
+        for (s = 0; s < structs; ++s) {
+            print "struct Point" s ":" > f
+            print "  x i32" > f
+            print "  y i32" > f
+            print "  fn sum(self) i32:" > f
+            print "    x + y * " s > f
+            print "" > f
+        }
+        for (t = 0; t < traits; ++t) {
+            print "trait Shape" t ":" > f
+            print "  fn area(self &) i32" > f
+            print "struct Square" t " extends Shape" t ":" > f
+            print "  side i32" > f
+            print "  fn area(self &) i32:" > f
+            print "    side * side + " t > f
+            print "struct Rect" t " extends Shape" t ":" > f
+            print "  w i32" > f
+            print "  h i32" > f
+            print "  fn area(self &) i32:" > f
+            print "    w * h - " t > f
+            print "fn total" t "(shape &<Shape" t ") i32:" > f
+            print "  shape.area() + 1" > f
+            print "" > f
+        }
+        for (g = 0; g < gens; ++g) {
+            print "fn pick" g "[T](a T, b T) T:" > f
+            print "  if a > b {a} else {b}" > f
+            print "" > f
+        }
+        for (i = 0; i < fns; ++i) {
+            print "fn calc" i "(n i32) i32:" > f
+            print "  mut a = n" > f
+            if (structs) {
+                print "  imm p = Point" (i % structs) "[n, " i "]" > f
+                print "  a = a + p.sum()" > f
+            }
+            if (traits) {
+                t = i % traits
+                print "  imm sq = Square" t "[n]" > f
+                print "  imm r = Rect" t "[n, " i "]" > f
+                print "  a = a + total" t "(&sq) + total" t "(&r)" > f
+            }
+            if (gens) {
+                g = i % gens
+                print "  a = a + pick" g "[i32](a, " i ") + pick" g "[f32](1., 2.) as i32" > f
+            }
+            expr = "a"
+            for (d = 0; d < depth; ++d)
+                expr = "(" expr (d % 2 ? " * " : " + ") (d % 5 + 1) ")"
+            print "  " expr > f
+            print "" > f
+        }
+        print "fn entry(n i32) i32:" > f
+        print "  calc0(n) + calc" (fns - 1) "(n)" > f
+        close(f)
+    }
+    f = dir "/main.cone"
+    for (m = 0; m < mods; ++m)
+        print "import m" m > f
+    print "fn main():" > f
+    print "  mut x = start()" > f
+    for (m = 0; m < mods; ++m)
+        print "  x = x + m" m "::entry(x)" > f
+    print "" > f
+    # Declared after its use, which --reachable must still find
+    print "fn start() i32:" > f
+    print "  0" > f
+    close(f)
+}' || exit 1
+LINES=$(cat "$DIR"/*.cone | wc -l)
+
+# Compile several times, keeping the stage times and memory of the fastest compile
+best=
+r=0
+while [ $r -lt $RUNS ]; do
+    rm -f "$DIR"/out/*
+    "$CONEC" "$DIR/main.cone" -o "$DIR/out" -V 1 "$@" > "$DIR/run.txt" 2>&1 \
+        || { cat "$DIR/run.txt" >&2; echo "conec failed" >&2; exit 1; }
+    t=$(sed -n 's/^Compile finished in \([^ ]*\) sec.*/\1/p' "$DIR/run.txt")
+    if [ -z "$best" ] || awk "BEGIN { exit !($t < $best) }"; then
+        best=$t
+        cp "$DIR/run.txt" "$DIR/best.txt"
+    fi
+    r=$((r + 1))
+done
+KB=$(sed -n 's/^Compile finished in .* sec (\([0-9]*\) kb).*/\1/p' "$DIR/best.txt")
+OBJBYTES=$(cat "$DIR"/out/* | wc -c)
+
+echo "$MODS modules x $FNS functions, $STRUCTS structs, $GENS generics, $TRAITS traits, depth $DEPTH: $LINES lines"
+sed -n 's/^  \([A-Za-z ]*\):* *\([0-9.e+-]*\)$/\1 \2/p' "$DIR/best.txt" \
+    | awk '{ t = $NF; $NF = ""; printf "  %-12s %9.4f sec\n", $0, t }'
+RESULT=$(awk "BEGIN { printf \"%.0f %.1f\", $LINES / $best, $KB * 1024 / $LINES }")
+set -- $RESULT
+echo "total:         $best sec, $KB kb"
+echo "throughput:    $1 lines/sec, $2 bytes/line"
+echo "output:        $OBJBYTES bytes"
+
+# Compare with (or save) the baseline
+if [ -n "$BASELINE" ]; then
+    if [ -n "$UPDATE" ]; then
+        echo "$1 $2" > "$BASELINE"
+        echo "baseline saved to $BASELINE"
+    elif [ -f "$BASELINE" ]; then
+        read blps bbpl < "$BASELINE"
+        awk "BEGIN { printf \"vs baseline:   x%.2f lines/sec, x%.2f bytes/line\\n\", $1 / $blps, $2 / $bbpl }"
+    fi
+fi
@@ -0,0 +1,97 @@
+#!/bin/sh
+# Checks how owning references moved on only some paths are handled.
+#
+# Usage: test/moves.sh [conec]
+#
+# A reference moved on only some paths through an if, loop or and/or
+# must be rejected, as nothing would free it on the others. A branch
+# that returns does not rejoin, so the reference is still freed on the
+# paths that go on.
+
+CONEC=${1:-conec}
+DIR=${TMPDIR:-/tmp}/cone-moves-test
+
+rm -rf "$DIR" && mkdir -p "$DIR" || exit 1
+prelude() {
+    echo "struct Pt:"
+    echo "  x i32"
+    echo "  y i32"
+    echo
+    echo "fn sink(p +so Pt) i32:"
+    echo "  p.x"
+    echo
+}
+
+fail=0
+result() {
+    if [ "$2" = "$3" ]; then
+        echo "ok    $1: $2"
+    else
+        echo "FAIL  $1: $2, expected $3"
+        fail=1
+    fi
+}
+
+# Compile fn f, expecting it to be rejected or compiled
+check() {
+    name=$1 expect=$2
+    { prelude; cat; } > "$DIR/$name.cone"
+    if "$CONEC" "$DIR/$name.cone" -o "$DIR" --malloc --llvmir -O0 > "$DIR/$name.txt" 2>&1; then
+        got=compiled
+    elif grep -q "moved out on only some paths" "$DIR/$name.txt"; then
+        got=rejected
+    else
+        got=failed
+    fi
+    result $name $got $expect
+}
+
+check if rejected <<'EOF'
+fn f(c Bool) i32:
+  imm p = +so Pt[1,2]
+  mut r = 0
+  if c:
+    r = sink(p)
+  r
+EOF
+
+check while rejected <<'EOF'
+fn f(n i32) i32:
+  imm p = +so Pt[1,2]
+  mut r = 0
+  mut i = 0
+  while i < n:
+    r = sink(p)
+    i = i + 1
+  r
+EOF
+
+check and rejected <<'EOF'
+fn f(c Bool) Bool:
+  imm p = +so Pt[1,2]
+  c and sink(p) > 0
+EOF
+
+check ifelse compiled <<'EOF'
+fn f(c Bool) i32:
+  imm p = +so Pt[1,2]
+  if c:
+    sink(p)
+  else:
+    sink(p) + 1
+EOF
+
+check return compiled <<'EOF'
+fn f(c Bool) i32:
+  imm p = +so Pt[1,2]
+  if c:
+    return sink(p)
+  p.y
+EOF
+
+# p is freed where f goes on without returning (sink frees it where f does)
+if [ -f "$DIR/return.ir" ]; then
+    frees=$(sed -n '/^define i32 @f(/,/^}/p' "$DIR/return.ir" | grep -c "call void @free")
+    result "return frees" $frees 1
+fi
+exit $fail
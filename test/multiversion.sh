@@ -0,0 +1,41 @@
+#!/bin/sh
+# Checks which targets multiversion a @multiversion function.
+#
+# Usage: test/multiversion.sh [conec]
+#
+# Compiles a @multiversion function for several x86-64 triples, checking
+# that only ELF targets dispatch through an ifunc and its resolver. Others
+# (Mach-O, COFF) have no ifuncs, so must call the function as usual.
+
+CONEC=${1:-conec}
+DIR=${TMPDIR:-/tmp}/cone-multiversion-test
+
+rm -rf "$DIR" && mkdir -p "$DIR" || exit 1
+cat > "$DIR/mv.cone" <<'EOF'
+fn @multiversion add(a i32, b i32) i32:
+  a + b
+
+fn main():
+  mut x = add(1, 2)
+EOF
+
+fail=0
+check() {
+    triple=$1 expect=$2
+    "$CONEC" "$DIR/mv.cone" -o "$DIR" --triple=$triple --asm > /dev/null 2>&1 || { echo "conec failed: $triple" >&2; exit 1; }
+    if grep -q 'resolver' "$DIR/mv.s"; then got=ifunc; else got=plain; fi
+    if [ $got = $expect ]; then
+        echo "ok    $triple: $got"
+    else
+        echo "FAIL  $triple: $got, expected $expect"
+        fail=1
+    fi
+}
+
+check x86_64-unknown-linux-gnu ifunc
+check x86_64-unknown-freebsd ifunc
+check x86_64-apple-darwin plain
+check x86_64-pc-windows-msvc plain
+check x86_64-w64-windows-gnu plain
+check aarch64-unknown-linux-gnu plain
+exit $fail